@@ -0,0 +1,117 @@
+#include <stdio.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "../machines/DistributedTsetlinMachine.h"
+#include "../utils/TsetlinRand.h"
+#include "../utils/TsetlinTransport.h"
+
+#define EPOCHS 20
+#define NUM_TRAIN 5000
+#define NUM_TEST 1000
+
+// Noisy XOR: the label is the XOR of the first two bits, the rest of the
+// bits are noise, and some of the training labels are flipped.
+class NoisyXORShardConfig {
+   public:
+    static constexpr size_t input_bits = 12;
+    static constexpr size_t num_clauses = 10;  // Per worker
+    static constexpr size_t summation_target = 15;
+    static constexpr float S = 3.9;
+    static constexpr size_t num_states = 256;
+    static char TsetlinAutomaton;
+};
+
+static constexpr size_t input_bits = NoisyXORShardConfig::input_bits;
+static constexpr float label_noise = .1;
+
+struct NoisyXOR {
+    TBitset<input_bits> train_x[NUM_TRAIN], test_x[NUM_TEST];
+    bool train_y[NUM_TRAIN], test_y[NUM_TEST];
+
+    NoisyXOR(uint64_t seed) {
+        TsetlinRandGen rg(seed);
+        auto gen = [&](TBitset<input_bits>* x, bool* y, size_t n, float noise) {
+            for (size_t i = 0; i < n; i++) {
+                for (size_t b = 0; b < input_bits; b++) x[i][b] = rg.rand_64() % 2;
+                y[i] = (x[i][0] != x[i][1]) ^ rg.rand_bernoulli(noise);
+            }
+        };
+        gen(train_x, train_y, NUM_TRAIN, label_noise);
+        gen(test_x, test_y, NUM_TEST, 0);
+    }
+};
+
+template <TsetlinTransport Transport>
+static void
+run_worker(Transport& transport, ShardMode mode, NoisyXOR& data) {
+    DistributedTsetlinMachine<NoisyXORShardConfig, Transport> model(transport,
+                                                                    mode, 500);
+
+    for (size_t epoch = 0; epoch < EPOCHS; epoch++) {
+        size_t train_accurate = 0, trained = 0;
+        for (size_t i = 0; i < NUM_TRAIN; i++) {
+            int out = model.forward_backward(i, data.train_x[i], data.train_y[i]);
+            if (out == -1) continue;
+            trained++;
+            train_accurate += out == data.train_y[i];
+        }
+        model.finish_epoch();
+
+        size_t valid_accurate = 0;
+        for (size_t i = 0; i < NUM_TEST; i++)
+            valid_accurate += model.forward(data.test_x[i]) == data.test_y[i];
+
+        // Clause shards all see every sample, so only data shards need to
+        // combine their train accuracy.
+        if (mode == ShardMode::DATA_SHARDS) {
+            train_accurate = model.allreduce_count(train_accurate);
+            trained = model.allreduce_count(trained);
+        }
+
+        if (transport.rank() == 0)
+            printf("Epoch %zu: train %zu/%zu, valid %zu/%u\n", epoch,
+                   train_accurate, trained, valid_accurate, NUM_TEST);
+    }
+}
+
+int
+main(int argc, char** argv) {
+    // Usage: ./a.out [workers] [shm|uds] [clauses|data]
+    size_t workers = argc > 1 ? strtoul(argv[1], NULL, 10) : 4;
+    bool use_shm = argc > 2 ? !strcmp(argv[2], "shm") : true;
+    ShardMode mode = argc > 3 && !strcmp(argv[3], "data")
+                         ? ShardMode::DATA_SHARDS
+                         : ShardMode::CLAUSE_SHARDS;
+
+    // Generated before forking, so every worker has the same data.
+    auto data = std::unique_ptr<NoisyXOR>(new NoisyXOR(0xf0f0f0f0));
+
+    std::cout << "Training on " << workers << " workers over "
+              << (use_shm ? "shared memory" : "unix sockets") << " with "
+              << (mode == ShardMode::DATA_SHARDS ? "data" : "clause")
+              << " shards." << std::endl;
+
+    size_t failed;
+    if (use_shm) {
+        SharedMemoryGroup group(workers);
+        failed = launch_local_workers(workers, [&](size_t rank) {
+            SharedMemoryTransport t(group, rank);
+            run_worker(t, mode, *data);
+        });
+    } else {
+        char path[64];
+        snprintf(path, sizeof(path), "/tmp/tsetlin-%d.sock", (int)getpid());
+        failed = launch_local_workers(workers, [&](size_t rank) {
+            UnixSocketTransport t(path, rank, workers);
+            run_worker(t, mode, *data);
+        });
+        unlink(path);
+    }
+
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "../machines/CodeGen.h"
+#include "../machines/CompactModel.h"
+#include "../machines/ModelFile.h"
+#include "../machines/TsetlinMachine.h"
+#include "MNISTConfig.h"
+
+// Compiles a model saved by Train.cpp into a header with no dependencies.
+//
+//   ./export output/mnist_parity.tsm mnist_parity.h mnist_parity
+//
+// Then #include "mnist_parity.h" and call mnist_parity_predict(words).
+
+int
+main(int argc, char** argv) {
+    if (argc != 4) {
+        fprintf(stderr, "Usage: %s model.tsm out.h name\n", argv[0]);
+        return 1;
+    }
+    using Machine = TsetlinMachine<MNISTTsetlinConfig>;
+    using Compact = CompactModel<MNISTTsetlinConfig>;
+
+    size_t n = model_file_machines<MNISTTsetlinConfig>(argv[1]);
+    auto machine = std::unique_ptr<Machine>(new Machine());
+    std::vector<std::unique_ptr<Compact>> compact;
+    std::vector<const Compact*> classes;
+    for (size_t i = 0; i < n; i++) {
+        load_model(argv[1], *machine, i);
+        compact.emplace_back(new Compact(*machine));
+        classes.push_back(compact.back().get());
+        printf("Machine %zu: %s\n", i, compact.back()->to_string().c_str());
+    }
+    write_cpp_model(argv[2], argv[3], classes.data(), n);
+    printf("Wrote %s\n", argv[2]);
+}
@@ -0,0 +1,88 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <vector>
+
+#include "../machines/InferenceClient.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinRand.h"
+#include "MNISTConfig.h"
+
+// Load for Serve.cpp. Each connection keeps depth requests in flight with
+// random inputs, and latency is measured from send to receive, so it
+// includes the socket both ways.
+//
+//   ./loadgen /tmp/tsetlin.sock [connections] [requests] [depth] [model]
+
+using Clock = std::chrono::steady_clock;
+static constexpr size_t input_bits = MNISTTsetlinConfig::input_bits;
+
+int
+main(int argc, char** argv) {
+    if (argc < 2) {
+        fprintf(stderr,
+                "Usage: %s socket [connections] [requests per connection] "
+                "[depth] [model]\n",
+                argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    size_t connections = argc > 2 ? atoi(argv[2]) : 4;
+    size_t requests = argc > 3 ? atoi(argv[3]) : 10000;
+    size_t depth = std::max(argc > 4 ? atoi(argv[4]) : 8, 1);
+    uint32_t model = argc > 5 ? atoi(argv[5]) : 0;
+
+    std::vector<std::vector<float>> latencies(connections);
+    std::vector<size_t> errors(connections);
+    auto start = Clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < connections; t++)
+        threads.emplace_back([&, t] {
+            InferenceClient<input_bits> client(path);
+            TsetlinRandGen rg(t + 1);
+            TBitset<input_bits> input;
+            std::deque<Clock::time_point> sent;
+            auto receive = [&] {
+                InferenceResult r = client.receive();
+                latencies[t].push_back(std::chrono::duration<float, std::micro>(
+                                           Clock::now() - sent.front())
+                                           .count());
+                sent.pop_front();
+                errors[t] += r.status != INFER_OK;
+            };
+            for (size_t k = 0; k < requests; k++) {
+                synth_random_bits(rg, input);
+                sent.push_back(Clock::now());
+                client.send(model, input);
+                if (sent.size() == depth) receive();
+            }
+            while (!sent.empty()) receive();
+        });
+    for (auto& t : threads) t.join();
+    double seconds =
+        std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<float> all;
+    size_t failed = 0;
+    for (size_t t = 0; t < connections; t++) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        failed += errors[t];
+    }
+    printf("%zu requests over %zu connections, depth %zu: %.1f requests/sec\n",
+           all.size(), connections, depth,
+           seconds > 0 ? all.size() / seconds : 0);
+    if (all.empty()) {
+        printf("Latency: no samples, %zu errors\n", failed);
+        return failed ? 1 : 0;
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all[std::min(all.size() - 1, (size_t)(p * all.size()))];
+    };
+    printf("Latency p50 %.1fus p99 %.1fus max %.1fus, %zu errors\n",
+           percentile(.5), percentile(.99), all.back(), failed);
+    return failed ? 1 : 0;
+}
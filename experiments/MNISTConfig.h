@@ -0,0 +1,20 @@
+#ifndef MNIST_CONFIG_INCLUDE
+#define MNIST_CONFIG_INCLUDE
+
+#include <cstddef>
+
+#include "../utils/BinaryMNIST.h"
+
+// The machine Train.cpp trains, and so the one Serve.cpp serves.
+class MNISTTsetlinConfig {
+   public:
+    static constexpr size_t input_bits = MNIST_IMG_SIZE;
+    static constexpr size_t num_clauses = 40000;
+    static constexpr size_t summation_target = 50;
+    static constexpr float S = 10.0;
+
+    static char TsetlinAutomaton;
+    static constexpr size_t num_states = 256;
+};
+
+#endif  // MNIST_CONFIG_INCLUDE
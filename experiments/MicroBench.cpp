@@ -0,0 +1,249 @@
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/Benchmarker.h"
+#include "../utils/Morton.h"
+#include "../utils/TsetlinBitset.h"
+#include "../utils/TsetlinRand.h"
+
+// Times every hot kernel on its own, across a few machine shapes.
+//
+// Usage: ./microbench [--filter substr] [--reps n] [--json out.json]
+//                     [--baseline old.json] [--tolerance .05]
+//
+// With --baseline, exits nonzero if anything got slower than the tolerance.
+
+template <size_t bits, size_t clauses>
+class BenchConfig {
+   public:
+    static constexpr size_t input_bits = bits;
+    static constexpr size_t num_clauses = clauses;
+    static constexpr size_t summation_target = 50;
+    static constexpr float S = 10.0;
+    static char TsetlinAutomaton;
+    static constexpr size_t num_states = 256;
+};
+
+static constexpr size_t num_inputs = 64;
+
+template <size_t bits>
+static void
+random_bits(TsetlinRandGen& rg, TBitset<bits>& bs) {
+    for (size_t i = 0; i < bs.buf_len; i++) bs.buf[i] = rg.rand_64();
+    if (bits % TINT_BIT_NUM)
+        bs.buf[bs.buf_len - 1] &= ((tint)1 << (bits % TINT_BIT_NUM)) - 1;
+}
+
+template <typename config>
+static void
+bench_machine(BenchSuite& suite) {
+    using Machine = TsetlinMachine<config>;
+    static constexpr size_t bits = config::input_bits;
+    static constexpr size_t clauses = config::num_clauses;
+    std::string shape =
+        std::to_string(bits) + "b x " + std::to_string(clauses) + "c";
+
+    // Every literal excluded, so that no clause can bail out early and every
+    // call does the full amount of work.
+    auto machine = std::unique_ptr<Machine>(new Machine());
+    auto* states = machine->get_backing();
+    for (size_t i = 0; i < Machine::get_backing_size(); i++) states[i] = -1;
+    machine->recount_included();
+
+    TsetlinRandGen rg(99);
+    auto inputs =
+        std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[num_inputs]);
+    std::vector<std::vector<uint32_t>> sparse_idx(num_inputs);
+    std::vector<TSparseBitset<bits>> sparse(num_inputs);
+    for (size_t i = 0; i < num_inputs; i++) {
+        random_bits(rg, inputs[i]);
+        for (uint32_t b = 0; b < bits; b++)
+            if (rg.rand_bernoulli(.05)) sparse_idx[i].push_back(b);
+        sparse[i] = {sparse_idx[i].data(), sparse_idx[i].size()};
+    }
+
+    size_t k = 0, cl = 0;
+    auto next = [&] {
+        k = (k + 1) % num_inputs;
+        cl = (cl + 1) % clauses;
+    };
+
+    suite.run("clause_forward", shape, 2.0 * bits + bits / 8.0, [&] {
+        bench_keep(machine->clause_forward(states + 2 * bits * cl, inputs[k]));
+        next();
+    });
+    suite.run("clause_forward sparse 5%", shape,
+              2.0 * sparse[0].nnz + 4.0 * sparse[0].nnz, [&] {
+                  bench_keep(machine->clause_forward(cl, sparse[k]));
+                  next();
+              });
+
+    auto outputs = std::unique_ptr<TBitset<clauses>[]>(
+        new TBitset<clauses>[num_inputs]);
+    for (size_t i = 0; i < num_inputs; i++) random_bits(rg, outputs[i]);
+    suite.run("summation_forward", shape, clauses / 8.0, [&] {
+        bench_keep(Machine::summation_forward(outputs[k]));
+        next();
+    });
+
+    suite.run("forward", shape, 2.0 * bits * clauses, [&] {
+        bench_keep(machine->forward(inputs[k]));
+        next();
+    });
+
+    // Feedback reads and writes every automaton of the clause. Last, since
+    // it moves the automata and would let the benches above bail out early.
+    TsetlinRandGen frg(7);
+    suite.run("apply_t1_feedback clause=1", shape, 4.0 * bits, [&] {
+        machine->apply_t1_feedback(frg, cl, inputs[k], true);
+        next();
+    });
+    suite.run("apply_t1_feedback clause=0", shape, 4.0 * bits, [&] {
+        machine->apply_t1_feedback(frg, cl, inputs[k], false);
+        next();
+    });
+    suite.run("apply_t2_feedback clause=1", shape, 4.0 * bits, [&] {
+        machine->apply_t2_feedback(cl, inputs[k], true);
+        next();
+    });
+}
+
+template <size_t bits>
+static void
+bench_bitset(BenchSuite& suite) {
+    std::string shape = std::to_string(bits) + "b";
+    TsetlinRandGen rg(5);
+    auto a = std::unique_ptr<TBitset<bits>>(new TBitset<bits>());
+    auto b = std::unique_ptr<TBitset<bits>>(new TBitset<bits>());
+    random_bits(rg, *a);
+    random_bits(rg, *b);
+
+    suite.run("TBitset &=", shape, 3.0 * bits / 8, [&] {
+        *a &= *b;
+        bench_keep(a->buf[0]);
+    });
+    suite.run("TBitset ^=", shape, 3.0 * bits / 8, [&] {
+        *a ^= *b;
+        bench_keep(a->buf[0]);
+    });
+    suite.run("TBitset count", shape, bits / 8.0,
+              [&] { bench_keep(a->count()); });
+    suite.run("TBitset operator[]", shape, 1.0 / 8,
+              [&, i = (size_t)0]() mutable {
+                  bench_keep((bool)(*a)[i]);
+                  i = (i + 1) % bits;
+              });
+}
+
+static void
+bench_rand(BenchSuite& suite) {
+    TsetlinRandGen rg;
+    TsetlinSIMDRandGen srg;
+    suite.run("rand_64", "TsetlinRandGen", 8,
+              [&] { bench_keep(rg.rand_64()); });
+    suite.run("rand_bernoulli", "TsetlinRandGen", 1.0 / 8,
+              [&] { bench_keep(rg.rand_bernoulli(.1f)); });
+    suite.run("biased_bits_8", "TsetlinRandGen", 1,
+              [&] { bench_keep(rg.biased_bits_8(.1f)); });
+    suite.run("biased_bits_32", "TsetlinRandGen", 4,
+              [&] { bench_keep(rg.biased_bits_32(.1f)); });
+    suite.run("biased_bits_64", "TsetlinRandGen", 8,
+              [&] { bench_keep(rg.biased_bits_64(.1f)); });
+    suite.run("biased_bits_64", "TsetlinSIMDRandGen", 8,
+              [&] { bench_keep(srg.biased_bits_64(.1f)); });
+
+    static tint words[1024];
+    suite.run("fill_bernoulli 1024 words", "TsetlinSIMDRandGen", sizeof(words),
+              [&] {
+                  srg.fill_bernoulli(words, 1024, .1f);
+                  bench_keep(words[0]);
+              });
+
+    uint32_t clause = 0;
+    suite.run("rand_bernoulli", "TsetlinCounterRandGen", 1.0 / 8, [&] {
+        TsetlinCounterRandGen crg(1, 2, 3, clause++);
+        bench_keep(crg.rand_bernoulli(.1f));
+    });
+}
+
+static void
+bench_morton(BenchSuite& suite) {
+    static constexpr size_t n = 1024;
+    static uint64_t xs[n], ys[n], ms[n], ms2[n];
+    TsetlinRandGen rg(3);
+    for (size_t i = 0; i < n; i++) xs[i] = rg.rand_64(), ys[i] = rg.rand_64();
+
+    size_t i = 0;
+    suite.run("xy32_to_morton64", "scalar", 8, [&] {
+        xy32_to_morton64((uint32_t)xs[i], (uint32_t)ys[i], &ms[i]);
+        bench_keep(ms[i]);
+        i = (i + 1) % n;
+    });
+    suite.run("morton64_to_xy32", "scalar", 8, [&] {
+        uint32_t x, y;
+        morton64_to_xy32(ms[i], &x, &y);
+        bench_keep(x);
+        bench_keep(y);
+        i = (i + 1) % n;
+    });
+    suite.run("xy64_to_morton128", "scalar", 16, [&] {
+        xy64_to_morton128(xs[i], ys[i], &ms[i], &ms2[i]);
+        bench_keep(ms2[i]);
+        i = (i + 1) % n;
+    });
+    suite.run("morton128_to_xy64", "scalar", 16, [&] {
+        uint64_t x, y;
+        morton128_to_xy64(ms[i], ms2[i], &x, &y);
+        bench_keep(x);
+        bench_keep(y);
+        i = (i + 1) % n;
+    });
+}
+
+int
+main(int argc, char** argv) {
+    const char *json = NULL, *baseline = NULL;
+    std::string filter;
+    size_t reps = 25;
+    double tolerance = .05;
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--json"))
+            json = argv[i + 1];
+        else if (!strcmp(argv[i], "--baseline"))
+            baseline = argv[i + 1];
+        else if (!strcmp(argv[i], "--filter"))
+            filter = argv[i + 1];
+        else if (!strcmp(argv[i], "--reps"))
+            reps = strtoul(argv[i + 1], NULL, 10);
+        else if (!strcmp(argv[i], "--tolerance"))
+            tolerance = strtod(argv[i + 1], NULL);
+        else {
+            std::cerr << "Unknown option " << argv[i] << std::endl;
+            return 2;
+        }
+    }
+    if (!reps) {
+        std::cerr << "--reps must be at least 1" << std::endl;
+        return 2;
+    }
+
+    BenchSuite suite(3, reps);
+    suite.set_filter(filter);
+
+    bench_machine<BenchConfig<64, 128>>(suite);
+    bench_machine<BenchConfig<784, 2000>>(suite);
+    bench_machine<BenchConfig<4096, 512>>(suite);
+    bench_bitset<784>(suite);
+    bench_bitset<65536>(suite);
+    bench_rand(suite);
+    bench_morton(suite);
+
+    if (json) suite.write_json(json);
+    if (baseline) return suite.compare(baseline, tolerance) ? 1 : 0;
+    return 0;
+}
@@ -0,0 +1,145 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+
+// Training and inference throughput of whole machines on synthetic tasks,
+// sweeping machine shape, thread count and batch size. Prints CSV, one row
+// per point, with the scaling efficiency against one thread at the same
+// batch size.
+//
+// Usage: ./scalingbench [--samples n] [--epochs n] [--max-threads n]
+
+template <size_t bits, size_t clauses>
+class ScalingConfig {
+   public:
+    static constexpr size_t input_bits = bits;
+    static constexpr size_t num_clauses = clauses;
+    static constexpr size_t summation_target = clauses / 8;
+    static constexpr float S = 3.9;
+    static char TsetlinAutomaton;
+    static constexpr size_t num_states = 256;
+};
+
+static size_t num_samples = 2048;
+static size_t num_epochs = 2;
+static std::vector<size_t> thread_counts;
+static const size_t batch_sizes[] = {1, 16, 128};
+
+enum class Task { NOISY_XOR, PARITY, CONJUNCTIONS };
+static const char* task_names[] = {"noisy_xor", "4_parity", "conjunctions"};
+
+using bench_clock = std::chrono::steady_clock;
+
+static double
+seconds_since(bench_clock::time_point t0) {
+    return std::chrono::duration<double>(bench_clock::now() - t0).count();
+}
+
+template <typename config>
+static void
+sweep(Task task) {
+    static constexpr size_t bits = config::input_bits;
+    using Machine = TsetlinMachine<config>;
+
+    size_t n_train = num_samples, n_test = num_samples / 4;
+    auto x = std::unique_ptr<TBitset<bits>[]>(
+        new TBitset<bits>[n_train + n_test]);
+    auto y = std::unique_ptr<bool[]>(new bool[n_train + n_test]);
+    size_t n = n_train + n_test;
+    if (task == Task::NOISY_XOR)
+        synth_noisy_xor(x.get(), y.get(), n, .1);
+    else if (task == Task::PARITY)
+        synth_k_parity(x.get(), y.get(), n, 4, .05);
+    else
+        synth_sparse_conjunctions(x.get(), y.get(), n, 8, 3, .05, .05);
+    const TBitset<bits>* test_x = x.get() + n_train;
+    const bool* test_y = y.get() + n_train;
+    auto predictions = std::unique_ptr<bool[]>(new bool[n_test]);
+
+    for (size_t batch : batch_sizes) {
+        double train_base = 0, infer_base = 0;
+        for (size_t threads : thread_counts) {
+            auto machine = std::unique_ptr<Machine>(new Machine(1234));
+            TThreadpool pool(threads);
+
+            auto t0 = bench_clock::now();
+            for (uint32_t epoch = 0; epoch < num_epochs; epoch++)
+                for (size_t i = 0; i < n_train; i += batch)
+                    machine->train_batch(x.get() + i, y.get() + i,
+                                         std::min(batch, n_train - i),
+                                         {epoch, (uint32_t)i}, pool);
+            double train_sps = n_train * num_epochs / seconds_since(t0);
+
+            t0 = bench_clock::now();
+            for (size_t i = 0; i < n_test; i += batch)
+                machine->forward_batch(test_x + i, std::min(batch, n_test - i),
+                                       predictions.get() + i, pool);
+            double infer_sps = n_test / seconds_since(t0);
+
+            size_t correct = 0;
+            for (size_t i = 0; i < n_test; i++)
+                correct += predictions[i] == test_y[i];
+
+            if (threads == thread_counts[0]) {
+                train_base = train_sps / threads;
+                infer_base = infer_sps / threads;
+            }
+            std::printf("%s,%zu,%zu,%zu,%zu,%.1f,%.1f,%.3f,%.3f,%.4f\n",
+                        task_names[(int)task], bits, config::num_clauses,
+                        threads, batch, train_sps, infer_sps,
+                        train_sps / (threads * train_base),
+                        infer_sps / (threads * infer_base),
+                        (double)correct / n_test);
+            std::fflush(stdout);
+        }
+    }
+}
+
+template <typename config>
+static void
+sweep_tasks() {
+    sweep<config>(Task::NOISY_XOR);
+    sweep<config>(Task::PARITY);
+    sweep<config>(Task::CONJUNCTIONS);
+}
+
+int
+main(int argc, char** argv) {
+    size_t max_threads = std::thread::hardware_concurrency();
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (!strcmp(argv[i], "--samples"))
+            num_samples = strtoul(argv[i + 1], NULL, 10);
+        else if (!strcmp(argv[i], "--epochs"))
+            num_epochs = strtoul(argv[i + 1], NULL, 10);
+        else if (!strcmp(argv[i], "--max-threads"))
+            max_threads = strtoul(argv[i + 1], NULL, 10);
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+    // A quarter of them are the test set, which can't be empty.
+    if (num_samples < 4) {
+        std::fprintf(stderr, "--samples must be at least 4\n");
+        return 2;
+    }
+    for (size_t t = 1; t < max_threads; t *= 2) thread_counts.push_back(t);
+    thread_counts.push_back(std::max<size_t>(max_threads, 1));
+
+    std::printf("task,input_bits,num_clauses,threads,batch,train_samples_per_"
+                "sec,infer_samples_per_sec,train_efficiency,infer_efficiency,"
+                "test_accuracy\n");
+    sweep_tasks<ScalingConfig<64, 128>>();
+    sweep_tasks<ScalingConfig<256, 512>>();
+    sweep_tasks<ScalingConfig<1024, 1024>>();
+    return 0;
+}
@@ -0,0 +1,59 @@
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+#include "../machines/InferenceServer.h"
+#include "MNISTConfig.h"
+
+// Serves models saved by Train.cpp until interrupted, printing stats every
+// second. Model i is the i'th file on the command line.
+//
+//   ./serve /tmp/tsetlin.sock output/mnist_parity.tsm [more.tsm...]
+//
+// Try it with loadgen.
+
+int
+main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s socket model.tsm [model.tsm...]\n",
+                argv[0]);
+        return 1;
+    }
+
+    // Block the signals before any threads start, so only sigtimedwait()
+    // below sees them.
+    sigset_t stop;
+    sigemptyset(&stop);
+    sigaddset(&stop, SIGINT);
+    sigaddset(&stop, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &stop, NULL);
+
+    std::vector<InferenceModel<MNISTTsetlinConfig>> models;
+    for (int i = 2; i < argc; i++) {
+        models.push_back(load_inference_model<MNISTTsetlinConfig>(argv[i]));
+        printf("Model %d: %s, %zu %s\n", i - 2, argv[i], models.back().size(),
+               models.back().size() == 1 ? "machine" : "classes");
+    }
+
+    InferenceServerOptions options;
+    if (const char* b = getenv("MAX_BATCH")) options.max_batch = atoi(b);
+    if (const char* w = getenv("MAX_WAIT_US")) options.max_wait_us = atof(w);
+    InferenceServer<MNISTTsetlinConfig> server(argv[1], std::move(models),
+                                               options);
+    printf("Listening on %s\n", argv[1]);
+    fflush(stdout);
+
+    timespec second = {1, 0};
+    uint64_t last = 0;
+    while (sigtimedwait(&stop, NULL, &second) == -1) {
+        InferenceStats s = server.stats();
+        if (s.requests == last) continue;
+        last = s.requests;
+        printf("%s\n", s.to_string().c_str());
+        fflush(stdout);
+    }
+    printf("%s\n", server.stats().to_string().c_str());
+}
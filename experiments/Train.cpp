@@ -1,36 +1,39 @@
 #include <stdio.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#include <cerrno>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <deque>
 #include <memory>
 #include <ostream>
+#include <stdexcept>
+#include <string>
 
 // #include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/ModelFile.h"
+#include "../machines/Trainer.h"
 #include "../machines/TsetlinMachine.h"
 #include "../utils/BinaryMNIST.h"
+#include "../utils/MetricsReporter.h"
+#include "../utils/StreamingDataset.h"
 #include "../utils/TsetlinBitset.h"
+#include "MNISTConfig.h"
 
 static constexpr bool progress_print = true;
 static constexpr bool epoch_print = true;
+static constexpr bool stream_from_disk = false;
+
+// Metrics, trace and the trained model. Not under version control.
+#define OUTPUT_FOLDER "output/"
 
 #define EPOCHS 400
 #define NUM_TRAIN 60000
 #define NUM_TEST 10000
 
-// MultiClassTsetlinMachine<MNIST_IMG_SIZE, 40000, 50> model;
-
-class MNISTTsetlinConfig {
-   public:
-    static constexpr size_t input_bits = MNIST_IMG_SIZE;
-    static constexpr size_t num_clauses = 40000;
-    static constexpr size_t summation_target = 50;
-    static constexpr float S = 10.0;
-
-    static char TsetlinAutomaton;
-    static constexpr size_t num_states = 256;
-};
+// MultiClassTsetlinMachine<10, MNISTTsetlinConfig> model;
 
 class XORTsetlinConfig {
    public:
@@ -43,91 +46,131 @@ class XORTsetlinConfig {
     static char TsetlinAutomaton;
 };
 
-static inline void
-print_progress(const char* train_test, size_t sample_num, size_t num_train,
-               size_t num_accurate) {
-    if (progress_print) {
-        printf(
-            "\r%s epoch progress: %zu/%zu, epoch accuracy: %zu/%zu, (%.2f%%)",
-            train_test, sample_num, num_train, num_accurate, sample_num,
-            100.0 * (float)num_accurate / (float)sample_num);
-        fflush(stdout);
-    }
-}
-
-static inline void
-print_epoch(size_t epoch_num, size_t train_accurate, size_t valid_accurate,
-            size_t num_train, size_t num_valid, auto epoch_start,
-            auto train_end, auto valid_end) {
-    if (epoch_print) {
-        // clang-format off
-        char tn[] = "seconds";
-        using timelength = std::chrono::seconds;
-        auto train_duration = std::chrono::duration_cast<timelength>(train_end - epoch_start).count();
-        auto valid_duration = std::chrono::duration_cast<timelength>(valid_end - train_end).count();
-        auto total_duration = std::chrono::duration_cast<timelength>(valid_end - epoch_start).count();
-
-        std::cout << "\r\33[2K"  // Erase progress line
-                  << "============================="
-                  << "\nFinished epoch " << epoch_num << '.'
-                  << "\nTrain Accuracy: " << train_accurate << '/' << num_train << " (" << 100.0 * (float)train_accurate / (float)num_train << "%)"
-                  << "\nValid Accuracy: " << valid_accurate << '/' << num_valid << " (" << 100.0 * (float)valid_accurate / (float)num_valid << "%)"
-                  << "\nTrain time: " << train_duration << " " << tn << "."
-                  << "\nValid time: " << valid_duration << " " << tn << "."
-                  << "\nTotal time: " << total_duration << " " << tn << ".\n" << std::endl;
-        // clang-format on
-    }
-}
-
+// Works on anything the trainer can stream samples from, in memory or not.
+template <SampleStream<MNIST_IMG_SIZE> TrainStream,
+          SampleStream<MNIST_IMG_SIZE> ValidStream>
 void
-mnist() {
-    // Dataset
-    char folder[] = "../utils/MNIST-dataloader-for-C/data/";
-    auto bmnist = std::unique_ptr<BinaryMNIST>(new BinaryMNIST(folder));
-
+mnist_loop(TrainStream& train_set, ValidStream& valid_set) {
     // Model
     TsetlinMachine<MNISTTsetlinConfig>* model =
         new TsetlinMachine<MNISTTsetlinConfig>();
-
+    auto parity = [](unsigned char label) { return label % 2; };
+
+    // Printing happens on the reporter's thread, never in the loops below.
+    MetricsOptions report_options;
+    report_options.progress = progress_print;
+    report_options.epochs = epoch_print;
+    report_options.csv_path = OUTPUT_FOLDER "train_metrics.csv";
+    MetricsReporter reporter(report_options);
+
+    // Each epoch is validated on a snapshot, on the other cores, while the
+    // next one trains.
+    Trainer<MNISTTsetlinConfig> trainer(
+        *model, [&](const auto& snapshot, TThreadpool& pool) {
+            return snapshot.evaluate(valid_set, pool, parity);
+        });
+    // An epoch is reported once its validation is back, so its record has
+    // both halves. Its counters wait with it.
+    struct PendingEpoch {
+        EpochMetrics metrics;
+        std::string notes;
+    };
+    std::deque<PendingEpoch> pending;
+    auto report_valid = [&](const SnapshotEval& v) {
+        while (!pending.empty() && pending.front().metrics.epoch < v.epoch) {
+            reporter.epoch(pending.front().metrics);
+            pending.pop_front();
+        }
+        PendingEpoch& p = pending.front();
+        p.metrics.valid_accurate = v.result.correct();
+        p.metrics.num_valid = v.result.samples();
+        p.metrics.valid_seconds = v.result.seconds;
+        reporter.epoch(p.metrics);
+        reporter.note(v.result.to_string() + '\n');
+        if (!p.notes.empty()) reporter.note(p.notes);
+        pending.pop_front();
+    };
+
+    // Build with -DTSETLIN_TRACE=1. A span for every sample would be most of
+    // the trace.
+    TSETLIN_TRACE_THREAD_NAME("trainer");
+    trace_set_sample_every(1000);
+
+    SnapshotEval valid;
     for (size_t epoch = 0; epoch < EPOCHS; epoch++) {
-        auto epoch_start_time = std::chrono::high_resolution_clock::now();
+        // Everything up to the last epoch, rewritten every epoch so there's a
+        // trace even if the run is cut short. Open in ui.perfetto.dev.
+        if (TSETLIN_TRACE && epoch)
+            trace_write_json(OUTPUT_FOLDER "train_trace.json");
+        TSETLIN_TRACE_SPAN("epoch", epoch);
+        auto epoch_start_time = std::chrono::steady_clock::now();
+        TsetlinStats epoch_stats = model->stats();
+        PerfReport epoch_perf = perf_collect();
 
         // Train loop
-        size_t train_accurate = 0;
-        for (size_t i = 0; i < bmnist->num_train; i++) {
-            TBitset<MNIST_IMG_SIZE>& img = bmnist->train(i);
-            unsigned char label = bmnist->train_label(i);
-
-            bool output = model->forward_backward(img, label%2 ? 1 : 0);
-
-            train_accurate += output == label%2 ? 1 : 0;
+        reporter.begin_phase("Train", train_set.size());
+        size_t train_accurate = trainer.train_epoch(
+            train_set, epoch, parity, [&](size_t seen, size_t correct) {
+                reporter.progress(seen, correct);
+            });
 
-            print_progress("Train", i, bmnist->num_train, train_accurate);
-            model->print_clause(0, 28, 28);
-        }
-
-        auto train_end_time = std::chrono::high_resolution_clock::now();
+        auto train_end_time = std::chrono::steady_clock::now();
 
-        // Valid loop
-        size_t valid_accurate = 0;
-        for (size_t i = 0; i < bmnist->num_test; i++) {
-            TBitset<MNIST_IMG_SIZE>& img = bmnist->test(i);
-            unsigned char label = bmnist->test_label(i);
-            bool output = model->forward(img);
-
-            valid_accurate += output == label%2 ? 1 : 0;
+        // model->print_clauses();
 
-            print_progress("Test", i, bmnist->num_test, valid_accurate);
-        }
+        // Epoch results
+        PendingEpoch& p = pending.emplace_back();
+        p.metrics.epoch = epoch;
+        p.metrics.train_accurate = train_accurate;
+        p.metrics.num_train = train_set.size();
+        p.metrics.train_seconds = std::chrono::duration<double>(
+                                      train_end_time - epoch_start_time)
+                                      .count();
+        // Build with -DTSETLIN_STATS=1
+        if constexpr (TsetlinStats::enabled)
+            p.notes += (model->stats() - epoch_stats).to_string() + '\n';
+        // Build with -DTSETLIN_PERF=1
+        if (TSETLIN_PERF)
+            p.notes += (perf_collect() - epoch_perf).to_string() + '\n';
+
+        // Whatever validations have finished in the meantime.
+        while (trainer.poll(valid)) report_valid(valid);
+    }
+    while (trainer.wait_result(valid)) report_valid(valid);
+    // For Serve.cpp. Once, since writing the model takes a while and would
+    // hold up training.
+    save_model(OUTPUT_FOLDER "mnist_parity.tsm", *model);
+    if (TSETLIN_TRACE) trace_write_json(OUTPUT_FOLDER "train_trace.json");
+}
 
-        auto test_end_time = std::chrono::high_resolution_clock::now();
+void
+mnist() {
+    if (::mkdir(OUTPUT_FOLDER, 0755) == -1 && errno != EEXIST)
+        throw std::runtime_error("Couldn't create " OUTPUT_FOLDER ".");
 
-        // model->print_clauses();
+    // Dataset
+    char folder[] = "../utils/MNIST-dataloader-for-C/data/";
 
-        // Print epoch results
-        print_epoch(epoch, train_accurate, valid_accurate, bmnist->num_train,
-                    bmnist->num_test, epoch_start_time, train_end_time,
-                    test_end_time);
+    if (stream_from_disk) {
+        // Out of core. Only two blocks of each set are in memory at a time.
+        StreamingIDXDataset<MNIST_IMG_SIZE> train_set(
+            "../utils/MNIST-dataloader-for-C/data/train-images.idx3-ubyte",
+            "../utils/MNIST-dataloader-for-C/data/train-labels.idx1-ubyte");
+        StreamingIDXDataset<MNIST_IMG_SIZE> valid_set(
+            "../utils/MNIST-dataloader-for-C/data/t10k-images.idx3-ubyte",
+            "../utils/MNIST-dataloader-for-C/data/t10k-labels.idx1-ubyte",
+            .3, 4096, false);
+        mnist_loop(train_set, valid_set);
+    } else {
+        auto bmnist =
+            std::unique_ptr<CachedBinaryMNIST>(new CachedBinaryMNIST(folder));
+        InMemoryStream<MNIST_IMG_SIZE> train_set(
+            bmnist->train_set.samples(), bmnist->train_set.all_labels(),
+            bmnist->num_train);
+        InMemoryStream<MNIST_IMG_SIZE> valid_set(
+            bmnist->test_set.samples(), bmnist->test_set.all_labels(),
+            bmnist->num_test);
+        mnist_loop(train_set, valid_set);
     }
 }
 
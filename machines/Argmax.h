@@ -0,0 +1,79 @@
+#ifndef ARGMAX_INCLUDE
+#define ARGMAX_INCLUDE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#include "../utils/TsetlinRand.h"
+
+// Which class wins a tie. Defined outside the #ifndef so that
+// -DARGMAX_TIEBREAK=AM_RANDOM works.
+#define AM_LAST 0
+#define AM_FIRST 1
+#define AM_RANDOM 2
+#ifndef ARGMAX_TIEBREAK
+#define ARGMAX_TIEBREAK AM_LAST
+#endif  // ARGMAX_TIEBREAK
+
+// The class with the most votes, ties broken by ARGMAX_TIEBREAK. Everything
+// that turns class votes into a prediction goes through this, so that a
+// compacted, pruned or served model predicts what the machine does.
+//
+// AM_RANDOM draws from the counter based generator, keyed by the seed and
+// how many draws came before. A model's ties don't depend on any other
+// model, and calling from several threads at once is fine.
+class Argmax {
+    uint64_t seed;
+    mutable std::atomic<uint64_t> draws{0};
+
+#if ARGMAX_TIEBREAK == AM_RANDOM
+    uint64_t
+    draw() const noexcept {
+        uint64_t d = draws.fetch_add(1, std::memory_order_relaxed);
+        // UINT32_MAX is the class pick of MultiClassTsetlinMachine.
+        return TsetlinCounterRandGen(seed, (uint32_t)(d >> 32), (uint32_t)d,
+                                     UINT32_MAX - 1)
+            .rand_64();
+    }
+#endif
+
+   public:
+    explicit Argmax(uint64_t tie_seed = 0xabcdef0123456789)
+        : seed(tie_seed) {}
+
+    Argmax(const Argmax &o)
+        : seed(o.seed), draws(o.draws.load(std::memory_order_relaxed)) {}
+
+    Argmax &
+    operator=(const Argmax &o) {
+        seed = o.seed;
+        draws.store(o.draws.load(std::memory_order_relaxed),
+                    std::memory_order_relaxed);
+        return *this;
+    }
+
+    size_t
+    operator()(const int *votes, size_t num_classes) const noexcept {
+        size_t best = 0;
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        size_t ties = 1;
+#endif
+        for (size_t c = 1; c < num_classes; c++) {
+#if ARGMAX_TIEBREAK == AM_FIRST
+            if (votes[c] > votes[best]) best = c;
+#elif ARGMAX_TIEBREAK == AM_LAST
+            if (votes[c] >= votes[best]) best = c;
+#else
+            // Reservoir sampling over the tied classes.
+            if (votes[c] > votes[best])
+                best = c, ties = 1;
+            else if (votes[c] == votes[best] && draw() % ++ties == 0)
+                best = c;
+#endif
+        }
+        return best;
+    }
+};
+
+#endif  // ARGMAX_INCLUDE
@@ -0,0 +1,228 @@
+#ifndef CLAUSE_TRIE_INCLUDE
+#define CLAUSE_TRIE_INCLUDE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../utils/TsetlinBitset.h"
+#include "Argmax.h"
+#include "CompactModel.h"
+#include "TsetlinMachine.h"
+
+// Evaluates a compacted model with the work clauses have in common done
+// once. A clause is a conjunction of literals, inps and ~inps, and lots of
+// clauses share some of them: the ~inps of a background, the inps of a
+// stroke. So the clauses go into a trie over their literals, a literal a
+// group of clauses shares is a single node, and a node that fails rules out
+// everything below it at once.
+//
+// Each clause's literals are ordered the most common first, which puts the
+// most sharing near the root. A run of nodes on one input word with nothing
+// branching off becomes one node, checked with masks like any clause. The
+// trie is laid out flat, depth first, with each node knowing where its
+// subtree ends, so evaluation is one forward scan that jumps past the
+// subtree of every node that fails.
+//
+// Every class of a multi-class model goes into the same trie, so classes
+// share their literals too. A node carries the weight, per class, of the
+// clauses that are true once it passes.
+template <typename config>
+class ClauseTrie {
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t words = TBitset<input_bits>::buf_len;
+    static constexpr uint32_t no_weight = UINT32_MAX;
+
+    struct Node {
+        tint pos, neg;
+        uint32_t word;
+        uint32_t end;     // One past the last node of this subtree
+        uint32_t weight;  // Index into weights, or no_weight
+    };
+
+    // The uncompressed trie, while building. Literal l is ~inp l / 2 if
+    // l is odd, else inp l / 2.
+    struct Branch {
+        uint32_t literal;
+        uint32_t weight = no_weight;
+        std::vector<uint32_t> children;
+    };
+
+    size_t num_classes;
+    std::vector<Node> nodes;
+    std::vector<int> weights;  // num_classes per weighted node
+    std::vector<int> bias;
+    size_t unshared = 0;  // Word checks there would be without sharing
+    Argmax argmax;
+
+    void
+    emit(const std::vector<Branch> &trie, uint32_t b) {
+        size_t at = nodes.size();
+        uint32_t word = trie[b].literal / 2 / TINT_BIT_NUM;
+        Node node{0, 0, word, 0, no_weight};
+        for (;;) {
+            uint32_t l = trie[b].literal;
+            (l % 2 ? node.neg : node.pos) |= (tint)1 << (l / 2 % TINT_BIT_NUM);
+            const Branch &br = trie[b];
+            if (br.weight != no_weight || br.children.size() != 1 ||
+                trie[br.children[0]].literal / 2 / TINT_BIT_NUM != word)
+                break;
+            b = br.children[0];
+        }
+        node.weight = trie[b].weight;
+        nodes.push_back(node);
+        for (uint32_t child : trie[b].children) emit(trie, child);
+        nodes[at].end = (uint32_t)nodes.size();
+    }
+
+   public:
+    // One model per class, or a single binary one.
+    ClauseTrie(const CompactModel<config> *const *models, size_t num_models)
+        : num_classes(num_models), bias(num_models) {
+        if (!num_models) throw std::invalid_argument("Nothing to evaluate.");
+        struct Entry {
+            std::vector<uint32_t> literals;
+            size_t cls;
+            int weight;
+        };
+        std::vector<Entry> entries;
+        std::vector<size_t> count(2 * input_bits);
+        for (size_t c = 0; c < num_models; c++) {
+            bias[c] = models[c]->constant();
+            for (size_t k = 0; k < models[c]->size(); k++) {
+                const tint *m = models[c]->clause_masks(k);
+                Entry e{{}, c, models[c]->weight(k)};
+                for (size_t w = 0; w < words; w++) {
+                    unshared += (m[w] | m[words + w]) != 0;
+                    for (size_t neg = 0; neg < 2; neg++)
+                        for (tint b = m[neg * words + w]; b; b &= b - 1) {
+                            uint32_t l = (uint32_t)(
+                                2 * (w * TINT_BIT_NUM + __builtin_ctzll(b)) +
+                                neg);
+                            e.literals.push_back(l);
+                            count[l]++;
+                        }
+                }
+                entries.push_back(std::move(e));
+            }
+        }
+
+        // Most common first. Sorting the clauses after that puts the ones
+        // that share a prefix next to each other.
+        std::vector<uint32_t> rank(2 * input_bits), by_count(2 * input_bits);
+        std::iota(by_count.begin(), by_count.end(), 0);
+        std::stable_sort(by_count.begin(), by_count.end(),
+                         [&](uint32_t a, uint32_t b) {
+                             return count[a] > count[b];
+                         });
+        for (uint32_t r = 0; r < by_count.size(); r++) rank[by_count[r]] = r;
+        for (Entry &e : entries)
+            std::sort(e.literals.begin(), e.literals.end(),
+                      [&](uint32_t a, uint32_t b) {
+                          return rank[a] < rank[b];
+                      });
+        std::sort(entries.begin(), entries.end(),
+                  [&](const Entry &a, const Entry &b) {
+                      return std::lexicographical_compare(
+                          a.literals.begin(), a.literals.end(),
+                          b.literals.begin(), b.literals.end(),
+                          [&](uint32_t x, uint32_t y) {
+                              return rank[x] < rank[y];
+                          });
+                  });
+
+        // Sorted, a clause's path only ever continues the last child.
+        std::vector<Branch> trie(1);
+        for (const Entry &e : entries) {
+            uint32_t b = 0;
+            for (uint32_t l : e.literals) {
+                const std::vector<uint32_t> &ch = trie[b].children;
+                if (!ch.empty() && trie[ch.back()].literal == l) {
+                    b = ch.back();
+                    continue;
+                }
+                trie.push_back({l, no_weight, {}});
+                trie[b].children.push_back((uint32_t)trie.size() - 1);
+                b = (uint32_t)trie.size() - 1;
+            }
+            if (!b) {
+                bias[e.cls] += e.weight;
+                continue;
+            }
+            if (trie[b].weight == no_weight) {
+                trie[b].weight = (uint32_t)(weights.size() / num_classes);
+                weights.resize(weights.size() + num_classes);
+            }
+            weights[trie[b].weight * num_classes + e.cls] += e.weight;
+        }
+        for (uint32_t child : trie[0].children) emit(trie, child);
+    }
+
+    explicit ClauseTrie(const CompactModel<config> &model)
+        : ClauseTrie(std::vector<const CompactModel<config> *>{&model}.data(),
+                     1) {}
+
+    // Word checks a sample can take, against what evaluating every clause
+    // on its own, skipping the words it includes nothing from, would take.
+    size_t
+    num_nodes() const noexcept {
+        return nodes.size();
+    }
+
+    size_t
+    num_unshared() const noexcept {
+        return unshared;
+    }
+
+    // Every class's votes into out. Returns how many checks were made.
+    size_t
+    votes(const TBitset<input_bits> &input, int *out) const noexcept {
+        for (size_t c = 0; c < num_classes; c++) out[c] = bias[c];
+        const tint *x = input.buf;
+        size_t i = 0, checks = 0;
+        while (i < nodes.size()) {
+            const Node &node = nodes[i];
+            checks++;
+            tint w = x[node.word];
+            if ((~w & node.pos) | (w & node.neg)) {
+                i = node.end;
+                continue;
+            }
+            if (node.weight != no_weight) {
+                const int *nw = weights.data() + node.weight * num_classes;
+                for (size_t c = 0; c < num_classes; c++) out[c] += nw[c];
+            }
+            i++;
+        }
+        return checks;
+    }
+
+    // 0 or 1 for a binary model, like forward(). Otherwise the class with
+    // the most votes, ties broken like MultiClassTsetlinMachine.
+    size_t
+    predict(const TBitset<input_bits> &input) const {
+        std::vector<int> v(num_classes);
+        votes(input, v.data());
+        if (num_classes == 1)
+            return TsetlinMachine<config>::threshold_forward(v[0]);
+        return argmax(v.data(), num_classes);
+    }
+
+    std::string
+    to_string() const {
+        char line[128];
+        snprintf(line, sizeof(line),
+                 "%zu word checks shared as %zu trie nodes (%.1fx)", unshared,
+                 nodes.size(),
+                 nodes.empty() ? 0. : (double)unshared / nodes.size());
+        return line;
+    }
+};
+
+#endif  // CLAUSE_TRIE_INCLUDE
@@ -0,0 +1,232 @@
+#ifndef CODEGEN_INCLUDE
+#define CODEGEN_INCLUDE
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../utils/TsetlinBitset.h"
+#include "CompactModel.h"
+#include "Argmax.h"
+
+// Writes a compacted model out as C++ source with no dependencies, for
+// compiling the model straight into an application. Every clause becomes
+// one expression over only the input words it includes something from,
+// with its masks as constants, so there are no automata or masks in memory
+// at all, and the compiler sees every branch.
+//
+// The header defines, for a model called name:
+//   name_input_words                 Words in an input, 64 bits each, bit i
+//                                    of the input at bit i % 64 of word
+//                                    i / 64, like TBitset.
+//   int name_votes(const uint64_t*)  Binary models. What votes() says.
+//   bool name_predict(...)           What forward() says. Stops as soon as
+//                                    the answer can't change.
+//   void name_votes(x, int* votes)   Multi-class models. One per class.
+//   size_t name_predict(...)         The class with the most votes, ties
+//                                    broken like MultiClassTsetlinMachine,
+//                                    by the ARGMAX_TIEBREAK this is built
+//                                    with.
+//
+// name must be a C identifier, since every function is named after it.
+
+// Does the writing for write_cpp_model(), all in the constructor.
+template <typename config>
+class CppModelWriter {
+    static constexpr size_t words = TBitset<config::input_bits>::buf_len;
+    // Clauses between early exit checks.
+    static constexpr size_t group = 8;
+
+    FILE *fp;
+    std::string name;
+
+    void
+    clause_expr(const CompactModel<config> &model, size_t k) {
+        const tint *pos = model.clause_masks(k), *neg = pos + words;
+        const char *sep = "";
+        fprintf(fp, "!(");
+        for (size_t w = 0; w < words; w++) {
+            if (pos[w]) {
+                fprintf(fp, "%s(~x[%zu] & 0x%016llxull)", sep, w,
+                        (unsigned long long)pos[w]);
+                sep = " | ";
+            }
+            if (neg[w]) {
+                fprintf(fp, "%s(x[%zu] & 0x%016llxull)", sep, w,
+                        (unsigned long long)neg[w]);
+                sep = " | ";
+            }
+        }
+        fprintf(fp, ")");
+    }
+
+    void
+    votes_fn(const CompactModel<config> &model, const std::string &fn) {
+        fprintf(fp, "static inline int\n%s(const uint64_t* x) {\n",
+                fn.c_str());
+        fprintf(fp, "    int sum = %d;\n", model.constant());
+        if (!model.size()) fprintf(fp, "    (void)x;\n");
+        for (size_t k = 0; k < model.size(); k++) {
+            fprintf(fp, "    sum += %d * ", model.weight(k));
+            clause_expr(model, k);
+            fprintf(fp, ";\n");
+        }
+        fprintf(fp, "    return sum;\n}\n\n");
+    }
+
+    // Heaviest clauses first, alternating between the signs, so that the
+    // bound on what's left shrinks as fast as it can.
+    void
+    predict_fn(const CompactModel<config> &model) {
+        std::vector<size_t> pos, neg, order;
+        for (size_t k = 0; k < model.size(); k++)
+            (model.weight(k) > 0 ? pos : neg).push_back(k);
+        auto heavier = [&](size_t a, size_t b) {
+            return std::abs(model.weight(a)) > std::abs(model.weight(b));
+        };
+        std::stable_sort(pos.begin(), pos.end(), heavier);
+        std::stable_sort(neg.begin(), neg.end(), heavier);
+        int pos_left = 0, neg_left = 0;
+        for (size_t k : pos) pos_left += model.weight(k);
+        for (size_t k : neg) neg_left -= model.weight(k);
+        for (size_t i = 0; i < std::max(pos.size(), neg.size()); i++) {
+            if (i < pos.size()) order.push_back(pos[i]);
+            if (i < neg.size()) order.push_back(neg[i]);
+        }
+
+        fprintf(fp, "static inline bool\n%s_predict(const uint64_t* x) {\n",
+                name.c_str());
+        fprintf(fp, "    int sum = %d;\n", model.constant());
+        if (!model.size()) fprintf(fp, "    (void)x;\n");
+        for (size_t i = 0; i < order.size(); i++) {
+            size_t k = order[i];
+            int w = model.weight(k);
+            (w > 0 ? pos_left : neg_left) -= std::abs(w);
+            fprintf(fp, "    if (");
+            clause_expr(model, k);
+            fprintf(fp, ") sum += %d;\n", w);
+            // The final sum is somewhere in [sum - neg_left, sum + pos_left].
+            if (i % group == group - 1 && i + 1 < order.size())
+                fprintf(fp,
+                        "    if (sum >= %d) return true;\n"
+                        "    if (sum < %d) return false;\n",
+                        neg_left, -pos_left);
+        }
+        fprintf(fp, "    return sum >= 0;\n}\n\n");
+    }
+
+    // Mirrors Argmax. AM_RANDOM can't draw from
+    // the machine's generator, so it has a xorshift of its own.
+    void
+    argmax(size_t num_classes) {
+        fprintf(fp, "    size_t best = 0;\n");
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        fprintf(fp,
+                "    static thread_local uint64_t tie_rg = "
+                "0x9e3779b97f4a7c15ull;\n"
+                "    size_t ties = 1;\n"
+                "    for (size_t c = 1; c < %zu; c++) {\n"
+                "        if (votes[c] > votes[best]) {\n"
+                "            best = c;\n"
+                "            ties = 1;\n"
+                "        } else if (votes[c] == votes[best]) {\n"
+                "            tie_rg ^= tie_rg << 13;\n"
+                "            tie_rg ^= tie_rg >> 7;\n"
+                "            tie_rg ^= tie_rg << 17;\n"
+                "            if (tie_rg %% ++ties == 0) best = c;\n"
+                "        }\n"
+                "    }\n",
+                num_classes);
+#else
+        fprintf(fp,
+                "    for (size_t c = 1; c < %zu; c++)\n"
+                "        if (votes[c] %s votes[best]) best = c;\n",
+                num_classes, ARGMAX_TIEBREAK == AM_FIRST ? ">" : ">=");
+#endif
+        fprintf(fp, "    return best;\n");
+    }
+
+    static bool
+    is_identifier(const std::string &s) {
+        if (s.empty() || std::isdigit((unsigned char)s[0])) return false;
+        for (char c : s)
+            if (!std::isalnum((unsigned char)c) && c != '_') return false;
+        return true;
+    }
+
+   public:
+    // Writes classes[0, num_classes) to path. One class is a binary model.
+    CppModelWriter(const char *path, const char *model_name,
+                   const CompactModel<config> *const *classes,
+                   size_t num_classes)
+        : name(model_name) {
+        if (!num_classes)
+            throw std::invalid_argument("Nothing to write.");
+        if (!is_identifier(name))
+            throw std::invalid_argument("Model name " + name +
+                                        " isn't an identifier.");
+        if (!(fp = fopen(path, "w")))
+            throw std::runtime_error("Couldn't create " + std::string(path) +
+                                     ": " + std::strerror(errno));
+        std::string guard = name + "_MODEL_INCLUDE";
+        for (char &c : guard) c = (char)toupper((unsigned char)c);
+
+        fprintf(fp,
+                "// Generated from a trained Tsetlin machine by CodeGen.h.\n"
+                "#ifndef %s\n#define %s\n\n"
+                "#include <cstddef>\n#include <cstdint>\n\n"
+                "static constexpr size_t %s_input_words = %zu;\n\n",
+                guard.c_str(), guard.c_str(), name.c_str(), words);
+        if (num_classes == 1) {
+            votes_fn(*classes[0], name + "_votes");
+            predict_fn(*classes[0]);
+        } else {
+            for (size_t c = 0; c < num_classes; c++)
+                votes_fn(*classes[c],
+                         name + "_votes_" + std::to_string(c));
+            fprintf(fp, "static inline void\n%s_votes(const uint64_t* x, "
+                        "int* votes) {\n", name.c_str());
+            for (size_t c = 0; c < num_classes; c++)
+                fprintf(fp, "    votes[%zu] = %s_votes_%zu(x);\n", c,
+                        name.c_str(), c);
+            fprintf(fp,
+                    "}\n\nstatic inline size_t\n"
+                    "%s_predict(const uint64_t* x) {\n"
+                    "    int votes[%zu];\n"
+                    "    %s_votes(x, votes);\n",
+                    name.c_str(), num_classes, name.c_str());
+            argmax(num_classes);
+            fprintf(fp, "}\n\n");
+        }
+        fprintf(fp, "#endif  // %s\n", guard.c_str());
+        if (ferror(fp) | (fclose(fp) != 0))
+            throw std::runtime_error("Couldn't write " + std::string(path) +
+                                     ".");
+    }
+};
+
+// One model per class, or a single binary one.
+template <typename config>
+static inline void
+write_cpp_model(const char *path, const char *name,
+                const CompactModel<config> *const *classes,
+                size_t num_classes) {
+    CppModelWriter<config>(path, name, classes, num_classes);
+}
+
+template <typename config>
+static inline void
+write_cpp_model(const char *path, const char *name,
+                const CompactModel<config> &model) {
+    const CompactModel<config> *classes[1] = {&model};
+    write_cpp_model(path, name, classes, 1);
+}
+
+#endif  // CODEGEN_INCLUDE
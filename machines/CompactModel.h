@@ -0,0 +1,121 @@
+#ifndef COMPACT_MODEL_INCLUDE
+#define COMPACT_MODEL_INCLUDE
+
+#include <cstddef>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../utils/TsetlinBitset.h"
+#include "TsetlinMachine.h"
+
+// A trained machine shrunk down for inference. Trained machines are full of
+// clauses that don't need evaluating one by one:
+//  - Clauses that include some inp and its ~inp (the 'X' in print_clause)
+//    can never be true, and are dropped.
+//  - Clauses that include nothing are always true, and become a constant
+//    bias.
+//  - Clauses with the same includes always agree, and become one clause
+//    weighted by how many positive copies there are minus how many negative
+//    ones. Copies that cancel out are dropped altogether.
+// What's left is evaluated like a snapshot, and votes() is always exactly
+// the machine's votes().
+template <typename config>
+class CompactModel {
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t num_clauses = config::num_clauses;
+    static constexpr size_t words = TBitset<input_bits>::buf_len;
+
+    // Clause k's inp mask, then its ~inp mask, words each.
+    std::vector<tint> masks;
+    std::vector<int> weights;
+    int bias = 0;
+    size_t num_contradictions = 0, num_always_true = 0;
+
+   public:
+    explicit CompactModel(const TsetlinMachine<config> &machine) {
+        // Sorted by mask, so the layout doesn't depend on the clause order.
+        std::map<std::vector<tint>, int> merged;
+        std::vector<tint> m(2 * words);
+        for (size_t c = 0; c < num_clauses; c++) {
+            int vote = c < num_clauses / 2 ? 1 : -1;
+            machine.include_masks(c, m.data(), m.data() + words);
+            tint contradiction = 0, any = 0;
+            for (size_t w = 0; w < words; w++) {
+                contradiction |= m[w] & m[words + w];
+                any |= m[w] | m[words + w];
+            }
+            if (contradiction) {
+                num_contradictions++;
+            } else if (!any) {
+                num_always_true++;
+                bias += vote;
+            } else {
+                merged[m] += vote;
+            }
+        }
+        for (auto &[mask, weight] : merged) {
+            if (!weight) continue;
+            masks.insert(masks.end(), mask.begin(), mask.end());
+            weights.push_back(weight);
+        }
+    }
+
+    // Clauses left to evaluate.
+    size_t
+    size() const noexcept {
+        return weights.size();
+    }
+
+    int
+    constant() const noexcept {
+        return bias;
+    }
+
+    int
+    weight(size_t k) const noexcept {
+        return weights[k];
+    }
+
+    // Clause k's inp mask, then its ~inp mask, like a snapshot's.
+    const tint *
+    clause_masks(size_t k) const noexcept {
+        return masks.data() + k * 2 * words;
+    }
+
+    bool
+    clause_forward(size_t k, const TBitset<input_bits> &input) const noexcept {
+        const tint *pos = clause_masks(k), *neg = pos + words;
+        tint violated = 0;
+        for (size_t w = 0; w < words; w++)
+            violated |= (~input.buf[w] & pos[w]) | (input.buf[w] & neg[w]);
+        return !violated;
+    }
+
+    int
+    votes(const TBitset<input_bits> &input) const noexcept {
+        int sum = bias;
+        for (size_t k = 0; k < weights.size(); k++)
+            sum += weights[k] * clause_forward(k, input);
+        return sum;
+    }
+
+    bool
+    forward(const TBitset<input_bits> &input) const noexcept {
+        return TsetlinMachine<config>::threshold_forward(votes(input));
+    }
+
+    std::string
+    to_string() const {
+        char line[192];
+        snprintf(line, sizeof(line),
+                 "%zu clauses -> %zu (%zu contradictions dropped, %zu always "
+                 "true folded into a bias of %d, %zu merged or cancelled)",
+                 num_clauses, size(), num_contradictions, num_always_true, bias,
+                 num_clauses - num_contradictions - num_always_true - size());
+        return line;
+    }
+};
+
+#endif  // COMPACT_MODEL_INCLUDE
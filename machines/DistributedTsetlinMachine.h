@@ -0,0 +1,170 @@
+#ifndef DISTRIBUTED_TSETLIN_MACHINE_INCLUDE
+#define DISTRIBUTED_TSETLIN_MACHINE_INCLUDE
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../utils/TsetlinTransport.h"
+#include "TsetlinMachine.h"
+
+// How the work is split between the workers.
+//
+// CLAUSE_SHARDS: Every worker sees every sample, but only holds
+// config::num_clauses clauses of the whole machine. Clause vote sums are
+// all-reduced before the backward pass, so each shard gets exactly the
+// feedback it would have gotten as part of one big machine.
+//
+// DATA_SHARDS: Every worker holds a full replica and trains on its own slice
+// of the samples. Replicas are averaged every sync_every samples.
+enum class ShardMode { CLAUSE_SHARDS, DATA_SHARDS };
+
+template <typename config, TsetlinTransport Transport>
+class DistributedTsetlinMachine {
+    using Machine = TsetlinMachine<config>;
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t num_clauses = config::num_clauses;
+    static constexpr size_t sync_chunk = 1 << 16;
+
+    Transport& transport;
+    ShardMode mode;
+    size_t sync_every;
+    size_t since_sync = 0;
+    std::unique_ptr<Machine> machine;
+    std::vector<int64_t> sync_buf;
+
+    // Keep per-rank random streams apart.
+    static constexpr uint64_t rank_seed_stride = 0x9e3779b97f4a7c15;
+
+    static inline int64_t
+    floor_div(int64_t a, int64_t b) {
+        int64_t q = a / b;
+        return q - ((a % b != 0) & ((a < 0) != (b < 0)));
+    }
+
+   public:
+    DistributedTsetlinMachine(Transport& comm, ShardMode shard_mode,
+                              size_t steps_per_sync = 1000,
+                              uint64_t seed = 0xabcdef0123456789)
+        : transport(comm),
+          mode(shard_mode),
+          sync_every(steps_per_sync),
+          machine(new Machine(seed + comm.rank() * rank_seed_stride)) {
+        // Replicas have to start out identical. Shards don't.
+        if (mode == ShardMode::DATA_SHARDS) broadcast_model();
+    }
+
+    Machine&
+    local_machine() noexcept {
+        return *machine;
+    }
+
+    size_t
+    rank() const noexcept {
+        return transport.rank();
+    }
+
+    size_t
+    world_size() const noexcept {
+        return transport.world_size();
+    }
+
+    // Whether this rank trains on sample_idx.
+    bool
+    owns(size_t sample_idx) const noexcept {
+        return mode == ShardMode::CLAUSE_SHARDS ||
+               sample_idx % transport.world_size() == transport.rank();
+    }
+
+    // The vote sum of the whole distributed machine. Collective in
+    // CLAUSE_SHARDS mode.
+    int64_t
+    vote_sum(const TBitset<input_bits>& input) {
+        TBitset<num_clauses> clause_outputs;
+        machine->clauses_forward(input, clause_outputs);
+        int64_t sum = Machine::summation_forward(clause_outputs);
+        if (mode == ShardMode::CLAUSE_SHARDS) transport.allreduce_sum(&sum, 1);
+        return sum;
+    }
+
+    bool
+    forward(const TBitset<input_bits>& input) {
+        return Machine::threshold_forward(vote_sum(input));
+    }
+
+    // Call for every sample of the epoch, in the same order on every rank,
+    // so that the collectives line up. Returns the prediction made before the
+    // update, or -1 if this rank skipped the sample.
+    int
+    forward_backward(size_t sample_idx, const TBitset<input_bits>& input,
+                     bool desired_output) {
+        if (mode == ShardMode::CLAUSE_SHARDS) {
+            TBitset<num_clauses> clause_outputs;
+            machine->clauses_forward(input, clause_outputs);
+            int64_t sum = Machine::summation_forward(clause_outputs);
+            transport.allreduce_sum(&sum, 1);
+            machine->backward(input, desired_output, clause_outputs, (int)sum);
+            return Machine::threshold_forward(sum);
+        }
+
+        int output = -1;
+        if (owns(sample_idx))
+            output = machine->forward_backward(input, desired_output);
+        if (++since_sync == sync_every) sync_model();
+        return output;
+    }
+
+    // Flush any pending model sync. Call at the end of every epoch.
+    void
+    finish_epoch() {
+        if (mode == ShardMode::DATA_SHARDS && since_sync) sync_model();
+    }
+
+    // Average the automata of every replica. Rounds toward exclude, so that
+    // an include only survives if the replicas mostly agree on it.
+    void
+    sync_model() {
+        since_sync = 0;
+        auto* states = machine->get_backing();
+        size_t len = Machine::get_backing_size();
+        int64_t world = (int64_t)transport.world_size();
+
+        sync_buf.resize(std::min(len, sync_chunk));
+        for (size_t off = 0; off < len; off += sync_chunk) {
+            size_t n = std::min(sync_chunk, len - off);
+            for (size_t i = 0; i < n; i++) sync_buf[i] = states[off + i];
+            transport.allreduce_sum(sync_buf.data(), n);
+            for (size_t i = 0; i < n; i++)
+                states[off + i] = floor_div(sync_buf[i], world);
+        }
+        machine->recount_included();
+    }
+
+    // Overwrite every replica with rank 0's.
+    void
+    broadcast_model() {
+        auto* states = machine->get_backing();
+        size_t len = Machine::get_backing_size();
+
+        sync_buf.resize(std::min(len, sync_chunk));
+        for (size_t off = 0; off < len; off += sync_chunk) {
+            size_t n = std::min(sync_chunk, len - off);
+            for (size_t i = 0; i < n; i++) sync_buf[i] = states[off + i];
+            transport.broadcast(sync_buf.data(), n);
+            for (size_t i = 0; i < n; i++) states[off + i] = sync_buf[i];
+        }
+        machine->recount_included();
+    }
+
+    // Sum a per-rank counter (accuracy, etc.) over every rank.
+    size_t
+    allreduce_count(size_t local) {
+        int64_t c = (int64_t)local;
+        transport.allreduce_sum(&c, 1);
+        return (size_t)c;
+    }
+};
+
+#endif  // DISTRIBUTED_TSETLIN_MACHINE_INCLUDE
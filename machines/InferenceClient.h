@@ -0,0 +1,96 @@
+#ifndef INFERENCE_CLIENT_INCLUDE
+#define INFERENCE_CLIENT_INCLUDE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../utils/InferenceProtocol.h"
+#include "../utils/TsetlinBitset.h"
+
+struct InferenceResult {
+    uint64_t id = 0;
+    uint32_t status = INFER_OK;
+    size_t predicted = 0;
+    std::vector<int> votes;  // One per class, or one for a binary model
+};
+
+// One connection to an InferenceServer. Either call infer() and wait for
+// each answer, or keep several requests in flight with send() and
+// receive(), which answers them in the order they were sent. A client is
+// for one thread at a time; open one per thread.
+template <size_t input_bits>
+class InferenceClient {
+    int fd = -1;
+    uint64_t next_id = 0;
+
+   public:
+    // The server might not be listening yet, so keep retrying for about
+    // wait_ms.
+    explicit InferenceClient(const char* path, size_t wait_ms = 5000) {
+        sockaddr_un addr = inference_addr(path);
+        for (size_t attempt = 0;; attempt++) {
+            if ((fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1)
+                inference_panic("socket");
+            if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) break;
+            ::close(fd);
+            if (attempt >= wait_ms) inference_panic("connect");
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    InferenceClient(const InferenceClient&) = delete;
+    InferenceClient& operator=(const InferenceClient&) = delete;
+
+    ~InferenceClient() { ::close(fd); }
+
+    // Queues a request for the model'th model on the server. Returns its
+    // id.
+    uint64_t
+    send(uint32_t model, const TBitset<input_bits>& input) {
+        struct {
+            InferenceRequestHeader header;
+            tint words[TBitset<input_bits>::buf_len];
+        } msg;
+        msg.header = {inference_magic, model, next_id,
+                      TBitset<input_bits>::buf_len};
+        for (size_t w = 0; w < TBitset<input_bits>::buf_len; w++)
+            msg.words[w] = input.buf[w];
+        if (!inference_send_all(fd, &msg, sizeof(msg)))
+            throw std::runtime_error("Inference server hung up.");
+        return next_id++;
+    }
+
+    // The answer to the oldest request not yet received.
+    InferenceResult
+    receive() {
+        InferenceResponseHeader h;
+        if (!inference_recv_all(fd, &h, sizeof(h)))
+            throw std::runtime_error("Inference server hung up.");
+        InferenceResult r;
+        r.id = h.id;
+        r.status = h.status;
+        r.predicted = h.predicted;
+        r.votes.resize(h.num_votes);
+        if (h.num_votes &&
+            !inference_recv_all(fd, r.votes.data(), h.num_votes * sizeof(int)))
+            throw std::runtime_error("Inference server hung up.");
+        return r;
+    }
+
+    InferenceResult
+    infer(uint32_t model, const TBitset<input_bits>& input) {
+        send(model, input);
+        return receive();
+    }
+};
+
+#endif  // INFERENCE_CLIENT_INCLUDE
@@ -0,0 +1,495 @@
+#ifndef INFERENCE_SERVER_INCLUDE
+#define INFERENCE_SERVER_INCLUDE
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../utils/InferenceProtocol.h"
+#include "../utils/Trace.h"
+#include "../utils/TsetlinBitset.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "Argmax.h"
+#include "ModelFile.h"
+#include "MultiClassTsetlinMachine.h"
+#include "TsetlinMachine.h"
+#include "TsetlinSnapshot.h"
+
+// A model as the server sees it. One snapshot is a binary model, predicting
+// 1 when its votes are non-negative. More than one is a multi-class model,
+// predicting the class with the most votes (ties broken by Argmax, like
+// MultiClassTsetlinMachine).
+template <typename config>
+using InferenceModel = std::vector<std::unique_ptr<TsetlinSnapshot<config>>>;
+
+template <typename config>
+static inline InferenceModel<config>
+inference_model(const TsetlinMachine<config>& machine) {
+    InferenceModel<config> model;
+    model.emplace_back(new TsetlinSnapshot<config>(machine));
+    return model;
+}
+
+template <size_t num_classes, typename config>
+static inline InferenceModel<config>
+inference_model(const MultiClassTsetlinMachine<num_classes, config>& machine) {
+    InferenceModel<config> model;
+    for (size_t c = 0; c < num_classes; c++)
+        model.emplace_back(new TsetlinSnapshot<config>(machine.machine(c)));
+    return model;
+}
+
+// From a file written by save_model(). Only one machine is in memory at a
+// time.
+template <typename config>
+static inline InferenceModel<config>
+load_inference_model(const char* path) {
+    InferenceModel<config> model;
+    auto machine =
+        std::unique_ptr<TsetlinMachine<config>>(new TsetlinMachine<config>());
+    size_t n = model_file_machines<config>(path);
+    for (size_t i = 0; i < n; i++) {
+        load_model(path, *machine, i);
+        model.emplace_back(new TsetlinSnapshot<config>(*machine));
+    }
+    return model;
+}
+
+struct InferenceServerOptions {
+    // The most requests evaluated together.
+    size_t max_batch = 64;
+    // The longest the first request of a batch waits for others to join
+    // it. Only waited when requests are arriving faster than this.
+    double max_wait_us = 200;
+    size_t threads = std::thread::hardware_concurrency();
+    // Latencies kept for the percentiles.
+    size_t latency_window = 1 << 16;
+};
+
+// Latencies are from a request being read off its socket to its response
+// being ready to write, over the last latency_window requests.
+struct InferenceStats {
+    uint64_t requests = 0;
+    uint64_t batches = 0;
+    double seconds = 0;  // Since the server started
+    double p50_us = 0, p99_us = 0, max_us = 0;
+
+    double
+    requests_per_sec() const noexcept {
+        return seconds ? requests / seconds : 0;
+    }
+    double
+    mean_batch() const noexcept {
+        return batches ? (double)requests / batches : 0;
+    }
+
+    std::string
+    to_string() const {
+        char line[192];
+        snprintf(line, sizeof(line),
+                 "%llu requests in %llu batches (%.1f per batch), %.1f "
+                 "requests/sec, latency p50 %.1fus p99 %.1fus max %.1fus",
+                 (unsigned long long)requests, (unsigned long long)batches,
+                 mean_batch(), requests_per_sec(), p50_us, p99_us, max_us);
+        return line;
+    }
+};
+
+// Serves predictions from a set of models over a Unix domain socket, so
+// applications don't need to link the machine. One thread does all the
+// socket I/O and queues requests. Another takes them off the queue in
+// micro-batches, evaluates each batch across the pool, and writes the
+// responses. A batch goes as soon as it's full or its first request has
+// waited max_wait_us. When requests are sparse it goes immediately, since
+// waiting would only add latency.
+//
+// Every model must take config's input size. Requests for other sizes are
+// answered with INFER_BAD_SHAPE.
+template <typename config>
+class InferenceServer {
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t words = TBitset<input_bits>::buf_len;
+    // Longer requests than this are garbage, not a shape mismatch.
+    static constexpr size_t max_input_words = 1 << 20;
+    using Clock = std::chrono::steady_clock;
+
+    struct Connection {
+        int fd;
+        std::vector<char> in;
+        bool broken = false;  // Batcher only
+        explicit Connection(int socket) : fd(socket) {}
+        ~Connection() { ::close(fd); }
+    };
+
+    struct Request {
+        std::shared_ptr<Connection> conn;
+        InferenceRequestHeader header;
+        uint32_t status;
+        TBitset<input_bits> input;
+        Clock::time_point arrival;
+    };
+
+    std::vector<InferenceModel<config>> models;
+    size_t max_votes = 0;
+    Argmax argmax;
+    InferenceServerOptions options;
+    TThreadpool pool;
+    std::string path;
+    int listen_fd = -1;
+    int wake_fds[2] = {-1, -1};
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::deque<Request> queue;
+    bool stopping = false;
+    Clock::time_point last_arrival;
+    double arrival_gap_us = 1e9;  // Moving average
+
+    std::mutex stats_mutex;
+    std::vector<float> latencies;  // Ring, microseconds
+    size_t latency_next = 0;
+    uint64_t num_requests = 0, num_batches = 0;
+    Clock::time_point start;
+
+    std::thread io_thread, batch_thread;
+
+    // Pulls every complete request out of conn's buffer. False if the
+    // connection is speaking something else and should be dropped.
+    bool
+    parse(const std::shared_ptr<Connection>& conn, std::vector<Request>& out) {
+        std::vector<char>& in = conn->in;
+        size_t off = 0;
+        Clock::time_point now = Clock::now();
+        while (in.size() - off >= sizeof(InferenceRequestHeader)) {
+            Request r;
+            std::memcpy(&r.header, in.data() + off, sizeof(r.header));
+            if (r.header.magic != inference_magic ||
+                r.header.input_words > max_input_words)
+                return false;
+            size_t len = sizeof(r.header) + r.header.input_words * sizeof(tint);
+            if (in.size() - off < len) break;
+
+            r.conn = conn;
+            r.arrival = now;
+            if (r.header.model >= models.size()) {
+                r.status = INFER_BAD_MODEL;
+            } else if (r.header.input_words != words) {
+                r.status = INFER_BAD_SHAPE;
+            } else {
+                r.status = INFER_OK;
+                std::memcpy(r.input.buf, in.data() + off + sizeof(r.header),
+                            words * sizeof(tint));
+            }
+            out.push_back(std::move(r));
+            off += len;
+        }
+        in.erase(in.begin(), in.begin() + off);
+        return true;
+    }
+
+    void
+    enqueue(std::vector<Request>& requests) {
+        if (requests.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Request& r : requests) {
+            double gap = std::chrono::duration<double, std::micro>(
+                             r.arrival - last_arrival)
+                             .count();
+            arrival_gap_us = .9 * arrival_gap_us + .1 * gap;
+            last_arrival = r.arrival;
+            queue.push_back(std::move(r));
+        }
+        requests.clear();
+        cv.notify_all();
+    }
+
+    void
+    run_io() {
+        TSETLIN_TRACE_THREAD_NAME("inference io");
+        std::vector<std::shared_ptr<Connection>> conns;
+        std::vector<pollfd> fds;
+        std::vector<Request> parsed;
+        char buf[1 << 16];
+        for (;;) {
+            fds.clear();
+            fds.push_back({wake_fds[0], POLLIN, 0});
+            fds.push_back({listen_fd, POLLIN, 0});
+            for (auto& c : conns) fds.push_back({c->fd, POLLIN, 0});
+            if (::poll(fds.data(), fds.size(), -1) == -1) {
+                // Out of memory for the poll set, most likely. Let it pass
+                // rather than take the server down.
+                if (errno != EINTR) {
+                    std::fprintf(stderr, "Inference server poll: %s\n",
+                                 std::strerror(errno));
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+                continue;
+            }
+            if (fds[0].revents) return;
+
+            if (fds[1].revents & POLLIN) {
+                int fd = ::accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+                if (fd != -1) conns.push_back(std::make_shared<Connection>(fd));
+            }
+
+            // Iterate the poll results, since conns may have grown.
+            for (size_t i = 2, k = 0; i < fds.size(); i++) {
+                std::shared_ptr<Connection>& c = conns[k];
+                bool keep = true;
+                if (fds[i].revents) {
+                    try {
+                        ssize_t r = ::recv(c->fd, buf, sizeof(buf), 0);
+                        if (r > 0) {
+                            c->in.insert(c->in.end(), buf, buf + r);
+                            keep = parse(c, parsed);
+                        } else if (r == 0 || errno != EINTR) {
+                            keep = false;
+                        }
+                    } catch (const std::exception& e) {
+                        drop(*c, e);
+                        keep = false;
+                    }
+                }
+                // Queued requests keep a dropped connection alive until
+                // they're answered.
+                if (keep)
+                    k++;
+                else
+                    conns.erase(conns.begin() + k);
+            }
+            enqueue(parsed);
+        }
+    }
+
+    void
+    run_batches() {
+        TSETLIN_TRACE_THREAD_NAME("inference batcher");
+        std::vector<Request> batch;
+        std::vector<int> votes;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cv.wait(lock, [&] { return stopping || !queue.empty(); });
+                if (stopping) return;
+                if (arrival_gap_us < options.max_wait_us) {
+                    auto deadline =
+                        queue.front().arrival +
+                        std::chrono::duration_cast<Clock::duration>(
+                            std::chrono::duration<double, std::micro>(
+                                options.max_wait_us));
+                    cv.wait_until(lock, deadline, [&] {
+                        return stopping || queue.size() >= options.max_batch;
+                    });
+                    if (stopping) return;
+                }
+                size_t n = std::min(queue.size(), options.max_batch);
+                for (size_t j = 0; j < n; j++) {
+                    batch.push_back(std::move(queue.front()));
+                    queue.pop_front();
+                }
+            }
+            run_batch(batch, votes);
+            batch.clear();
+        }
+    }
+
+    // Evaluates the batch, model by model and class by class, and answers
+    // it in order.
+    void
+    run_batch(std::vector<Request>& batch, std::vector<int>& votes) {
+        TSETLIN_TRACE_SPAN("inference batch", batch.size());
+        size_t n = batch.size();
+        votes.assign(n * max_votes, 0);
+        std::vector<const TBitset<input_bits>*> inputs;
+        std::vector<size_t> index;
+        std::vector<int> out;
+        for (size_t m = 0; m < models.size(); m++) {
+            inputs.clear();
+            index.clear();
+            for (size_t j = 0; j < n; j++)
+                if (batch[j].status == INFER_OK && batch[j].header.model == m) {
+                    inputs.push_back(&batch[j].input);
+                    index.push_back(j);
+                }
+            if (inputs.empty()) continue;
+            out.resize(inputs.size());
+            for (size_t c = 0; c < models[m].size(); c++) {
+                pool.parallel_for(
+                    inputs.size(), [&](size_t begin, size_t end, size_t) {
+                        models[m][c]->votes_batch(inputs.data() + begin,
+                                                  end - begin,
+                                                  out.data() + begin);
+                    });
+                for (size_t i = 0; i < index.size(); i++)
+                    votes[index[i] * max_votes + c] = out[i];
+            }
+        }
+        record(batch);
+
+        for (size_t j = 0; j < n; j++) {
+            Request& r = batch[j];
+            const int* v = votes.data() + j * max_votes;
+            InferenceResponseHeader h;
+            std::memset(&h, 0, sizeof(h));
+            h.id = r.header.id;
+            h.status = r.status;
+            if (r.status == INFER_OK) {
+                size_t k = models[r.header.model].size();
+                h.num_votes = (uint32_t)k;
+                if (k == 1) {
+                    h.predicted =
+                        TsetlinMachine<config>::threshold_forward(v[0]);
+                } else {
+                    h.predicted = (uint32_t)argmax(v, k);
+                }
+            }
+            Connection& c = *r.conn;
+            if (c.broken) continue;
+            try {
+                c.broken =
+                    !inference_send_all(c.fd, &h, sizeof(h)) ||
+                    !inference_send_all(c.fd, v, h.num_votes * sizeof(int));
+            } catch (const std::exception& e) {
+                c.broken = true;
+                drop(c, e);
+            }
+        }
+    }
+
+    // Counts the batch in the stats. Called before the responses go out, so
+    // a client that has its answer also sees it counted.
+    void
+    record(const std::vector<Request>& batch) {
+        Clock::time_point now = Clock::now();
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        for (const Request& r : batch) {
+            latencies[latency_next] =
+                std::chrono::duration<float, std::micro>(now - r.arrival)
+                    .count();
+            latency_next = (latency_next + 1) % latencies.size();
+        }
+        num_requests += batch.size();
+        num_batches++;
+    }
+
+    // Gives up on a connection that failed with something other than a
+    // hang up. Shutting it down rather than closing it makes the I/O thread
+    // see the end of the stream and forget it, and the descriptor is closed
+    // once nothing refers to it. Everyone else keeps being served.
+    static void
+    drop(Connection& c, const std::exception& e) {
+        std::fprintf(stderr, "Inference connection %d dropped: %s\n", c.fd,
+                     e.what());
+        ::shutdown(c.fd, SHUT_RDWR);
+    }
+
+   public:
+    InferenceServer(const char* socket_path,
+                    std::vector<InferenceModel<config>> served,
+                    InferenceServerOptions opts = InferenceServerOptions())
+        : models(std::move(served)),
+          options(opts),
+          pool(std::max<size_t>(opts.threads, 1)),
+          path(socket_path) {
+        if (models.empty())
+            throw std::invalid_argument("An inference server needs a model.");
+        for (auto& m : models) {
+            if (m.empty())
+                throw std::invalid_argument("A model needs a machine.");
+            max_votes = std::max(max_votes, m.size());
+        }
+        if (!options.max_batch || !options.latency_window)
+            throw std::invalid_argument("Bad inference server options.");
+        latencies.assign(options.latency_window, 0);
+
+        sockaddr_un addr = inference_addr(socket_path);
+        ::unlink(socket_path);
+        if ((listen_fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) ==
+            -1)
+            inference_panic("socket");
+        if (::bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1 ||
+            ::listen(listen_fd, 128) == -1 ||
+            ::pipe2(wake_fds, O_CLOEXEC) == -1) {
+            int e = errno;
+            ::close(listen_fd);
+            errno = e;
+            inference_panic("Couldn't listen on inference socket");
+        }
+
+        start = last_arrival = Clock::now();
+        batch_thread = std::thread([this] { run_batches(); });
+        io_thread = std::thread([this] { run_io(); });
+    }
+
+    InferenceServer(const InferenceServer&) = delete;
+    InferenceServer& operator=(const InferenceServer&) = delete;
+
+    // Stops listening and drops every connection. Requests not yet answered
+    // are abandoned.
+    ~InferenceServer() {
+        char c = 0;
+        while (::write(wake_fds[1], &c, 1) == -1 && errno == EINTR) {
+        }
+        io_thread.join();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        batch_thread.join();
+        queue.clear();
+        ::close(listen_fd);
+        ::close(wake_fds[0]);
+        ::close(wake_fds[1]);
+        ::unlink(path.c_str());
+    }
+
+    size_t
+    num_models() const noexcept {
+        return models.size();
+    }
+
+    InferenceStats
+    stats() {
+        std::vector<float> window;
+        InferenceStats s;
+        {
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            s.requests = num_requests;
+            s.batches = num_batches;
+            s.seconds =
+                std::chrono::duration<double>(Clock::now() - start).count();
+            size_t filled = std::min<uint64_t>(num_requests, latencies.size());
+            window.assign(latencies.begin(), latencies.begin() + filled);
+        }
+        if (window.empty()) return s;
+        auto percentile = [&](double p) {
+            size_t k = std::min(window.size() - 1, (size_t)(p * window.size()));
+            std::nth_element(window.begin(), window.begin() + k, window.end());
+            return (double)window[k];
+        };
+        s.p50_us = percentile(.5);
+        s.p99_us = percentile(.99);
+        s.max_us = *std::max_element(window.begin(), window.end());
+        return s;
+    }
+};
+
+#endif  // INFERENCE_SERVER_INCLUDE
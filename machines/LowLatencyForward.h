@@ -0,0 +1,159 @@
+#ifndef LOW_LATENCY_FORWARD_INCLUDE
+#define LOW_LATENCY_FORWARD_INCLUDE
+
+#include <pthread.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "../utils/Trace.h"
+#include "../utils/TsetlinBitset.h"
+#include "TsetlinMachine.h"
+
+// One sample's forward pass split across a few threads, for when the latency
+// of a single prediction matters more than throughput. Each thread owns a
+// fixed range of clauses, evaluates it, and sums its votes into its own
+// cache line. The caller is thread 0, and adds the partial sums up.
+//
+// The other threads spin waiting for work instead of sleeping, since waking
+// a sleeping thread takes longer than a forward pass on a small range. They
+// burn their cores while idle, so give them cores nothing else needs, and
+// keep the instance only as long as the latency-critical path needs it.
+// After enough polls without work they fall back to yielding, and with more
+// threads than cores they yield straight away, so an oversubscribed machine
+// still makes progress.
+//
+// Model is TsetlinMachine or TsetlinSnapshot, anything with
+// votes_range(input, begin, end). It must not change while forward() runs.
+// One thread calls forward() at a time.
+template <typename config, template <typename> class Model = TsetlinMachine>
+class LowLatencyForward {
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t num_clauses = config::num_clauses;
+    static constexpr uint64_t stop = UINT64_MAX;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> done{0};  // Generation last finished
+        int partial = 0;
+        size_t begin = 0, end = 0;
+    };
+
+    const Model<config> &model;
+    // The input of the current generation. Written before generation is
+    // bumped, read after it's seen.
+    const TBitset<input_bits> *input = nullptr;
+    alignas(64) std::atomic<uint64_t> generation{0};
+    std::unique_ptr<Slot[]> slots;
+    size_t num_threads;
+    size_t spin_limit;  // Polls before yielding
+    std::vector<std::thread> threads;
+
+    static inline void
+    cpu_relax() noexcept {
+#if defined(__x86_64__) || defined(__i386__)
+        _mm_pause();
+#endif
+    }
+
+    static void
+    pin(std::thread &t, int cpu) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        // Best effort. Unpinned only costs some latency.
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+    }
+
+    void
+    work(size_t t) {
+        TSETLIN_TRACE_THREAD_NAME("forward worker " + std::to_string(t));
+        Slot &slot = slots[t];
+        uint64_t seen = 0;
+        for (;;) {
+            uint64_t g;
+            size_t spins = 0;
+            while ((g = generation.load(std::memory_order_acquire)) == seen) {
+                if (++spins < spin_limit)
+                    cpu_relax();
+                else
+                    std::this_thread::yield();
+            }
+            if (g == stop) return;
+            seen = g;
+            slot.partial = model.votes_range(*input, slot.begin, slot.end);
+            slot.done.store(g, std::memory_order_release);
+        }
+    }
+
+   public:
+    // Splits the clauses evenly over num_threads, the caller included.
+    // Thread t > 0 is pinned to cpus[t - 1] if given, otherwise to core t.
+    LowLatencyForward(const Model<config> &evaluated, size_t thread_count,
+                      const std::vector<int> &cpus = {})
+        : model(evaluated),
+          slots(new Slot[std::max<size_t>(thread_count, 1)]),
+          num_threads(std::max<size_t>(thread_count, 1)) {
+        size_t t_n = num_threads;
+        for (size_t t = 0; t < t_n; t++) {
+            slots[t].begin = num_clauses * t / t_n;
+            slots[t].end = num_clauses * (t + 1) / t_n;
+        }
+        int cores = std::max<int>(std::thread::hardware_concurrency(), 1);
+        spin_limit = t_n <= (size_t)cores ? 1 << 16 : 0;
+        for (size_t t = 1; t < t_n; t++) {
+            threads.emplace_back([this, t] { work(t); });
+            pin(threads.back(),
+                t - 1 < cpus.size() ? cpus[t - 1] : (int)t % cores);
+        }
+    }
+
+    LowLatencyForward(const LowLatencyForward &) = delete;
+    LowLatencyForward &operator=(const LowLatencyForward &) = delete;
+
+    ~LowLatencyForward() {
+        generation.store(stop, std::memory_order_release);
+        for (std::thread &t : threads) t.join();
+    }
+
+    size_t
+    size() const noexcept {
+        return num_threads;
+    }
+
+    int
+    votes(const TBitset<input_bits> &x) {
+        input = &x;
+        uint64_t g = generation.load(std::memory_order_relaxed) + 1;
+        generation.store(g, std::memory_order_release);
+
+        int sum = model.votes_range(x, slots[0].begin, slots[0].end);
+        for (size_t t = 1; t < num_threads; t++) {
+            size_t spins = 0;
+            while (slots[t].done.load(std::memory_order_acquire) != g)
+                if (++spins < spin_limit)
+                    cpu_relax();
+                else
+                    std::this_thread::yield();
+            sum += slots[t].partial;
+        }
+        return sum;
+    }
+
+    bool
+    forward(const TBitset<input_bits> &x) {
+        return TsetlinMachine<config>::threshold_forward(votes(x));
+    }
+};
+
+#endif  // LOW_LATENCY_FORWARD_INCLUDE
@@ -0,0 +1,128 @@
+#ifndef MODEL_FILE_INCLUDE
+#define MODEL_FILE_INCLUDE
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "TsetlinMachine.h"
+
+// A trained model on disk: a header, then the raw automata of each machine
+// (one per class, or just one) in get_backing() order. Only loads into
+// machines of exactly the same shape.
+
+static constexpr char model_file_magic[8] = {'T', 'S', 'E', 'T',
+                                             'M', 'O', 'D', '1'};
+
+struct ModelFileHeader {
+    char magic[8];
+    uint64_t input_bits;
+    uint64_t num_clauses;
+    uint64_t num_states;
+    uint64_t automaton_bytes;
+    uint64_t num_machines;
+};
+
+template <typename config>
+static inline ModelFileHeader
+model_file_header(size_t num_machines) {
+    ModelFileHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, model_file_magic, sizeof(h.magic));
+    h.input_bits = config::input_bits;
+    h.num_clauses = config::num_clauses;
+    h.num_states = config::num_states;
+    h.automaton_bytes = sizeof(config::TsetlinAutomaton);
+    h.num_machines = num_machines;
+    return h;
+}
+
+// Writes to a temporary file and renames it into place, like the dataset
+// cache, so a server never loads half a model.
+template <typename config>
+static inline void
+save_model(const char* path, const TsetlinMachine<config>* const* machines,
+           size_t num_machines) {
+    using Machine = TsetlinMachine<config>;
+    ModelFileHeader h = model_file_header<config>(num_machines);
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* fp = std::fopen(tmp.c_str(), "wb");
+    if (!fp)
+        throw std::runtime_error("Couldn't create " + tmp + ": " +
+                                 std::strerror(errno));
+    bool ok = std::fwrite(&h, sizeof(h), 1, fp) == 1;
+    for (size_t i = 0; ok && i < num_machines; i++)
+        ok = std::fwrite(machines[i]->get_backing(),
+                         sizeof(config::TsetlinAutomaton),
+                         Machine::get_backing_size(),
+                         fp) == Machine::get_backing_size();
+    ok &= std::fclose(fp) == 0;
+    if (!ok || std::rename(tmp.c_str(), path) == -1) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Couldn't write model " + std::string(path) +
+                                 ".");
+    }
+}
+
+template <typename config>
+static inline void
+save_model(const char* path, const TsetlinMachine<config>& machine) {
+    const TsetlinMachine<config>* machines[1] = {&machine};
+    save_model(path, machines, 1);
+}
+
+// How many machines a model file holds, checking that they're the shape of
+// config.
+template <typename config>
+static inline size_t
+model_file_machines(const char* path) {
+    FILE* fp = std::fopen(path, "rb");
+    if (!fp)
+        throw std::runtime_error("Couldn't open model " + std::string(path) +
+                                 ": " + std::strerror(errno));
+    ModelFileHeader h, want = model_file_header<config>(0);
+    bool ok = std::fread(&h, sizeof(h), 1, fp) == 1;
+    std::fclose(fp);
+    want.num_machines = h.num_machines;
+    if (!ok || std::memcmp(&h, &want, sizeof(h)))
+        throw std::runtime_error("Model " + std::string(path) +
+                                 " isn't a model of this shape.");
+    return h.num_machines;
+}
+
+// Loads machine i of the model into machine. One at a time, since a model
+// with many classes can be large.
+template <typename config>
+static inline void
+load_model(const char* path, TsetlinMachine<config>& machine, size_t i = 0) {
+    using Machine = TsetlinMachine<config>;
+    size_t num_machines = model_file_machines<config>(path);
+    if (i >= num_machines)
+        throw std::out_of_range("Model " + std::string(path) + " has " +
+                                std::to_string(num_machines) +
+                                " machines, no machine " + std::to_string(i) +
+                                ".");
+    FILE* fp = std::fopen(path, "rb");
+    if (!fp)
+        throw std::runtime_error("Couldn't open model " + std::string(path) +
+                                 ": " + std::strerror(errno));
+    long offset = (long)(sizeof(ModelFileHeader) +
+                         i * Machine::get_backing_size() *
+                             sizeof(config::TsetlinAutomaton));
+    bool ok = std::fseek(fp, offset, SEEK_SET) == 0 &&
+              std::fread(machine.get_backing(),
+                         sizeof(config::TsetlinAutomaton),
+                         Machine::get_backing_size(),
+                         fp) == Machine::get_backing_size();
+    std::fclose(fp);
+    machine.recount_included();
+    if (!ok)
+        throw std::runtime_error("Model " + std::string(path) +
+                                 " is truncated.");
+}
+
+#endif  // MODEL_FILE_INCLUDE
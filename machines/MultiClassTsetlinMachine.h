@@ -1,53 +1,177 @@
-
-
 #ifndef MULTICLASS_TSETLIN_MACHINE_INCLUDE
 #define MULTICLASS_TSETLIN_MACHINE_INCLUDE
 
+#include <algorithm>
+#include <climits>
 #include <cstddef>
-
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "../utils/Evaluation.h"
+#include "../utils/TsetlinRand.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "Argmax.h"
 #include "TsetlinMachine.h"
 
-#ifndef ARGMAX_TIEBREAK
-#define AM_LAST 0
-#define AM_FIRST 1
-#define AM_RANDOM 2
-#define ARGMAX_TIEBREAK AM_LAST
-#endif  // ARGMAX_TIEBREAK
-
+// One machine per class, each voting for its own class against the rest.
+// The prediction is the class with the most votes.
 template <size_t num_classes, typename config>
 class MultiClassTsetlinMachine {
    private:
     static constexpr size_t input_bits = config::input_bits;
+    static_assert(num_classes >= 2, "Need at least two classes.");
+
+    // Each machine is its own allocation, they can be large.
+    std::unique_ptr<TsetlinMachine<config>> machines[num_classes];
+    uint64_t seed;
+    TsetlinRandGen rgen;
+    // Ties drawn from a stream of this machine's own.
+    Argmax argmax;
+
+    // Before anything is trained, like evaluate() does.
+    static void
+    check_label(size_t label) {
+        if (label >= num_classes)
+            throw std::out_of_range("Class " + std::to_string(label) +
+                                    " out of range.");
+    }
 
-    TsetlinMachine<config> machines[num_classes];
-    bool machine_outputs[num_classes];
-    bool machine_finished[num_classes];
+    // Every class but label, uniformly.
+    template <typename RandGen>
+    static size_t
+    other_class(RandGen &rg, size_t label) {
+        size_t c = rg.rand_64() % (num_classes - 1);
+        return c >= label ? c + 1 : c;
+    }
 
    public:
-    void
-    spin_threads_forward() {
-        auto do_work = [&](TBitset<input_bits> &input, size_t i) {
+    MultiClassTsetlinMachine(uint64_t random_seed = 0xabcdef0123456789)
+        : seed(random_seed),
+          rgen(TsetlinRandGen(random_seed)),
+          argmax(random_seed) {
+        for (size_t c = 0; c < num_classes; c++)
+            machines[c].reset(new TsetlinMachine<config>(
+                random_seed + 0x9e3779b97f4a7c15 * (c + 1)));
+    }
 
-        };
+    TsetlinMachine<config> &
+    machine(size_t c) noexcept {
+        return *machines[c];
+    }
 
-        
+    const TsetlinMachine<config> &
+    machine(size_t c) const noexcept {
+        return *machines[c];
     }
 
-    void
-    spin_threads_forward_backward() {
-        auto do_work = [&](TBitset<input_bits> &input, size_t i) {
+    size_t
+    forward(const TBitset<input_bits> &input) const {
+        int votes[num_classes];
+        for (size_t c = 0; c < num_classes; c++)
+            votes[c] = machines[c]->votes(input);
+        return argmax(votes, num_classes);
+    }
 
-        };
+    // forward(), but stops evaluating a class once it can't win, and stops
+    // altogether once only one class can. All classes go a clause pair at a
+    // time, so after k pairs each is within r = num_clauses / 2 - k of its
+    // final votes, and a class more than 2r behind the leader is out. Ties
+    // are broken among the classes still in, as forward() would. If
+    // evaluated isn't null, it gets how many clauses were looked at over all
+    // classes.
+    size_t
+    forward_early(const TBitset<input_bits> &input,
+                  size_t *evaluated = nullptr) const {
+        static constexpr size_t pairs = config::num_clauses / 2;
+        int votes[num_classes] = {};
+        bool in[num_classes];
+        size_t num_in = num_classes, count = 0;
+        for (size_t c = 0; c < num_classes; c++) in[c] = true;
+
+        for (size_t k = 0; k < pairs && num_in > 1;) {
+            int lead = INT_MIN;
+            for (size_t c = 0; c < num_classes; c++)
+                if (in[c]) {
+                    votes[c] += machines[c]->pair_votes(input, k);
+                    lead = std::max(lead, votes[c]);
+                }
+            count += 2 * num_in;
+            int remaining = (int)(pairs - ++k);
+            for (size_t c = 0; c < num_classes; c++)
+                if (in[c] && votes[c] + 2 * remaining < lead)
+                    in[c] = false, num_in--;
+        }
+        if (evaluated) *evaluated = count;
+
+        for (size_t c = 0; c < num_classes; c++)
+            if (!in[c]) votes[c] = INT_MIN;
+        return argmax(votes, num_classes);
+    }
+
+    // Predictions for n samples, split across the pool's threads.
+    void
+    forward_batch(const TBitset<input_bits> *inputs, size_t n,
+                  size_t *outputs, TThreadpool &pool) const {
+        pool.parallel_for(n, [&](size_t begin, size_t end, size_t) {
+            for (size_t j = begin; j < end; j++)
+                outputs[j] = forward(inputs[j]);
+        });
     }
 
+    // The label's machine learns to say yes, and one other class's machine
+    // learns to say no. Returns the prediction from before the update.
     size_t
-    forward(TBitset<input_bits> &input) {}
+    forward_backward(const TBitset<input_bits> &input, size_t label) {
+        check_label(label);
+        size_t prediction = forward(input);
+        machines[label]->forward_backward(input, 1);
+        machines[other_class(rgen, label)]->forward_backward(input, 0);
+        return prediction;
+    }
 
+    // Every class's output cache. See TsetlinMachine::enable_output_cache().
     void
-    backward() {}
+    enable_output_cache(size_t num_samples) {
+        for (auto &m : machines) m->enable_output_cache(num_samples);
+    }
 
+    // Reproducible version of the above, see TsetlinMachine::backward().
+    // Predicts through the output caches, if enabled.
     size_t
-    forward_backward(TBitset<input_bits> &input) {}
+    forward_backward(const TBitset<input_bits> &input, size_t label,
+                     TsetlinSampleKey key) {
+        check_label(label);
+        int votes[num_classes];
+        for (size_t c = 0; c < num_classes; c++)
+            votes[c] = machines[c]->votes(input, key.sample);
+        size_t prediction = argmax(votes, num_classes);
+        TsetlinCounterRandGen rg(seed, key.epoch, key.sample, UINT32_MAX);
+        machines[label]->forward_backward(input, 1, key);
+        machines[other_class(rg, label)]->forward_backward(input, 0, key);
+        return prediction;
+    }
+
+    // Accuracy, the confusion matrix and per class stats on n samples, split
+    // across the pool's threads.
+    EvalResult
+    evaluate(const TBitset<input_bits> *inputs, const unsigned char *labels,
+             size_t n, TThreadpool &pool) const {
+        return evaluate_range(
+            num_classes, n, pool, [&](size_t j) { return forward(inputs[j]); },
+            [&](size_t j) { return (size_t)labels[j]; });
+    }
+
+    // The same over one epoch of a stream, with the labels as classes.
+    template <typename Stream>
+    EvalResult
+    evaluate(Stream &stream, TThreadpool &pool) const {
+        return evaluate_stream<input_bits>(
+            stream, num_classes, pool,
+            [&](const TBitset<input_bits> &x) { return forward(x); },
+            [](unsigned char label) { return (size_t)label; });
+    }
 };
 
-#endif
\ No newline at end of file
+#endif  // MULTICLASS_TSETLIN_MACHINE_INCLUDE
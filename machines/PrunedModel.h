@@ -0,0 +1,167 @@
+#ifndef PRUNED_MODEL_INCLUDE
+#define PRUNED_MODEL_INCLUDE
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../utils/Binarizer.h"
+#include "../utils/TsetlinBitset.h"
+#include "Argmax.h"
+#include "CompactModel.h"
+#include "TsetlinMachine.h"
+
+// A compacted model that only takes the inputs it looks at. Plenty of inputs
+// are never included by any clause, like the border pixels of MNIST, yet a
+// full input carries them through every clause evaluation anyway. Here the
+// inputs some clause includes (as inp or ~inp) are packed densely, in their
+// original order, and the clauses are rewritten over the packed input.
+//
+// Deployed, only the used bits need computing (Binarizer::transform_bits()
+// with used_bits()) or sending anywhere. pack() gets them from a full input.
+// Every class of a multi-class model shares the same packed input.
+template <typename config>
+class PrunedModel {
+    static constexpr size_t full_bits = config::input_bits;
+    static constexpr size_t full_words = TBitset<full_bits>::buf_len;
+
+    struct Class {
+        std::vector<tint> masks;  // Per clause, inp then ~inp, words each
+        std::vector<int> weights;
+        int bias;
+    };
+
+    std::vector<uint32_t> used;  // Full input bit of each packed bit
+    size_t words = 0;
+    std::vector<Class> classes;
+    Argmax argmax;
+    // pack() takes source word w's bits under gather[w] and puts them at
+    // packed bit offset[w].
+    tint gather[full_words];
+    size_t offset[full_words];
+
+    static tint
+    extract(tint x, tint mask) noexcept {
+#ifdef __BMI2__
+        return _pext_u64(x, mask);
+#else
+        tint out = 0;
+        for (size_t j = 0; mask; mask &= mask - 1, j++)
+            out |= (tint)((x >> __builtin_ctzll(mask)) & 1) << j;
+        return out;
+#endif
+    }
+
+   public:
+    // One model per class, or a single binary one.
+    PrunedModel(const CompactModel<config> *const *models, size_t num_models) {
+        if (!num_models) throw std::invalid_argument("Nothing to prune.");
+        for (size_t w = 0; w < full_words; w++) gather[w] = 0;
+        for (size_t c = 0; c < num_models; c++)
+            for (size_t k = 0; k < models[c]->size(); k++) {
+                const tint *m = models[c]->clause_masks(k);
+                for (size_t w = 0; w < full_words; w++)
+                    gather[w] |= m[w] | m[full_words + w];
+            }
+        size_t bits = 0;
+        for (size_t w = 0; w < full_words; w++) {
+            offset[w] = bits;
+            for (tint m = gather[w]; m; m &= m - 1)
+                used.push_back(
+                    (uint32_t)(w * TINT_BIT_NUM + __builtin_ctzll(m)));
+            bits = used.size();
+        }
+        // At least a word, so there's always something to point at.
+        words = std::max<size_t>((bits + TINT_BIT_NUM - 1) / TINT_BIT_NUM, 1);
+
+        for (size_t c = 0; c < num_models; c++) {
+            const CompactModel<config> &model = *models[c];
+            Class cl{std::vector<tint>(model.size() * 2 * words),
+                     std::vector<int>(model.size()), model.constant()};
+            for (size_t k = 0; k < model.size(); k++) {
+                const tint *m = model.clause_masks(k);
+                tint *pos = cl.masks.data() + k * 2 * words,
+                     *neg = pos + words;
+                for (size_t w = 0; w < full_words; w++) {
+                    if (!gather[w]) continue;
+                    or_bits(pos, offset[w], extract(m[w], gather[w]));
+                    or_bits(neg, offset[w],
+                            extract(m[full_words + w], gather[w]));
+                }
+                cl.weights[k] = model.weight(k);
+            }
+            classes.push_back(std::move(cl));
+        }
+    }
+
+    explicit PrunedModel(const CompactModel<config> &model)
+        : PrunedModel(std::vector<const CompactModel<config> *>{&model}.data(),
+                      1) {}
+
+    // Inputs the model looks at, in packed order, as bits of the full input.
+    const std::vector<uint32_t> &
+    used_bits() const noexcept {
+        return used;
+    }
+
+    size_t
+    input_words() const noexcept {
+        return words;
+    }
+
+    size_t
+    num_classes() const noexcept {
+        return classes.size();
+    }
+
+    // Packs the used bits of a full input. Writes input_words() words.
+    void
+    pack(const TBitset<full_bits> &input, tint *packed) const noexcept {
+        std::memset(packed, 0, words * sizeof(tint));
+        for (size_t w = 0; w < full_words; w++)
+            if (gather[w])
+                or_bits(packed, offset[w], extract(input.buf[w], gather[w]));
+    }
+
+    // Class c's votes, on a packed input.
+    int
+    votes(size_t c, const tint *packed) const noexcept {
+        const Class &cl = classes[c];
+        int sum = cl.bias;
+        for (size_t k = 0; k < cl.weights.size(); k++) {
+            const tint *pos = cl.masks.data() + k * 2 * words,
+                       *neg = pos + words;
+            tint violated = 0;
+            for (size_t w = 0; w < words; w++)
+                violated |= (~packed[w] & pos[w]) | (packed[w] & neg[w]);
+            sum += violated ? 0 : cl.weights[k];
+        }
+        return sum;
+    }
+
+    // 0 or 1 for a binary model, like forward(). Otherwise the class with
+    // the most votes, ties broken like MultiClassTsetlinMachine.
+    size_t
+    predict(const tint *packed) const {
+        if (classes.size() == 1)
+            return TsetlinMachine<config>::threshold_forward(votes(0, packed));
+        std::vector<int> v(classes.size());
+        for (size_t c = 0; c < classes.size(); c++) v[c] = votes(c, packed);
+        return argmax(v.data(), v.size());
+    }
+
+    size_t
+    predict(const TBitset<full_bits> &input) const {
+        std::vector<tint> packed(words);
+        pack(input, packed.data());
+        return predict(packed.data());
+    }
+};
+
+#endif  // PRUNED_MODEL_INCLUDE
@@ -0,0 +1,177 @@
+#ifndef SNAPSHOT_PUBLISHER_INCLUDE
+#define SNAPSHOT_PUBLISHER_INCLUDE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "TsetlinMachine.h"
+#include "TsetlinSnapshot.h"
+
+// Serves predictions from a machine that is still training. The trainer
+// publishes a snapshot of the include masks every so often, and readers only
+// ever look at a published snapshot, never at the automata the trainer is
+// writing. Publishing is an atomic pointer swap (read-copy-update), so a
+// reader never waits for the trainer, or the trainer for a reader.
+//
+// Old snapshots are reclaimed by epoch: each reader announces the global
+// epoch when it starts a read, and a snapshot retired in epoch e is only
+// reused once no reader that started in e or earlier is still reading.
+// Reclaimed snapshots are refilled in place by the next publish(), so in
+// the steady state there are two (plus any held by slow readers) and
+// publishing allocates nothing.
+//
+// One thread publishes. Up to max_readers threads read, each through its
+// own Reader.
+template <typename config>
+class SnapshotPublisher {
+    using Machine = TsetlinMachine<config>;
+    using Snapshot = TsetlinSnapshot<config>;
+
+   public:
+    static constexpr size_t max_readers = 64;
+
+   private:
+    static constexpr uint64_t idle = UINT64_MAX;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{idle};  // Epoch of the read in progress
+        std::atomic<bool> claimed{false};
+    };
+
+    struct Retired {
+        std::unique_ptr<Snapshot> snapshot;
+        uint64_t epoch;
+    };
+
+    alignas(64) std::atomic<const Snapshot *> current{nullptr};
+    alignas(64) std::atomic<uint64_t> global_epoch{0};
+    std::atomic<uint64_t> version{0};
+    ReaderSlot slots[max_readers];
+
+    // Publisher only.
+    std::unique_ptr<Snapshot> live;
+    std::vector<Retired> retired;
+    std::vector<std::unique_ptr<Snapshot>> spare;
+
+    void
+    reclaim() {
+        uint64_t oldest = idle;
+        for (ReaderSlot &s : slots) {
+            uint64_t e = s.epoch.load(std::memory_order_seq_cst);
+            if (e < oldest) oldest = e;
+        }
+        for (size_t i = 0; i < retired.size();) {
+            if (retired[i].epoch < oldest) {
+                spare.push_back(std::move(retired[i].snapshot));
+                retired[i] = std::move(retired.back());
+                retired.pop_back();
+            } else {
+                i++;
+            }
+        }
+    }
+
+   public:
+    SnapshotPublisher(const Machine &machine) { publish(machine); }
+
+    SnapshotPublisher(const SnapshotPublisher &) = delete;
+    SnapshotPublisher &operator=(const SnapshotPublisher &) = delete;
+
+    // Snapshots the machine and makes it what readers see from now on.
+    // Call from the training thread, between updates. Takes about as long
+    // as one forward().
+    void
+    publish(const Machine &machine) {
+        reclaim();
+        std::unique_ptr<Snapshot> next;
+        if (spare.empty()) {
+            next.reset(new Snapshot(machine));
+        } else {
+            next = std::move(spare.back());
+            spare.pop_back();
+            next->assign(machine);
+        }
+
+        current.store(next.get(), std::memory_order_seq_cst);
+        if (live)
+            retired.push_back(
+                {std::move(live),
+                 global_epoch.fetch_add(1, std::memory_order_seq_cst)});
+        live = std::move(next);
+        version.fetch_add(1, std::memory_order_release);
+    }
+
+    // Publishes so far.
+    uint64_t
+    num_published() const noexcept {
+        return version.load(std::memory_order_acquire);
+    }
+
+    // Snapshots waiting for readers to move on.
+    size_t
+    num_retired() const noexcept {
+        return retired.size();
+    }
+
+    // A reader thread's handle. Each read pins the snapshot that was
+    // current when it started.
+    class Reader {
+        SnapshotPublisher *publisher;
+        ReaderSlot *slot;
+
+       public:
+        explicit Reader(SnapshotPublisher &p) : publisher(&p), slot(nullptr) {
+            for (ReaderSlot &s : p.slots) {
+                bool expected = false;
+                if (s.claimed.compare_exchange_strong(expected, true)) {
+                    slot = &s;
+                    return;
+                }
+            }
+            throw std::runtime_error("Too many snapshot readers.");
+        }
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        ~Reader() { slot->claimed.store(false, std::memory_order_release); }
+
+        // Runs fn(snapshot) on the current snapshot, which stays alive until
+        // fn returns.
+        template <typename Fn>
+        auto
+        read(Fn &&fn) {
+            struct Exit {
+                ReaderSlot *slot;
+                ~Exit() { slot->epoch.store(idle, std::memory_order_release); }
+            } exit{slot};
+            slot->epoch.store(
+                publisher->global_epoch.load(std::memory_order_seq_cst),
+                std::memory_order_seq_cst);
+            const Snapshot *s =
+                publisher->current.load(std::memory_order_seq_cst);
+            return fn(*s);
+        }
+
+        bool
+        forward(const TBitset<config::input_bits> &input) {
+            return read([&](const Snapshot &s) { return s.forward(input); });
+        }
+
+        int
+        votes(const TBitset<config::input_bits> &input) {
+            return read([&](const Snapshot &s) { return s.votes(input); });
+        }
+    };
+
+    Reader
+    reader() {
+        return Reader(*this);
+    }
+};
+
+#endif  // SNAPSHOT_PUBLISHER_INCLUDE
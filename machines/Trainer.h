@@ -0,0 +1,198 @@
+#ifndef TRAINER_INCLUDE
+#define TRAINER_INCLUDE
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "../utils/Evaluation.h"
+#include "../utils/StreamingDataset.h"
+#include "../utils/Trace.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TsetlinMachine.h"
+#include "TsetlinSnapshot.h"
+
+// Validation of one epoch, done on a snapshot.
+struct SnapshotEval {
+    size_t epoch;
+    EvalResult result;
+};
+
+// Trains a machine epoch by epoch, and validates each epoch off the critical
+// path. At the end of an epoch, the include masks are frozen into a
+// snapshot, which a background thread evaluates on its own pool while the
+// next epoch trains. Results come back through poll() and wait_result(), in
+// epoch order.
+//
+// At most one snapshot waits behind the one being evaluated. If validation
+// falls behind, a newer snapshot replaces the waiting one and that epoch
+// gets no result, so memory stays at two snapshots however far behind.
+//
+// validate(snapshot, pool) does the evaluation, e.g. snapshot.evaluate() on
+// a validation stream. Only the background thread calls it, so it may own
+// the stream.
+template <typename config>
+class Trainer {
+    static constexpr size_t input_bits = config::input_bits;
+    using Snapshot = TsetlinSnapshot<config>;
+    using Validate = std::function<EvalResult(const Snapshot &, TThreadpool &)>;
+
+    struct Pending {
+        size_t epoch;
+        std::unique_ptr<Snapshot> snapshot;
+    };
+
+    TsetlinMachine<config> &machine;
+    Validate validate;
+    TThreadpool pool;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    Pending waiting;  // No snapshot if nothing is waiting
+    std::deque<SnapshotEval> results;
+    size_t in_flight = 0;  // Waiting or being evaluated
+    bool stopping = false;
+    std::exception_ptr error;
+    std::thread validator;
+
+    void
+    run() {
+        TSETLIN_TRACE_THREAD_NAME("validator");
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cv.wait(lock, [&] { return stopping || waiting.snapshot; });
+            if (stopping) return;
+            Pending p = std::move(waiting);
+            waiting.snapshot.reset();
+            lock.unlock();
+
+            SnapshotEval eval{p.epoch, EvalResult()};
+            std::exception_ptr e;
+            try {
+                TSETLIN_TRACE_SPAN("validate snapshot", p.epoch);
+                eval.result = validate(*p.snapshot, pool);
+            } catch (...) {
+                e = std::current_exception();
+            }
+            p.snapshot.reset();
+
+            lock.lock();
+            if (e && !error) error = e;
+            if (!e) results.push_back(std::move(eval));
+            in_flight--;
+            cv.notify_all();
+        }
+    }
+
+    void
+    rethrow() {
+        if (error) std::rethrow_exception(std::exchange(error, nullptr));
+    }
+
+   public:
+    // eval_threads is the size of the validation pool. By default every core
+    // but the one training.
+    Trainer(TsetlinMachine<config> &trained, Validate validator_fn,
+            size_t eval_threads = std::max<size_t>(
+                std::thread::hardware_concurrency(), 2) - 1)
+        : machine(trained),
+          validate(std::move(validator_fn)),
+          pool(eval_threads) {
+        validator = std::thread([this] { run(); });
+    }
+
+    Trainer(const Trainer &) = delete;
+    Trainer &operator=(const Trainer &) = delete;
+
+    // Abandons validations that haven't started.
+    ~Trainer() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        validator.join();
+    }
+
+    // One epoch of forward_backward over the stream, keyed by (epoch, sample
+    // index). on_sample(seen, correct) is called after every sample. Queues
+    // the epoch's validation and returns without waiting for it. Returns how
+    // many samples were predicted correctly.
+    template <typename Stream, typename ToClass, typename OnSample>
+    size_t
+    train_epoch(Stream &stream, size_t epoch, ToClass &&to_class,
+                OnSample &&on_sample) {
+        size_t seen = 0, correct = 0;
+        SampleChunk<input_bits> chunk;
+        stream.begin_epoch(epoch);
+        while (stream.next_chunk(chunk)) {
+            TSETLIN_TRACE_SPAN("train chunk", chunk.first_index);
+            for (size_t j = 0; j < chunk.size; j++) {
+                bool desired = to_class(chunk.labels[j]);
+                TsetlinSampleKey key = {(uint32_t)epoch,
+                                        (uint32_t)(chunk.first_index + j)};
+                correct +=
+                    machine.forward_backward(chunk.samples[j], desired, key) ==
+                    desired;
+                on_sample(++seen, correct);
+            }
+        }
+        validate_snapshot(epoch);
+        return correct;
+    }
+
+    // Freezes the machine as it is now and queues its validation, in place
+    // of any snapshot still waiting. For training loops that don't go through
+    // train_epoch().
+    void
+    validate_snapshot(size_t epoch) {
+        TSETLIN_TRACE_SPAN("snapshot", epoch);
+        auto snapshot = std::unique_ptr<Snapshot>(new Snapshot(machine));
+        std::lock_guard<std::mutex> lock(mutex);
+        rethrow();
+        if (!waiting.snapshot) in_flight++;
+        waiting = {epoch, std::move(snapshot)};
+        cv.notify_all();
+    }
+
+    // The next finished validation, if there is one. Rethrows anything
+    // validate() threw.
+    bool
+    poll(SnapshotEval &out) {
+        std::lock_guard<std::mutex> lock(mutex);
+        rethrow();
+        if (results.empty()) return false;
+        out = std::move(results.front());
+        results.pop_front();
+        return true;
+    }
+
+    // Waits for the next validation. False if none are left to wait for.
+    bool
+    wait_result(SnapshotEval &out) {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&] { return !results.empty() || !in_flight || error; });
+        rethrow();
+        if (results.empty()) return false;
+        out = std::move(results.front());
+        results.pop_front();
+        return true;
+    }
+
+    // Validations queued or running.
+    size_t
+    pending() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return in_flight;
+    }
+};
+
+#endif  // TRAINER_INCLUDE
@@ -7,23 +7,38 @@
 #include <cmath>
 #include <cstddef>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <limits>
 #include <ostream>
+#include <type_traits>
 
 // AES intrinsics
 
 #include <limits>
 #include <sstream>
+#include <vector>
 
-#include "../utils/Benchmarker.h"
+#include "../utils/Evaluation.h"
+#include "../utils/PerfCounters.h"
+#include "../utils/Trace.h"
 #include "../utils/TsetlinBitset.h"
 #include "../utils/TsetlinRand.h"
+#include "../utils/TsetlinStats.h"
+#include "../utils/TsetlinThreadpool.h"
 
 /////////////////////
 // Tsetlin Machine //
 /////////////////////
 
+// Identifies one training step for the counter based generator. The sample
+// index should be the sample's position in the dataset, not in the shuffled
+// epoch order.
+struct TsetlinSampleKey {
+    uint32_t epoch;
+    uint32_t sample;
+};
+
 template <typename config>
 class TsetlinMachine {
    private:
@@ -62,6 +77,7 @@ class TsetlinMachine {
     ///////////
 
     // Random generator. Seeded in constructor.
+    uint64_t seed;
     TsetlinRandGen rgen;
 
     // Clause Layout:
@@ -83,6 +99,34 @@ class TsetlinMachine {
         return automata_states + (automata_per_clause * clause_num);
     }
 
+    inline const TsetlinAutomaton *
+    automataForClause(size_t clause_num) const {
+        return automata_states + (automata_per_clause * clause_num);
+    }
+
+    // How many inp (not ~inp) literals each clause includes. Lets a clause be
+    // evaluated on a sparse input by looking at its set bits only. Kept up to
+    // date by the feedback functions.
+    uint32_t included_pos[num_clauses];
+
+    // Clause outputs per training sample, from the last time the sample was
+    // trained on with a key. See enable_output_cache(). Sample j's row is
+    // clause_words words at j * clause_words, filled at step cached_at[j].
+    static constexpr size_t clause_words = TBitset<num_clauses>::buf_len;
+    std::vector<tint> cached_outputs;
+    std::vector<uint64_t> cached_at;
+    uint64_t cache_step = 1;
+    // Step of each clause's last include flip. A cached output of a clause
+    // is only good if it was filled after the clause last flipped.
+    uint64_t flipped_at[num_clauses] = {};
+
+    // Scratch space for train_batch(), kept to avoid reallocating per batch.
+    std::vector<int> batch_votes, batch_sums;
+
+#if TSETLIN_STATS
+    TsetlinStatsCounters stats_counters;
+#endif
+
     // 0 if positive, 1 if negative.
     static inline bool
     clause_polarity(size_t clause_num) {
@@ -115,8 +159,8 @@ class TsetlinMachine {
 
         TsetlinAutomaton *cl = automataForClause(n);
         for (size_t i = 0; i < input_bits; i++) {
-            bool inc = eval_automaton(cl[i]);
-            bool conj_inc = eval_automaton(cl[i + input_bits]);
+            bool inc = eval_automaton(cl[2 * i]);
+            bool conj_inc = eval_automaton(cl[2 * i + 1]);
             if (inc && conj_inc)
                 cl_str[i] = 'X';
             else if (inc)
@@ -137,33 +181,67 @@ class TsetlinMachine {
         std::cout << std::endl;
     }
 
-    TsetlinMachine(uint64_t seed = 0xabcdef0123456789)
-        : rgen(TsetlinRandGen(seed)) {
+    TsetlinMachine(uint64_t random_seed = 0xabcdef0123456789)
+        : seed(random_seed), rgen(TsetlinRandGen(random_seed)) {
         for (size_t x = 0; x < automata_states_len; x++)
             automata_states[x] = -(TsetlinAutomaton)(rgen.rand_64() % 2);
+        recount_included();
     }
 
-    bool
-    clause_forward(TsetlinAutomaton *clause_automata,
-                   TBitset<input_bits> &input) const noexcept {
-        static constexpr size_t to_cover =
-            (input_bits / TINT_BIT_NUM) + ((input_bits % TINT_BIT_NUM) != 0);
-        static constexpr bool not_covering = to_cover % 2;
-        static constexpr size_t cover = to_cover - not_covering;
-        static constexpr size_t not_covering_begin_idx =
-            2 * TINT_BIT_NUM * cover;
-
-        static constexpr tint (*pack_fn)(tint, size_t) = [](tint prev,
-                                                            size_t num_times) {
-            if (num_times == 0) return prev;
-
-            prev <<= 1;
-            prev |= 1;
-            return pack_fn(prev, num_times - 1);
-        };
+    // Recompute included_pos from the automata. Call after writing to them
+    // through get_backing().
+    void
+    recount_included() noexcept {
+        for (size_t cl = 0; cl < num_clauses; cl++) {
+            const TsetlinAutomaton *aut = automataForClause(cl);
+            uint32_t n = 0;
+            for (size_t i = 0; i < input_bits; i++)
+                n += eval_automaton(aut[2 * i]);
+            included_pos[cl] = n;
+            // Anything could have changed.
+            flipped_at[cl] = cache_step;
+        }
+    }
+
+    // Caches the clause outputs of training samples [0, num_samples), for
+    // the forward_backward() overloads that take a key. A clause only
+    // changes its output on a sample when one of its includes flips, and
+    // late in training most clauses go whole epochs without flipping, so
+    // most outputs can come from the last epoch instead of being evaluated
+    // again. Which clauses flipped is tracked by feedback. Training is the
+    // same with or without the cache.
+    //
+    // Takes num_samples * num_clauses bits. Sample key.sample has to be the
+    // same input every time, and samples past num_samples aren't cached.
+    // Calling this again, or with 0, drops whatever was cached.
+    void
+    enable_output_cache(size_t num_samples) {
+        cached_outputs.assign(num_samples * clause_words, 0);
+        cached_at.assign(num_samples, 0);
+    }
+
+    // A clause's include decisions, packed like an input: bit i of pos is
+    // whether it includes inp i, and of neg whether it includes ~inp i.
+    // Each is TBitset<input_bits>::buf_len words.
+    void
+    include_masks(size_t clause_num, tint *pos, tint *neg) const noexcept {
+        const TsetlinAutomaton *aut = automataForClause(clause_num);
+        for (size_t w = 0; w < TBitset<input_bits>::buf_len; w++)
+            pos[w] = neg[w] = 0;
+        for (size_t i = 0; i < input_bits; i++) {
+            pos[i / TINT_BIT_NUM] |= (tint)eval_automaton(aut[2 * i])
+                                     << (i % TINT_BIT_NUM);
+            neg[i / TINT_BIT_NUM] |= (tint)eval_automaton(aut[2 * i + 1])
+                                     << (i % TINT_BIT_NUM);
+        }
+    }
 
-        // For each bit, compute the following truth table.
-        //            inp
+    bool
+    clause_forward(const TsetlinAutomaton *clause_automata,
+                   const TBitset<input_bits> &input) const noexcept {
+        // For each bit, compute the following truth table, and the same for
+        // ~inp and its automaton. The clause is true if nothing violates it.
+        //          inp
         //          1     0
         //       X-----X-----X
         //     1 X  0  |  1  X
@@ -172,132 +250,128 @@ class TsetlinMachine {
         //       X-----X-----X
 
         // Get the bits
-        tint *input_b = input.buf;
-
-        tint ret = 0;
-        for (size_t inp_idx = 0, aut_idx = 0; inp_idx < cover; inp_idx += 1) {
-            // Each loop iterates:
-            // TINT_BIT_NUM (1 tint) into input_b (inp_idx), and also
-            // 2 * TINT_BIT_NUM into automata_states (aut_idx).
-
-            // Evaluate two tints worth of automata, un-interleaving and packing
-            // into a tint. This should get vectorized.
+        const tint *input_b = input.buf;
+
+        for (size_t w = 0; w < input.buf_len; w++) {
+            // Un-interleave and pack a tint worth of automata, so that bit j
+            // of each mask lines up with bit j of the input word. This should
+            // get vectorized.
+            const size_t bits =
+                std::min<size_t>(TINT_BIT_NUM, input_bits - w * TINT_BIT_NUM);
+            const TsetlinAutomaton *aut =
+                clause_automata + 2 * TINT_BIT_NUM * w;
             tint pos_aut = 0, conj_aut = 0;
-            for (size_t j = 0; j < TINT_BIT_NUM; j++) {
-                pos_aut <<= 1;
-                pos_aut |= eval_automaton(clause_automata[aut_idx++]);
-                conj_aut <<= 1;
-                conj_aut |= eval_automaton(clause_automata[aut_idx++]);
+            for (size_t j = 0; j < bits; j++) {
+                pos_aut |= (tint)eval_automaton(aut[2 * j]) << j;
+                conj_aut |= (tint)eval_automaton(aut[2 * j + 1]) << j;
             }
 
-            // Get input and conjugate.
-            tint input_buf = input_b[inp_idx];
-            tint input_conj = ~input_buf;
-
-            tint result1 = (input_conj & pos_aut);
-            tint result2 = (input_buf & conj_aut);
-
-            ret |= result1;
-            ret |= result2;
+            tint input_buf = input_b[w];
+            tint violated = (~input_buf & pos_aut) | (input_buf & conj_aut);
+            if (violated) return 0;
         }
+        return 1;
+    }
 
-        // We just went two at a time. Now if there's a last one, we have to do
-        // it.
-        if constexpr (not_covering) {
-            tint pos_aut = 0, conj_aut = 0;
-            for (size_t j = not_covering_begin_idx; j < automata_per_clause;) {
-                pos_aut <<= 1;
-                pos_aut |= eval_automaton(clause_automata[j++]);
-                conj_aut <<= 1;
-                conj_aut |= eval_automaton(clause_automata[j++]);
-            }
-
-            tint input_buf = input_b[input.buf_len - 1];
-            tint input_conj = ~input_buf;
-
-            tint result1 = (input_conj & pos_aut);
-            tint result2 = (input_buf & conj_aut);
-
-            ret |= result1;
-            ret |= result2;
-
-            /*
-            std::cout << "input_buf:  " << std::bitset<TINT_BIT_NUM>(input_buf)
-                      << std::endl;
-            std::cout << "pos_aut:    " << std::bitset<TINT_BIT_NUM>(pos_aut)
-                      << std::endl;
-            std::cout << "result1:    " << std::bitset<TINT_BIT_NUM>(result1)
-                      << '\n'
-                      << std::endl;
-
-            std::cout << "input_conj: " << std::bitset<TINT_BIT_NUM>(input_conj)
-                      << std::endl;
-            std::cout << "conj_aut:   " << std::bitset<TINT_BIT_NUM>(conj_aut)
-                      << std::endl;
-            std::cout << "result2:    " << std::bitset<TINT_BIT_NUM>(result2)
-                      << "\n\n";
-
-            std::cout << "ret:        " << std::bitset<TINT_BIT_NUM>(result2)
-                      << '\n'
-                      << std::endl;
-                      */
+    // Same as above, for an input given by its set bits. An included literal
+    // of a zero bit is only satisfied by ~inp, so the clause is true exactly
+    // when every included inp is among the set bits, and no included ~inp
+    // is. Only the set bits get looked at.
+    bool
+    clause_forward(size_t clause_num,
+                   const TSparseBitset<input_bits> &input) const noexcept {
+        const TsetlinAutomaton *cl = automataForClause(clause_num);
+        uint32_t hits = 0;
+        for (size_t k = 0; k < input.nnz; k++) {
+            const TsetlinAutomaton *aut = cl + 2 * (size_t)input.idx[k];
+            if (eval_automaton(aut[1])) return 0;
+            hits += eval_automaton(aut[0]);
         }
-
-        // Compute the table for the inp, and also for ~inp and its
-        // corresponding automata.
-        return ret ? 1 : 0;
+        return hits == included_pos[clause_num];
     }
 
     void
-    clauses_forward(TBitset<input_bits> &input, TBitset<num_clauses> &output) {
+    clauses_forward(const TBitset<input_bits> &input,
+                    TBitset<num_clauses> &output) const {
         for (size_t i = 0; i < num_clauses; i++)
             output[i] = clause_forward(automataForClause(i), input);
     }
 
+    void
+    clauses_forward(const TSparseBitset<input_bits> &input,
+                    TBitset<num_clauses> &output) const {
+        for (size_t i = 0; i < num_clauses; i++)
+            output[i] = clause_forward(i, input);
+    }
+
+    // clauses_forward() on training sample `sample`, taking the outputs of
+    // clauses that haven't flipped since from the cache, and refilling it.
+    template <typename Input>
+    void
+    clauses_forward(const Input &input, uint32_t sample,
+                    TBitset<num_clauses> &output) {
+        if (sample >= cached_at.size()) return clauses_forward(input, output);
+        tint *row = cached_outputs.data() + (size_t)sample * clause_words;
+        uint64_t at = cached_at[sample];
+        TSETLIN_STAT(uint64_t hits = 0;)
+        for (size_t i = 0; i < num_clauses; i++) {
+            if (flipped_at[i] < at) {
+                output[i] = (row[i / TINT_BIT_NUM] >> (i % TINT_BIT_NUM)) & 1;
+                TSETLIN_STAT(hits++;)
+            } else if constexpr (std::is_same_v<Input, TBitset<input_bits>>) {
+                output[i] = clause_forward(automataForClause(i), input);
+            } else {
+                output[i] = clause_forward(i, input);
+            }
+        }
+        std::memcpy(row, output.buf, clause_words * sizeof(tint));
+        // Flips stamped from here on, this sample's feedback included, are
+        // after the fill.
+        cached_at[sample] = ++cache_step;
+        TSETLIN_STAT(stats_counters.add(TsetlinStatsCounters::CACHE_HITS,
+                                        hits);)
+    }
+
     static inline int
-    summation_forward(TBitset<num_clauses> &clause_outputs) {
-        static constexpr size_t size = num_clauses;
-        static constexpr size_t halfway = size / 2;  // num_clauses % 2 == 0
-        static constexpr size_t backing_size =
-            (num_clauses / TINT_BIT_NUM) + ((num_clauses % TINT_BIT_NUM) != 0);
-        static constexpr size_t middle_idx = backing_size / 2;
+    summation_forward(const TBitset<num_clauses> &clause_outputs) {
+        static constexpr size_t halfway = num_clauses / 2;  // num_clauses % 2 == 0
+        static constexpr size_t backing_size = TBitset<num_clauses>::buf_len;
 
+        // Word holding the boundary between positive and negative clause
+        // outputs, and where in it the boundary is.
+        static constexpr size_t middle_idx = halfway / TINT_BIT_NUM;
         static constexpr size_t split_idx = halfway % TINT_BIT_NUM;
-        static constexpr bool clean =
-            (backing_size % 2 == 0) && (split_idx == 0);
+        static constexpr bool clean = split_idx == 0;
 
-        static constexpr size_t r1_begin = 0;
-        static constexpr size_t r1_end = middle_idx;
-        static constexpr size_t r2_begin = middle_idx + !clean;
-        static constexpr size_t r2_end = backing_size;
+        // Bits past the last clause aren't outputs.
+        static constexpr size_t tail_bits = num_clauses % TINT_BIT_NUM;
+        static constexpr tint tail_mask =
+            tail_bits ? ((tint)1 << tail_bits) - 1 : ~(tint)0;
+
+        const tint *backing = clause_outputs.buf;
+        auto word = [&](size_t i) {
+            return i == backing_size - 1 ? backing[i] & tail_mask : backing[i];
+        };
 
-        tint *backing = clause_outputs.buf;
         int sum = 0;
+        for (size_t i = 0; i < middle_idx; i++)
+            sum += std::popcount<tint>(backing[i]);
         if constexpr (clean) {
             // Case: The boundary between positive and negative clause outputs
             // is the boundary of a buffer.
-            for (size_t i = r1_begin; i < r1_end; i++)
-                sum += std::popcount<tint>(backing[i]);
-            for (size_t i = r2_begin; i < r2_end; i++)
-                sum -= std::popcount<tint>(backing[i]);
-            return sum;
+            for (size_t i = middle_idx; i < backing_size; i++)
+                sum -= std::popcount<tint>(word(i));
         } else {
             // Case: The boundary between positive and negative clause outputs
             // is inside a buffer.
-            for (size_t i = r1_begin; i < r1_end; i++)
-                sum += std::popcount<tint>(backing[i]);
-
-            // Deal with the middle
-            for (size_t j = 0; j < split_idx; j++)
-                sum += (backing[middle_idx] & ((size_t)1 << j)) ? 1 : 0;
-            for (size_t j = split_idx; j < TINT_BIT_NUM; j++)
-                sum -= (backing[middle_idx] & ((size_t)1 << j)) ? 1 : 0;
-
-            for (size_t i = r2_begin; i < r2_end; i++)
-                sum -= std::popcount<tint>(backing[i]);
-
-            return sum;
+            static constexpr tint low = ((tint)1 << split_idx) - 1;
+            tint middle = word(middle_idx);
+            sum += std::popcount<tint>(middle & low);
+            sum -= std::popcount<tint>(middle & ~low);
+            for (size_t i = middle_idx + 1; i < backing_size; i++)
+                sum -= std::popcount<tint>(word(i));
         }
+        return sum;
     }
 
     void
@@ -335,7 +409,7 @@ class TsetlinMachine {
     }
 
     bool
-    forward(TBitset<input_bits> &input) {
+    forward(const TBitset<input_bits> &input) const {
         // Clauses forward
         TBitset<num_clauses> clause_outputs;
         clauses_forward(input, clause_outputs);
@@ -348,10 +422,76 @@ class TsetlinMachine {
     }
 
     bool
-    operator()(TBitset<input_bits> &input) {
+    forward(const TSparseBitset<input_bits> &input) const {
+        TBitset<num_clauses> clause_outputs;
+        clauses_forward(input, clause_outputs);
+        return threshold_forward(summation_forward(clause_outputs));
+    }
+
+    bool
+    operator()(const TBitset<input_bits> &input) {
         return forward(input);
     }
 
+    // The vote sum forward() thresholds. How sure the machine is, for
+    // comparing machines, e.g. one per class.
+    int
+    votes(const TBitset<input_bits> &input) const {
+        TBitset<num_clauses> clause_outputs;
+        clauses_forward(input, clause_outputs);
+        return summation_forward(clause_outputs);
+    }
+
+    // votes() on training sample `sample`, through the output cache.
+    int
+    votes(const TBitset<input_bits> &input, uint32_t sample) {
+        TBitset<num_clauses> clause_outputs;
+        clauses_forward(input, sample, clause_outputs);
+        return summation_forward(clause_outputs);
+    }
+
+    // The votes of clauses [begin, end) alone. Summed over any partition of
+    // the clauses, this is votes().
+    int
+    votes_range(const TBitset<input_bits> &input, size_t begin,
+                size_t end) const noexcept {
+        int sum = 0;
+        for (size_t i = begin; i < end; i++) {
+            int out = clause_forward(automataForClause(i), input);
+            sum += i < clauses_per_polarity ? out : -out;
+        }
+        return sum;
+    }
+
+    // Positive clause i against negative clause i: 1, -1, or 0 if both or
+    // neither are true. The pairs for i in [0, num_clauses / 2) add up to
+    // votes().
+    int
+    pair_votes(const TBitset<input_bits> &input, size_t i) const noexcept {
+        return (int)clause_forward(automataForClause(i), input) -
+               (int)clause_forward(automataForClause(i + clauses_per_polarity),
+                                   input);
+    }
+
+    // forward(), but stops as soon as the answer can't change. Clauses are
+    // evaluated a positive and negative pair at a time, so after k pairs the
+    // final sum is within (num_clauses / 2 - k) of the running one either
+    // way. A confident sample is decided long before the last clause. If
+    // evaluated isn't null, it gets how many clauses were looked at.
+    bool
+    forward_early(const TBitset<input_bits> &input,
+                  size_t *evaluated = nullptr) const noexcept {
+        int sum = 0;
+        size_t k = 0;
+        while (k < clauses_per_polarity) {
+            sum += pair_votes(input, k++);
+            int remaining = (int)(clauses_per_polarity - k);
+            if (sum - remaining >= 0 || sum + remaining < 0) break;
+        }
+        if (evaluated) *evaluated = 2 * k;
+        return threshold_forward(sum);
+    }
+
     ///////////////
     // Backwards //
     ///////////////
@@ -410,12 +550,13 @@ class TsetlinMachine {
         f(1, 1, 1);
     }
 
+    template <typename RandGen>
     inline TsetlinAutomaton
-    calc_t1_feedback(TsetlinAutomaton prev_state, bool clause_output,
-                     bool literal, bool include) {
+    calc_t1_feedback(RandGen &rg, TsetlinAutomaton prev_state,
+                     bool clause_output, bool literal, bool include) {
         // Sample from the table
         TsetlinAutomaton t1_reward =
-            rgen.rand_bernoulli(
+            rg.rand_bernoulli(
                 t1feedback_table(clause_output, literal, include)) *
             t1feedback_is_penalty(clause_output, literal, include);
 
@@ -430,11 +571,16 @@ class TsetlinMachine {
         return saturated_add(prev_state, t1_reward);
     }
 
+    // Runs feedback over every automaton of a clause in order, with
+    // literal_at(i) giving input bit i for increasing i. Keeps included_pos
+    // in step with the automata.
+    template <typename Literals, typename FeedbackFn>
     inline void
-    apply_t1_feedback(TsetlinAutomaton *automata_for_clause,
-                      TBitset<input_bits> &input, bool clause_output) {
-        // std::cout << "Applying t1 feedback" << std::endl;
-        // Calculate and apply feedback
+    feedback_over(size_t cl_num, Literals &&literal_at, FeedbackFn &&calc) {
+        TsetlinAutomaton *automata_for_clause = automataForClause(cl_num);
+        int32_t included_delta = 0;
+        bool flipped = false;
+        TSETLIN_STAT(uint64_t flips = 0;)
         for (size_t i = 0, j = 0; i < input_bits; i += 1, j += 2) {
             TsetlinAutomaton *current_state_pos = automata_for_clause + j;
             TsetlinAutomaton *current_state_pos_ = current_state_pos + 1;
@@ -443,21 +589,70 @@ class TsetlinMachine {
             TsetlinAutomaton current_state_ = *current_state_pos_;
             bool include = eval_automaton(current_state);
             bool include_ = eval_automaton(current_state_);
-            bool literal = input[i];
-            bool literal_ = ~input[i];
+            bool literal = literal_at(i);
+            bool literal_ = !literal;
 
             // clang-format off
-            *current_state_pos = calc_t1_feedback(
-                current_state, clause_output, literal, include);
-            *current_state_pos_ = calc_t1_feedback(
-                current_state_, clause_output, literal_, include_);
+            *current_state_pos = calc(current_state, literal, include);
+            *current_state_pos_ = calc(current_state_, literal_, include_);
             // clang-format on
+            included_delta +=
+                (int32_t)eval_automaton(*current_state_pos) - include;
+            flipped |= (eval_automaton(*current_state_pos) != include) |
+                       (eval_automaton(*current_state_pos_) != include_);
+            TSETLIN_STAT(
+                flips += (eval_automaton(*current_state_pos) != include) +
+                         (eval_automaton(*current_state_pos_) != include_);)
         }
+        included_pos[cl_num] += included_delta;
+        if (flipped) flipped_at[cl_num] = cache_step;
+        TSETLIN_STAT(stats_counters.add(TsetlinStatsCounters::INCLUDE_FLIPS,
+                                        flips);)
     }
 
+    // Walks the set bits alongside the automata, instead of testing every
+    // input bit.
+    static auto
+    sparse_literals(const TSparseBitset<input_bits> &input) {
+        return [&input, k = (size_t)0](size_t i) mutable {
+            bool literal = k < input.nnz && input.idx[k] == i;
+            k += literal;
+            return literal;
+        };
+    }
+
+    template <typename RandGen>
+    inline void
+    apply_t1_feedback(RandGen &rg, size_t cl_num,
+                      const TBitset<input_bits> &input, bool clause_output) {
+        feedback_over(
+            cl_num, [&](size_t i) { return input[i]; },
+            [&](TsetlinAutomaton state, bool literal, bool include) {
+                return calc_t1_feedback(rg, state, clause_output, literal,
+                                        include);
+            });
+    }
+
+    // Draws exactly what the dense version draws, in the same order, so
+    // training on a sparse input gives the same machine.
+    template <typename RandGen>
+    inline void
+    apply_t1_feedback(RandGen &rg, size_t cl_num,
+                      const TSparseBitset<input_bits> &input,
+                      bool clause_output) {
+        feedback_over(
+            cl_num, sparse_literals(input),
+            [&](TsetlinAutomaton state, bool literal, bool include) {
+                return calc_t1_feedback(rg, state, clause_output, literal,
+                                        include);
+            });
+    }
+
+    // A clause that wrongly output 1 gets pushed toward including one of the
+    // literals that are 0, which would make it output 0.
     static inline bool
     t2feedback_table(bool clause, bool literal, bool include) {
-        return (clause && literal && !include);
+        return (clause && !literal && !include);
     }
 
     inline TsetlinAutomaton
@@ -483,29 +678,30 @@ class TsetlinMachine {
         return res;
     }
 
+    // Type 2 feedback only ever touches clauses that output 1, and needs no
+    // random numbers, so there's nothing to do otherwise.
     inline void
-    apply_t2_feedback(TsetlinAutomaton *automata_for_clause,
-                      TBitset<input_bits> &input, bool clause_output) {
-        // std::cout << "Applying t2 feedback" << std::endl;
-        // Calculate and apply feedback
-        for (size_t i = 0, j = 0; i < input_bits; i += 1, j += 2) {
-            TsetlinAutomaton *current_state_pos = automata_for_clause + j;
-            TsetlinAutomaton *current_state_pos_ = current_state_pos + 1;
-
-            TsetlinAutomaton current_state = *current_state_pos;
-            TsetlinAutomaton current_state_ = *current_state_pos_;
-            bool include = eval_automaton(current_state);
-            bool include_ = eval_automaton(current_state_);
-            bool literal = input[i];
-            bool literal_ = ~input[i];
+    apply_t2_feedback(size_t cl_num, const TBitset<input_bits> &input,
+                      bool clause_output) {
+        if (!clause_output) return;
+        feedback_over(
+            cl_num, [&](size_t i) { return input[i]; },
+            [&](TsetlinAutomaton state, bool literal, bool include) {
+                return calc_t2_feedback(state, clause_output, literal,
+                                        include);
+            });
+    }
 
-            // clang-format off
-            *current_state_pos = calc_t2_feedback(
-                current_state, clause_output, literal, include);
-            *current_state_pos_ = calc_t2_feedback(
-                current_state_, clause_output, literal_, include_);
-            // clang-format on
-        }
+    inline void
+    apply_t2_feedback(size_t cl_num, const TSparseBitset<input_bits> &input,
+                      bool clause_output) {
+        if (!clause_output) return;
+        feedback_over(
+            cl_num, sparse_literals(input),
+            [&](TsetlinAutomaton state, bool literal, bool include) {
+                return calc_t2_feedback(state, clause_output, literal,
+                                        include);
+            });
     }
 
     static int
@@ -514,77 +710,321 @@ class TsetlinMachine {
         return std::max(-iT, std::min(x, iT));
     }
 
+    // gen_for_clause(cl_num) gives the generator that makes every random
+    // decision for that clause.
+    template <typename Input, typename ClauseRandGen>
     void
-    backward(TBitset<input_bits> &input, bool desired_output,
-             TBitset<num_clauses> clause_outputs, int sum) {
+    backward_with(const Input &input, bool desired_output,
+                  TBitset<num_clauses> &clause_outputs, int sum,
+                  ClauseRandGen &&gen_for_clause) {
         // std::cout << "Backwards: (" << input << ", " << desired_output
         //          << ")\nclauses: (" << clause_outputs << ", " << sum << ")"
         //          << std::endl;
 
-        // Calculate probability of feedback
-        static constexpr size_t _T = summation_target;
-        static constexpr float _2T = 2.0 * _T;
+        TSETLIN_STAT(
+            count_sample(sum, desired_output);
+            stats_counters.add(TsetlinStatsCounters::CLAUSE_FIRES,
+                               clause_outputs.count());)
 
-        float feedback_prob[2] = {((_T - clip(sum)) / _2T),   // eq. 3
-                                  ((_T + clip(sum)) / _2T)};  // eq. 4
+        float satisfy = feedback_probability(sum, desired_output);
+        for (size_t cl_num = 0; cl_num < num_clauses; cl_num++)
+            clause_backward(cl_num, input, desired_output,
+                            clause_outputs[cl_num], satisfy,
+                            gen_for_clause(cl_num));
+    }
 
-        // For each clause
-        for (size_t cl_num = 0; cl_num < num_clauses; cl_num++) {
-            bool clause_out = clause_outputs[cl_num];
-            TsetlinAutomaton *automata_for_clause = automataForClause(cl_num);
+    // Chance that a clause gets feedback at all, given the vote sum.
+    static inline float
+    feedback_probability(int sum, bool desired_output) {
+        static constexpr size_t _T = summation_target;
+        static constexpr float _2T = 2.0 * _T;
 
-            // For each automaton, sample chance to apply t1 or t2 feedback
-            bool polarity = clause_polarity(cl_num);
-            float satisfy = feedback_prob[desired_output];
-            bool satisfied = rgen.rand_bernoulli(satisfy);
+        // Indexed by the desired output. The closer the sum already is to
+        // the target for that output, the less feedback.
+        float feedback_prob[2] = {((_T + clip(sum)) / _2T),   // eq. 4
+                                  ((_T - clip(sum)) / _2T)};  // eq. 3
+        return feedback_prob[desired_output];
+    }
 
-            // std::cout << "Updating clause: " << cl_num << " ("
-            //          << (int)clause_out
-            //          << "), (polarity: " << ((polarity) ? '+' : '-') << "),
-            //          ";
+    // Feedback for a single clause. Only touches that clause's automata, so
+    // different clauses can be updated at the same time.
+    template <typename Input, typename RandGen>
+    inline void
+    clause_backward(size_t cl_num, const Input &input, bool desired_output,
+                    bool clause_out, float satisfy, RandGen &&rg) {
+        // For each automaton, sample chance to apply t1 or t2 feedback
+        bool polarity = clause_polarity(cl_num);
+        bool satisfied = rg.rand_bernoulli(satisfy);
+
+        // C^1 = polarity 0 is positive, C^0 = polarity 1 is negative.
+        if (!(polarity ^ desired_output)) {
+            TSETLIN_STAT(
+                stats_counters.add(TsetlinStatsCounters::T1_SAMPLED, 1);
+                stats_counters.add(TsetlinStatsCounters::T1_APPLIED,
+                                   satisfied);)
+            if (satisfied) apply_t1_feedback(rg, cl_num, input, clause_out);
+        } else {
+            TSETLIN_STAT(
+                stats_counters.add(TsetlinStatsCounters::T2_SAMPLED, 1);
+                stats_counters.add(TsetlinStatsCounters::T2_APPLIED,
+                                   satisfied);)
+            if (satisfied) apply_t2_feedback(cl_num, input, clause_out);
+        }
+    }
 
-            // C^1 = polarity 0 is positive, C^0 = polarity 1 is negative.
+    // Per sample counters. Clause fires are counted where the clauses are
+    // evaluated.
+    inline void
+    count_sample(int sum, bool desired_output) {
+        TSETLIN_STAT(
+            stats_counters.add(TsetlinStatsCounters::SAMPLES, 1);
+            stats_counters.add(TsetlinStatsCounters::CLAUSE_EVALS, num_clauses);
+            stats_counters.add(TsetlinStatsCounters::SATURATED_SUMS,
+                               std::abs(sum) >= (int)summation_target);
+            stats_counters.add(
+                TsetlinStatsCounters::ZERO_FEEDBACK,
+                feedback_probability(sum, desired_output) == 0);)
+        (void)sum;
+        (void)desired_output;
+    }
 
-            if (!(polarity ^ desired_output)) {
-                // std::cout << "Applying t1 feedback: " << satisfied << '\n';
-                if (satisfied)
-                    apply_t1_feedback(automata_for_clause, input, clause_out);
+    // What training takes: a dense input, or a sparse one. Forward on a
+    // sparse input only looks at the set bits, and feedback is identical to
+    // the dense one given the same draws.
+    template <typename Input>
+    static constexpr bool is_input =
+        std::is_same_v<Input, TBitset<input_bits>> ||
+        std::is_same_v<Input, TSparseBitset<input_bits>>;
+
+    // Draws from the machine's own generator, so the result depends on
+    // everything that was drawn before.
+    template <typename Input>
+    requires(is_input<Input>)
+    void
+    backward(const Input &input, bool desired_output,
+             TBitset<num_clauses> clause_outputs, int sum) {
+        backward_with(input, desired_output, clause_outputs, sum,
+                      [&](size_t) -> TsetlinRandGen & { return rgen; });
+    }
 
-            } else {
-                // std::cout << "Applying t2 feedback: " << satisfied << '\n';
-                if (satisfied)
-                    apply_t2_feedback(automata_for_clause, input, clause_out);
-            }
-        }
+    // Every random decision is a function of (seed, key, clause) alone, so
+    // the update is the same no matter what order clauses are visited in, or
+    // which thread visits them.
+    template <typename Input>
+    requires(is_input<Input>)
+    void
+    backward(const Input &input, bool desired_output,
+             TBitset<num_clauses> clause_outputs, int sum,
+             TsetlinSampleKey key) {
+        backward_with(input, desired_output, clause_outputs, sum,
+                      [&](size_t cl_num) {
+                          return TsetlinCounterRandGen(
+                              seed, key.epoch, key.sample, (uint32_t)cl_num);
+                      });
     }
 
+    // Both forward_backward()s. With a key, the clause outputs come through
+    // the output cache and feedback draws are keyed; without one, they're
+    // computed and drawn from the machine's generator.
+    template <typename Input, typename... Key>
     bool
-    forward_backward(TBitset<input_bits> &input, bool desired_output) {
+    forward_backward_with(const Input &input, bool desired_output,
+                          const Key &...key) {
+        static_assert(sizeof...(Key) <= 1);
+
         /////////////
         // Forward //
         /////////////
 
         // Clauses forward
+        TSETLIN_TRACE_SAMPLE(trace);
+        TSETLIN_TRACE_PHASE(trace, "forward");
+        TSETLIN_PERF_BEGIN(PERF_FORWARD);
         TBitset<num_clauses> clause_outputs;
-        clauses_forward(input, clause_outputs);
-
-        // std::cout << '\n' << clause_outputs << '\n';
+        clauses_forward(input, key.sample..., clause_outputs);
 
         // Summation forward
+        TSETLIN_TRACE_PHASE(trace, "summation");
+        TSETLIN_PERF_BEGIN(PERF_SUMMATION);
         int sum = summation_forward(clause_outputs);
 
         // Threshold
         bool output = threshold_forward(sum);
 
         // Update TM teams
-        backward(input, desired_output, clause_outputs, sum);
+        TSETLIN_TRACE_PHASE(trace, "backward");
+        TSETLIN_PERF_BEGIN(PERF_BACKWARD);
+        backward(input, desired_output, clause_outputs, sum, key...);
+        TSETLIN_PERF_END();
 
         return output;
     }
 
+    template <typename Input>
+    requires(is_input<Input>)
+    bool
+    forward_backward(const Input &input, bool desired_output) {
+        return forward_backward_with(input, desired_output);
+    }
+
+    // Reproducible version of the above. See backward(). Uses the output
+    // cache, if enabled.
+    template <typename Input>
+    requires(is_input<Input>)
+    bool
+    forward_backward(const Input &input, bool desired_output,
+                     TsetlinSampleKey key) {
+        return forward_backward_with(input, desired_output, key);
+    }
+
+    /////////////
+    // Batches //
+    /////////////
+
+    // Predictions for n samples, split across the pool's threads.
+    void
+    forward_batch(const TBitset<input_bits> *inputs, size_t n, bool *outputs,
+                  TThreadpool &pool) const {
+        pool.parallel_for(n, [&](size_t begin, size_t end, size_t) {
+            for (size_t j = begin; j < end; j++)
+                outputs[j] = forward(inputs[j]);
+        });
+    }
+
+    // Accuracy and the 2x2 confusion matrix on n samples, split across the
+    // pool's threads.
+    EvalResult
+    evaluate(const TBitset<input_bits> *inputs, const bool *labels, size_t n,
+             TThreadpool &pool) const {
+        return evaluate_range(
+            2, n, pool, [&](size_t j) { return (size_t)forward(inputs[j]); },
+            [&](size_t j) { return (size_t)labels[j]; });
+    }
+
+    // The same over one epoch of a stream. to_class(label) gives the output
+    // a label should have.
+    template <typename Stream, typename ToClass>
+    EvalResult
+    evaluate(Stream &stream, TThreadpool &pool, ToClass &&to_class) const {
+        return evaluate_stream<input_bits>(
+            stream, 2, pool,
+            [&](const TBitset<input_bits> &x) { return (size_t)forward(x); },
+            [&](unsigned char label) { return (size_t)(bool)to_class(label); });
+    }
+
+    // Trains on n samples at once, with the clauses split across the pool's
+    // threads. The votes for the whole batch are summed before any clause
+    // gets feedback, so they can be up to n - 1 samples stale. Each clause is
+    // evaluated again right before its own feedback though, since using
+    // stale clause outputs too stops the machine from learning. A batch of
+    // one is exactly forward_backward(input, desired, first).
+    //
+    // Sample j is keyed first.sample + j, so the result is the same for any
+    // number of threads. Returns how many samples were predicted correctly.
+    size_t
+    train_batch(const TBitset<input_bits> *inputs, const bool *desired,
+                size_t n, TsetlinSampleKey first, TThreadpool &pool) {
+        TSETLIN_TRACE_SPAN("batch", n);
+        batch_votes.assign(pool.size() * n, 0);
+        batch_sums.resize(n);
+
+        // Forward, with partial sums per thread. Each thread reads its own
+        // counters, and the samples are counted once. Every phase measures
+        // by the batch's index, so that all threads measure the same batches.
+        [[maybe_unused]] uint64_t batch = first.sample / std::max<size_t>(n, 1);
+        pool.parallel_for(num_clauses, [&](size_t cb, size_t ce, size_t t) {
+            TSETLIN_TRACE_SPAN("batch forward");
+            TSETLIN_PERF_BEGIN(PERF_FORWARD, t ? 0 : n, batch);
+            int *votes = batch_votes.data() + t * n;
+            TSETLIN_STAT(uint64_t fires = 0;)
+            for (size_t j = 0; j < n; j++) {
+                int v = 0;
+                for (size_t cl = cb; cl < ce; cl++)
+                    if (clause_forward(automataForClause(cl), inputs[j])) {
+                        v += clause_polarity(cl) ? 1 : -1;
+                        TSETLIN_STAT(fires++;)
+                    }
+                votes[j] = v;
+            }
+            TSETLIN_STAT(
+                stats_counters.add(TsetlinStatsCounters::CLAUSE_FIRES, fires);)
+            TSETLIN_PERF_END();
+        });
+
+        size_t correct = 0;
+        {
+            TSETLIN_TRACE_SPAN("batch summation");
+            TSETLIN_PERF_BEGIN(PERF_SUMMATION, 0, batch);
+            for (size_t j = 0; j < n; j++) {
+                int sum = 0;
+                for (size_t t = 0; t < pool.size(); t++)
+                    sum += batch_votes[t * n + j];
+                batch_sums[j] = sum;
+                correct += threshold_forward(sum) == desired[j];
+                count_sample(sum, desired[j]);
+            }
+            TSETLIN_PERF_END();
+        }
+
+        // Backward. Each thread only updates the clauses it evaluated.
+        pool.parallel_for(num_clauses, [&](size_t cb, size_t ce, size_t) {
+            TSETLIN_TRACE_SPAN("batch backward");
+            TSETLIN_PERF_BEGIN(PERF_BACKWARD, 0, batch);
+            for (size_t j = 0; j < n; j++) {
+                float satisfy = feedback_probability(batch_sums[j], desired[j]);
+                uint32_t sample = first.sample + (uint32_t)j;
+                for (size_t cl = cb; cl < ce; cl++)
+                    clause_backward(cl, inputs[j], desired[j],
+                                    clause_forward(automataForClause(cl),
+                                                   inputs[j]),
+                                    satisfy,
+                                    TsetlinCounterRandGen(seed, first.epoch,
+                                                          sample,
+                                                          (uint32_t)cl));
+            }
+            TSETLIN_PERF_END();
+        });
+        return correct;
+    }
+
     /////////////
     // UTILITY //
     /////////////
+
+    // Counters since construction or the last reset_stats(), merged over
+    // every thread that trained. Safe to poll while training. All zero
+    // unless built with TSETLIN_STATS.
+    TsetlinStats
+    stats() const noexcept {
+#if TSETLIN_STATS
+        return stats_counters.read();
+#else
+        return TsetlinStats();
+#endif
+    }
+
+    // Only while nothing is training.
+    void
+    reset_stats() noexcept {
+        TSETLIN_STAT(stats_counters.reset();)
+    }
+
+    // Raw automata, in the clause layout described above. Used to ship the
+    // model between processes. Call recount_included() after writing.
+    TsetlinAutomaton*
+    get_backing() noexcept {
+        return automata_states;
+    }
+
+    const TsetlinAutomaton*
+    get_backing() const noexcept {
+        return automata_states;
+    }
+
+    static constexpr size_t
+    get_backing_size() noexcept {
+        return automata_states_len;
+    }
 };
 
 #endif  // TSETLIN_MACHINE_INCLUDE
\ No newline at end of file
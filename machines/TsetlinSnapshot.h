@@ -0,0 +1,120 @@
+#ifndef TSETLIN_SNAPSHOT_INCLUDE
+#define TSETLIN_SNAPSHOT_INCLUDE
+
+#include <cstddef>
+#include <vector>
+
+#include "../utils/Evaluation.h"
+#include "../utils/TsetlinBitset.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TsetlinMachine.h"
+
+// The include decisions of a machine at one point in time, frozen as bit
+// masks. Predicts exactly what the machine did when the snapshot was taken,
+// but can't be trained, and doesn't change when the machine does. Taking one
+// reads every automaton once. Evaluating one is cheaper than evaluating the
+// machine, since the masks are already packed.
+template <typename config>
+class TsetlinSnapshot {
+    static constexpr size_t input_bits = config::input_bits;
+    static constexpr size_t num_clauses = config::num_clauses;
+    static constexpr size_t words = TBitset<input_bits>::buf_len;
+
+    // Clause c's inp mask, then its ~inp mask, words each.
+    std::vector<tint> masks;
+
+   public:
+    explicit TsetlinSnapshot(const TsetlinMachine<config> &machine)
+        : masks(num_clauses * 2 * words) {
+        assign(machine);
+    }
+
+    // Retakes the snapshot in place, without allocating.
+    void
+    assign(const TsetlinMachine<config> &machine) noexcept {
+        for (size_t c = 0; c < num_clauses; c++)
+            machine.include_masks(c, clause_masks(c), clause_masks(c) + words);
+    }
+
+    tint *
+    clause_masks(size_t c) noexcept {
+        return masks.data() + c * 2 * words;
+    }
+
+    const tint *
+    clause_masks(size_t c) const noexcept {
+        return masks.data() + c * 2 * words;
+    }
+
+    // The clause is true unless an included inp is 0 or an included ~inp
+    // is 1.
+    bool
+    clause_forward(size_t c, const TBitset<input_bits> &input) const noexcept {
+        const tint *pos = clause_masks(c), *neg = pos + words;
+        tint violated = 0;
+        for (size_t w = 0; w < words; w++)
+            violated |= (~input.buf[w] & pos[w]) | (input.buf[w] & neg[w]);
+        return !violated;
+    }
+
+    // Positive clauses come first, like in the machine.
+    int
+    votes(const TBitset<input_bits> &input) const noexcept {
+        int sum = 0;
+        for (size_t c = 0; c < num_clauses / 2; c++)
+            sum += clause_forward(c, input);
+        for (size_t c = num_clauses / 2; c < num_clauses; c++)
+            sum -= clause_forward(c, input);
+        return sum;
+    }
+
+    // The votes of clauses [begin, end) alone.
+    int
+    votes_range(const TBitset<input_bits> &input, size_t begin,
+                size_t end) const noexcept {
+        int sum = 0;
+        for (size_t c = begin; c < end; c++) {
+            int out = clause_forward(c, input);
+            sum += c < num_clauses / 2 ? out : -out;
+        }
+        return sum;
+    }
+
+    // Votes for n inputs at once. Goes clause by clause rather than input by
+    // input, so each clause's masks are read once per batch instead of once
+    // per input.
+    void
+    votes_batch(const TBitset<input_bits> *const *inputs, size_t n,
+                int *out) const noexcept {
+        for (size_t j = 0; j < n; j++) out[j] = 0;
+        for (size_t c = 0; c < num_clauses; c++) {
+            int vote = c < num_clauses / 2 ? 1 : -1;
+            for (size_t j = 0; j < n; j++)
+                out[j] += vote * clause_forward(c, *inputs[j]);
+        }
+    }
+
+    bool
+    forward(const TBitset<input_bits> &input) const noexcept {
+        return TsetlinMachine<config>::threshold_forward(votes(input));
+    }
+
+    EvalResult
+    evaluate(const TBitset<input_bits> *inputs, const bool *labels, size_t n,
+             TThreadpool &pool) const {
+        return evaluate_range(
+            2, n, pool, [&](size_t j) { return (size_t)forward(inputs[j]); },
+            [&](size_t j) { return (size_t)labels[j]; });
+    }
+
+    template <typename Stream, typename ToClass>
+    EvalResult
+    evaluate(Stream &stream, TThreadpool &pool, ToClass &&to_class) const {
+        return evaluate_stream<input_bits>(
+            stream, 2, pool,
+            [&](const TBitset<input_bits> &x) { return (size_t)forward(x); },
+            [&](unsigned char label) { return (size_t)(bool)to_class(label); });
+    }
+};
+
+#endif  // TSETLIN_SNAPSHOT_INCLUDE
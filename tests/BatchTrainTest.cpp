@@ -0,0 +1,62 @@
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TestCommon.h"
+
+// 200 clauses, not a multiple of 64.
+using BatchConfig = TestConfig<100, 200, 25>;
+
+using Machine = TsetlinMachine<BatchConfig>;
+static constexpr size_t n = 400;
+
+static bool
+same_model(Machine& a, Machine& b) {
+    return !std::memcmp(a.get_backing(), b.get_backing(),
+                        Machine::get_backing_size());
+}
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<100>[]>(new TBitset<100>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .1);
+
+    // A batch of one is keyed forward_backward.
+    auto a = std::unique_ptr<Machine>(new Machine(7));
+    auto b = std::unique_ptr<Machine>(new Machine(7));
+    TThreadpool one(1), three(3);
+    bool single_ok = true;
+    for (uint32_t e = 0; e < 2; e++)
+        for (size_t i = 0; i < n; i++)
+            single_ok &= a->forward_backward(x[i], y[i], {e, (uint32_t)i}) ==
+                         y[i] == (bool)b->train_batch(&x[i], &y[i], 1,
+                                                      {e, (uint32_t)i}, three);
+    single_ok &= same_model(*a, *b);
+
+    // Batches come out the same on any number of threads.
+    auto c = std::unique_ptr<Machine>(new Machine(7));
+    auto d = std::unique_ptr<Machine>(new Machine(7));
+    size_t c_right = 0, d_right = 0;
+    for (uint32_t e = 0; e < 2; e++)
+        for (size_t i = 0; i < n; i += 16) {
+            c_right += c->train_batch(&x[i], &y[i], 16, {e, (uint32_t)i}, one);
+            d_right +=
+                d->train_batch(&x[i], &y[i], 16, {e, (uint32_t)i}, three);
+        }
+    bool threads_ok = c_right == d_right && same_model(*c, *d);
+
+    // Batched inference matches one at a time.
+    bool out[n];
+    d->forward_batch(x.get(), n, out, three);
+    bool infer_ok = true;
+    for (size_t i = 0; i < n; i++) infer_ok &= out[i] == d->forward(x[i]);
+
+    check("Batch of one", single_ok);
+    check("Thread count independent", threads_ok);
+    check("forward_batch", infer_ok);
+    return test_result();
+}
@@ -0,0 +1,65 @@
+#include <cmath>
+#include <iostream>
+
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+// Draws from path and from the scalar path, both seeded alike, and compares
+// every word. True if the build doesn't have path.
+template <TsetlinSIMDRandGen::Path path, size_t num_ps>
+static bool
+same_as_scalar(const float (&ps)[num_ps], size_t its) {
+    using Gen = TsetlinSIMDRandGen;
+    if constexpr (path > Gen::best) {
+        return true;
+    } else {
+        Gen scalar(42), simd(42);
+        bool same = true;
+        for (float p : ps) {
+            uint64_t threshold = Gen::bernoulli_threshold(p);
+            for (size_t i = 0; i < its; i++)
+                same &= simd.threshold_bits_64<path>(threshold) ==
+                        scalar.threshold_bits_64<Gen::SCALAR>(threshold);
+        }
+        std::cout << "Path " << path << " matches scalar: " << same
+                  << std::endl;
+        return same;
+    }
+}
+
+// The observed frequency of set bits should be close to p, and the bits past
+// the end of the bitset should stay clear.
+int
+main() {
+    static constexpr size_t bits = 1000;
+    static constexpr size_t its = 2000;
+    TsetlinSIMDRandGen rg;
+    TBitset<bits> bs;
+
+    bool ok = true;
+    float ps[] = {0, .001, .1, .25, .5, .9, 1};
+    for (float p : ps) {
+        size_t set = 0;
+        for (size_t i = 0; i < its; i++) {
+            rg.biased_bits(bs, p);
+            set += bs.count();
+        }
+        double freq = set / (double)(bits * its);
+        bool close = std::fabs(freq - p) < .005;
+        ok &= close;
+        std::cout << "p: " << p << " freq: " << freq
+                  << (close ? "" : "  <-- MISMATCH") << std::endl;
+    }
+
+    // Every compiled path, stepped from the same seed, gives the same bits.
+    bool same = same_as_scalar<TsetlinSIMDRandGen::AVX2>(ps, its) &&
+                same_as_scalar<TsetlinSIMDRandGen::AVX512>(ps, its);
+
+    std::cout << "First word at p=.5: "
+              << std::bitset<TINT_BIT_NUM>(
+                     TsetlinSIMDRandGen().biased_bits_64(.5))
+              << std::endl;
+    check("Set bit frequencies", ok);
+    check("Same bits on every path", same);
+    return test_result();
+}
@@ -0,0 +1,93 @@
+#include <iostream>
+#include <vector>
+
+#include "../utils/Binarizer.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+static constexpr size_t features = 100;  // Not a multiple of 64 on purpose
+static constexpr size_t rows = 2000;
+static constexpr size_t levels = 3;
+
+// Compare the SIMD packing against a plain loop, and check that quantile
+// thresholds split the data evenly.
+template <typename T>
+static void
+check_type(const std::string& name, TsetlinRandGen& rg, TThreadpool& pool) {
+    std::vector<T> data(rows * features);
+    for (auto& x : data) {
+        if constexpr (std::is_same_v<T, float>)
+            x = (rg.rand_64() % 100000) / 1000.0f;
+        else
+            x = rg.rand_64();
+    }
+    T lo = 0, hi = std::is_same_v<T, float> ? 100 : 255;
+
+    bool ok = true;
+    auto thermo = Binarizer<T>::thermometer(features, levels, lo, hi);
+    std::vector<TBitset<features * levels>> out(rows);
+    thermo.transform(data.data(), rows, out.data(), pool);
+    T step_thr[levels];
+    for (size_t l = 0; l < levels; l++)
+        step_thr[l] = (T)(lo + (double)(hi - lo) * (l + 1) / (levels + 1));
+    for (size_t r = 0; r < rows; r++)
+        for (size_t l = 0; l < levels; l++)
+            for (size_t f = 0; f < features; f++)
+                ok &= out[r][l * features + f] ==
+                      (data[r * features + f] > step_thr[l]);
+    check(name + " thermometer", ok);
+
+    // Tabular input has to come out the same as row major.
+    std::vector<std::vector<T>> columns(features, std::vector<T>(rows));
+    std::vector<const T*> column_ptrs;
+    for (size_t f = 0; f < features; f++) {
+        for (size_t r = 0; r < rows; r++)
+            columns[f][r] = data[r * features + f];
+        column_ptrs.push_back(columns[f].data());
+    }
+    std::vector<TBitset<features * levels>> out_cols(rows);
+    thermo.transform_columns(column_ptrs.data(), rows, out_cols.data(), pool);
+    bool cols_ok = true;
+    for (size_t r = 0; r < rows; r++)
+        for (size_t w = 0; w < out[r].buf_len; w++)
+            cols_ok &= out[r].buf[w] == out_cols[r].buf[w];
+    check(name + " columns", cols_ok);
+
+    auto quant = Binarizer<T>::quantile(features, levels);
+    quant.fit(data.data(), rows, pool);
+    quant.transform(data.data(), rows, out.data(), pool);
+    bool quant_ok = true;
+    for (size_t l = 0; l < levels; l++) {
+        size_t set = 0;
+        for (size_t r = 0; r < rows; r++)
+            for (size_t f = 0; f < features; f++)
+                set += out[r][l * features + f];
+        double expected = 1 - (l + 1) / (double)(levels + 1);
+        double frac = set / (double)(rows * features);
+        quant_ok &= frac > expected - .02 && frac < expected + .02;
+    }
+    check(name + " quantile", quant_ok);
+
+    auto adapt = Binarizer<T>::adaptive(features);
+    std::vector<TBitset<features>> out1(rows);
+    adapt.transform(data.data(), rows, out1.data(), pool);
+    bool adapt_ok = true;
+    for (size_t r = 0; r < rows; r++) {
+        double sum = 0;
+        for (size_t f = 0; f < features; f++) sum += data[r * features + f];
+        T mean = (T)(sum / features);
+        for (size_t f = 0; f < features; f++)
+            adapt_ok &= out1[r][f] == (data[r * features + f] > mean);
+        adapt_ok &= !(out1[r].buf[out1[r].buf_len - 1] >> (features % 64));
+    }
+    check(name + " adaptive", adapt_ok);
+}
+
+int
+main() {
+    TsetlinRandGen rg;
+    TThreadpool pool(4);
+    check_type<uint8_t>("uint8", rg, pool);
+    check_type<float>("float", rg, pool);
+    return test_result();
+}
@@ -0,0 +1,61 @@
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include "../utils/BinaryDatasetCache.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+static constexpr size_t bits = 784;
+static constexpr size_t n = 1000;
+
+int
+main() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/tsetlin-cache-test-%d.tbin",
+             (int)getpid());
+
+    TsetlinRandGen rg;
+    auto rows = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    unsigned char labels[n];
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < rows[i].buf_len; j++) rows[i].buf[j] = rg.rand_64();
+        labels[i] = rg.rand_64() % 10;
+    }
+
+    write_binary_cache(path, 1234, rows.get(), labels, n);
+
+    MappedBinaryDataset<bits> ds;
+    bool wrong_key = ds.open(path, 4321);
+    bool wrong_width = MappedBinaryDataset<bits + 1>().open(path, 1234);
+    bool opened = ds.open(path, 1234);
+
+    bool same = opened && ds.size() == n;
+    for (size_t i = 0; same && i < n; i++)
+        same &= !std::memcmp(&ds.sample(i), &rows[i], sizeof(rows[i])) &&
+                ds.label(i) == labels[i];
+    unlink(path);
+
+    // The default folder follows XDG_CACHE_HOME and gets created, parents
+    // included.
+    char xdg[64];
+    snprintf(xdg, sizeof(xdg), "/tmp/tsetlin-xdg-%d/nested", (int)getpid());
+    setenv("XDG_CACHE_HOME", xdg, 1);
+    std::string folder = binary_cache_default_folder();
+    struct stat st;
+    bool made = folder == std::string(xdg) + "/tsetlin" &&
+                stat(folder.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+    rmdir(folder.c_str());
+    rmdir(xdg);
+    rmdir(std::string(xdg, strrchr(xdg, '/')).c_str());
+
+    check("Rejects wrong key", !wrong_key);
+    check("Rejects wrong width", !wrong_width);
+    check("Round trip", same);
+    check("Default folder", made);
+    return test_result();
+}
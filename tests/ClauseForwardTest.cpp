@@ -0,0 +1,53 @@
+#include <iostream>
+
+#include "../machines/TsetlinMachine.h"
+#include "TestCommon.h"
+
+// 100 bits, so the second input word is only partly used.
+using ClauseConfig = TestConfig<100, 2>;
+
+using Machine = TsetlinMachine<ClauseConfig>;
+static constexpr size_t bits = ClauseConfig::input_bits;
+
+int
+main() {
+    Machine m;
+    auto* aut = m.get_backing();
+    for (size_t i = 0; i < Machine::get_backing_size(); i++) aut[i] = -1;
+
+    // Nothing included: always true.
+    TBitset<bits> x(true);
+    bool forward_ok = m.clause_forward(aut, x);
+
+    // inp 3, ~inp 70 and inp 99: true exactly when bits 3 and 99 are 1 and
+    // bit 70 is 0, whatever the other bits are.
+    aut[2 * 3] = aut[2 * 70 + 1] = aut[2 * 99] = 0;
+    forward_ok &= !m.clause_forward(aut, x);
+    x[3] = x[99] = 1;
+    forward_ok &= m.clause_forward(aut, x);
+    for (size_t i = 0; i < bits; i += 5) x[i] = i != 70;
+    forward_ok &= m.clause_forward(aut, x);
+    x[70] = 1;
+    forward_ok &= !m.clause_forward(aut, x);
+    x[70] = 0;
+    x[99] = 0;
+    forward_ok &= !m.clause_forward(aut, x);
+
+    // Type II feedback on a clause that output 1 pushes every excluded
+    // literal that is 0 one step toward include, and does nothing else.
+    for (size_t i = 0; i < Machine::get_backing_size(); i++) aut[i] = -1;
+    TBitset<bits> y(true);
+    for (size_t i = 0; i < bits; i += 3) y[i] = 1;
+    m.apply_t2_feedback(0, y, false);
+    bool t2_ok = true;
+    for (size_t i = 0; i < Machine::get_backing_size(); i++)
+        t2_ok &= aut[i] == -1;
+    m.apply_t2_feedback(0, y, true);
+    for (size_t i = 0; i < bits; i++)
+        t2_ok &= aut[2 * i] == (y[i] ? -1 : 0) &&
+                 aut[2 * i + 1] == (y[i] ? 0 : -1);
+
+    check("Clause forward", forward_ok);
+    check("Type II feedback", t2_ok);
+    return test_result();
+}
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../machines/ClauseTrie.h"
+#include "../machines/CompactModel.h"
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+using TrieConfig = TestConfig<200, 100>;
+
+using Machine = TsetlinMachine<TrieConfig>;
+static constexpr size_t n = 400, bits = TrieConfig::input_bits;
+
+int
+main() {
+    TsetlinRandGen rg(13);
+    auto x = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    bool y[n];
+    unsigned char labels[n];
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < bits; j++) x[i][j] = rg.rand_64() & 1;
+        y[i] = x[i][3] ^ x[i][140];
+        labels[i] = y[i] + x[i][77];
+    }
+
+    auto m = std::unique_ptr<Machine>(new Machine(1));
+    auto multi = std::unique_ptr<MultiClassTsetlinMachine<3, TrieConfig>>(
+        new MultiClassTsetlinMachine<3, TrieConfig>(2));
+    for (uint32_t e = 0; e < 5; e++)
+        for (size_t i = 0; i < n; i++) {
+            m->forward_backward(x[i], y[i], {e, (uint32_t)i});
+            multi->forward_backward(x[i], labels[i], {e, (uint32_t)i});
+        }
+
+    // Exactly the machines' votes, every class.
+    CompactModel<TrieConfig> compact(*m);
+    ClauseTrie<TrieConfig> trie(compact);
+    std::unique_ptr<CompactModel<TrieConfig>> compact_multi[3];
+    const CompactModel<TrieConfig>* classes[3];
+    for (size_t c = 0; c < 3; c++) {
+        compact_multi[c].reset(new CompactModel<TrieConfig>(multi->machine(c)));
+        classes[c] = compact_multi[c].get();
+    }
+    ClauseTrie<TrieConfig> trie_multi(classes, 3);
+    bool trained_ok = true;
+    size_t checks = 0;
+    for (size_t i = 0; i < n; i++) {
+        int v, mv[3];
+        checks += trie.votes(x[i], &v);
+        trie_multi.votes(x[i], mv);
+        trained_ok &=
+            v == m->votes(x[i]) && trie.predict(x[i]) == m->forward(x[i]);
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        // Not the machine's tie stream, so only as good a class.
+        trained_ok &= mv[trie_multi.predict(x[i])] ==
+                      mv[multi->forward(x[i])];
+#else
+        trained_ok &= trie_multi.predict(x[i]) == multi->forward(x[i]);
+#endif
+        for (size_t c = 0; c < 3; c++)
+            trained_ok &= mv[c] == multi->machine(c).votes(x[i]);
+    }
+
+    // Three copies of one class tie on every input.
+    const CompactModel<TrieConfig>* same[3] = {&compact, &compact, &compact};
+    ClauseTrie<TrieConfig> trie_tied(same, 3);
+    size_t tie_winners[3] = {};
+    for (size_t i = 0; i < n; i++) tie_winners[trie_tied.predict(x[i])]++;
+#if ARGMAX_TIEBREAK == AM_FIRST
+    bool ties_ok = tie_winners[0] == n;
+#elif ARGMAX_TIEBREAK == AM_LAST
+    bool ties_ok = tie_winners[2] == n;
+#else
+    bool ties_ok = tie_winners[0] && tie_winners[1] && tie_winners[2];
+#endif
+
+    // Every clause includes bit 5, and then one of bits 70 to 79. The check
+    // on word 0 is shared by all of them, and is all a sample with bit 5
+    // unset ever looks at.
+    auto p = std::unique_ptr<Machine>(new Machine(3));
+    auto* aut = p->get_backing();
+    size_t per_clause = Machine::get_backing_size() / TrieConfig::num_clauses;
+    for (size_t c = 0; c < TrieConfig::num_clauses; c++) {
+        auto* cl = aut + c * per_clause;
+        for (size_t i = 0; i < per_clause; i++) cl[i] = -1;
+        bool positive = c < TrieConfig::num_clauses / 2;
+        cl[2 * 5] = 0;
+        cl[2 * (70 + c % 10) + !positive] = 0;
+    }
+    p->recount_included();
+    CompactModel<TrieConfig> compact_planted(*p);
+    ClauseTrie<TrieConfig> planted(compact_planted);
+    bool planted_ok = planted.num_nodes() == 1 + 10 + 10 &&
+                      planted.num_unshared() == 2 * 20;
+    for (size_t i = 0; i < n; i++) {
+        int v;
+        size_t planted_checks = planted.votes(x[i], &v);
+        planted_ok &= v == p->votes(x[i]) && (x[i][5] || planted_checks == 1);
+    }
+
+    std::cout << "Trained: " << trie.to_string() << ", "
+              << (double)checks / n << " checked per sample"
+              << "\nMulti-class: " << trie_multi.to_string() << std::endl;
+    check("Trained", trained_ok);
+    check("Ties", ties_ok);
+    check("Planted", planted_ok);
+    return test_result();
+}
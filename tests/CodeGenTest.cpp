@@ -0,0 +1,145 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "../machines/CodeGen.h"
+#include "../machines/CompactModel.h"
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+using GenConfig = TestConfig<100, 120>;
+
+static constexpr size_t n = 400, bits = GenConfig::input_bits,
+                        words = TBitset<bits>::buf_len;
+
+// The generated code is compiled with the system compiler ($CXX, or c++)
+// into a program that reads inputs from one file and writes what the
+// generated functions say to another.
+static const char driver[] = R"(
+#include <cstdio>
+#include "model.h"
+
+int
+main(int, char** argv) {
+    FILE* in = fopen(argv[1], "rb");
+    FILE* out = fopen(argv[2], "w");
+    uint64_t x[bin_input_words];
+    while (fread(x, sizeof(x), 1, in) == 1) {
+        int votes[3];
+        multi_votes(x, votes);
+        fprintf(out, "%d %d %d %d %d %zu %zu\n", bin_votes(x),
+                (int)bin_predict(x), votes[0], votes[1], votes[2],
+                multi_predict(x), tie_predict(x));
+    }
+}
+)";
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    bool y[n];
+    unsigned char labels[n];
+    synth_noisy_xor(x.get(), y, n, .05);
+    for (size_t i = 0; i < n; i++) labels[i] = y[i] + x[i][7];
+
+    auto bin = std::unique_ptr<TsetlinMachine<GenConfig>>(
+        new TsetlinMachine<GenConfig>(3));
+    auto multi = std::unique_ptr<MultiClassTsetlinMachine<3, GenConfig>>(
+        new MultiClassTsetlinMachine<3, GenConfig>(4));
+    for (uint32_t e = 0; e < 4; e++)
+        for (size_t i = 0; i < n; i++) {
+            bin->forward_backward(x[i], y[i], {e, (uint32_t)i});
+            multi->forward_backward(x[i], labels[i], {e, (uint32_t)i});
+        }
+
+    std::string dir = "/tmp/tsetlin_codegen_" + std::to_string(getpid());
+    std::string mkdir = "mkdir -p " + dir;
+    if (std::system(mkdir.c_str())) return 1;
+
+    // Both models in one header.
+    CompactModel<GenConfig> compact_bin(*bin);
+    std::unique_ptr<CompactModel<GenConfig>> compact_multi[3];
+    const CompactModel<GenConfig>* classes[3];
+    for (size_t c = 0; c < 3; c++) {
+        compact_multi[c].reset(new CompactModel<GenConfig>(multi->machine(c)));
+        classes[c] = compact_multi[c].get();
+    }
+    write_cpp_model((dir + "/bin.h").c_str(), "bin", compact_bin);
+    write_cpp_model((dir + "/multi.h").c_str(), "multi", classes, 3);
+    // Three copies of one class tie on every input.
+    const CompactModel<GenConfig>* tied[3] = {&compact_bin, &compact_bin,
+                                              &compact_bin};
+    write_cpp_model((dir + "/tie.h").c_str(), "tie", tied, 3);
+    FILE* fp = fopen((dir + "/model.h").c_str(), "w");
+    fprintf(fp, "#include \"bin.h\"\n#include \"multi.h\"\n"
+                "#include \"tie.h\"\n");
+    fclose(fp);
+    fp = fopen((dir + "/driver.cpp").c_str(), "w");
+    fputs(driver, fp);
+    fclose(fp);
+    fp = fopen((dir + "/inputs").c_str(), "wb");
+    for (size_t i = 0; i < n; i++) fwrite(x[i].buf, sizeof(tint), words, fp);
+    fclose(fp);
+
+    const char* cxx = std::getenv("CXX") ? std::getenv("CXX") : "c++";
+    std::string build = std::string(cxx) + " -std=c++17 -O1 -o " + dir +
+                        "/driver " + dir + "/driver.cpp && " + dir +
+                        "/driver " + dir + "/inputs " + dir + "/outputs";
+    bool built_ok = std::system(build.c_str()) == 0;
+
+    bool bin_ok = built_ok, multi_ok = built_ok, tie_ok = built_ok;
+    size_t tie_winners[3] = {};
+    fp = fopen((dir + "/outputs").c_str(), "r");
+    for (size_t i = 0; fp && i < n; i++) {
+        int bv, bp, v[3];
+        size_t mp, tp;
+        if (fscanf(fp, "%d %d %d %d %d %zu %zu", &bv, &bp, &v[0], &v[1],
+                   &v[2], &mp, &tp) != 7) {
+            bin_ok = multi_ok = tie_ok = false;
+            break;
+        }
+        tie_ok &= tp < 3;
+        tie_winners[tp < 3 ? tp : 0]++;
+        bin_ok &= bv == bin->votes(x[i]) && (bool)bp == bin->forward(x[i]);
+        for (size_t c = 0; c < 3; c++)
+            multi_ok &= v[c] == multi->machine(c).votes(x[i]);
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        // Not the machine's generator, so only as good a class.
+        multi_ok &= mp < 3 && v[mp] == v[multi->forward(x[i])];
+#else
+        multi_ok &= mp == multi->forward(x[i]);
+#endif
+    }
+    if (fp) fclose(fp);
+#if ARGMAX_TIEBREAK == AM_FIRST
+    tie_ok &= tie_winners[0] == n;
+#elif ARGMAX_TIEBREAK == AM_LAST
+    tie_ok &= tie_winners[2] == n;
+#else
+    for (size_t c = 0; c < 3; c++) tie_ok &= tie_winners[c] > n / 6;
+#endif
+
+    // Names go into identifiers.
+    for (const char* bad : {"", "2fast", "my-model", "a b"}) {
+        try {
+            write_cpp_model((dir + "/bad.h").c_str(), bad, compact_bin);
+            tie_ok = false;
+        } catch (const std::invalid_argument&) {
+        }
+    }
+    std::string rm = "rm -rf " + dir;
+    if (std::system(rm.c_str())) return 1;
+
+    check("Generated code builds", built_ok);
+    check("Binary", bin_ok);
+    check("Multi-class", multi_ok);
+    check("Ties and names", tie_ok);
+    return test_result();
+}
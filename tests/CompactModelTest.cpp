@@ -0,0 +1,68 @@
+#include <iostream>
+#include <memory>
+
+#include "../machines/CompactModel.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+using CompactConfig = TestConfig<70, 200>;
+
+using Machine = TsetlinMachine<CompactConfig>;
+static constexpr size_t n = 500, bits = CompactConfig::input_bits;
+
+static bool
+same_votes(const Machine& m, const CompactModel<CompactConfig>& c,
+           const TBitset<bits>* x) {
+    bool ok = true;
+    for (size_t i = 0; i < n; i++)
+        ok &= c.votes(x[i]) == m.votes(x[i]) &&
+              c.forward(x[i]) == m.forward(x[i]);
+    return ok;
+}
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .05);
+
+    // Trained.
+    auto m = std::unique_ptr<Machine>(new Machine(8));
+    for (uint32_t e = 0; e < 5; e++)
+        for (size_t i = 0; i < n; i++)
+            m->forward_backward(x[i], y[i], {e, (uint32_t)i});
+    CompactModel<CompactConfig> trained(*m);
+    bool trained_ok = same_votes(*m, trained, x.get());
+
+    // Every case planted by hand: clause c is a copy of clause c % 5. Clause
+    // 0 includes nothing, but its negative copies include bit 10. Clause 1
+    // includes bit 3 and its negation.
+    // Positive and negative copies of 2 and 3 cancel out. The negative
+    // copies of 4 include one more bit, so 4 leaves two weighted clauses.
+    auto p = std::unique_ptr<Machine>(new Machine(9));
+    auto* aut = p->get_backing();
+    size_t per_clause =
+        Machine::get_backing_size() / CompactConfig::num_clauses;
+    for (size_t c = 0; c < CompactConfig::num_clauses; c++) {
+        auto* cl = aut + c * per_clause;
+        size_t kind = c % 5;
+        for (size_t i = 0; i < per_clause; i++) cl[i] = -1;
+        if (kind == 1) cl[2 * 3] = cl[2 * 3 + 1] = 0;
+        if (kind >= 2) cl[2 * kind] = 0, cl[2 * (kind + 60) + 1] = 5;
+        if (c >= CompactConfig::num_clauses / 2) {
+            if (kind == 0) cl[2 * 10] = 0;
+            if (kind == 4) cl[2 * 65] = 0;
+        }
+    }
+    p->recount_included();
+    CompactModel<CompactConfig> planted(*p);
+    bool planted_ok = same_votes(*p, planted, x.get()) &&
+                      planted.size() == 3 && planted.constant() == 20;
+
+    std::cout << trained.to_string() << '\n'
+              << planted.to_string() << std::endl;
+    check("Trained", trained_ok);
+    check("Planted", planted_ok);
+    return test_result();
+}
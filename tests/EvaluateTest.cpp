@@ -0,0 +1,85 @@
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/StreamingDataset.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TestCommon.h"
+
+using EvalConfig = TestConfig<32, 64>;
+
+static constexpr size_t n = 1000, num_classes = 4;
+
+int
+main() {
+    // The class is the first two bits, the rest are noise.
+    auto x = std::unique_ptr<TBitset<32>[]>(new TBitset<32>[n]);
+    bool y[n];
+    unsigned char labels[n];
+    synth_noisy_xor(x.get(), y, n, 0);
+    for (size_t i = 0; i < n; i++) labels[i] = x[i][0] | x[i][1] << 1;
+
+    TThreadpool one(1), three(3);
+
+    // Binary: the same counts as forward() one at a time, on any number of
+    // threads.
+    auto bin = std::unique_ptr<TsetlinMachine<EvalConfig>>(
+        new TsetlinMachine<EvalConfig>(5));
+    for (uint32_t e = 0; e < 10; e++)
+        for (size_t i = 0; i < n; i++)
+            bin->forward_backward(x[i], y[i], {e, (uint32_t)i});
+    EvalResult b1 = bin->evaluate(x.get(), y, n, one);
+    EvalResult b3 = bin->evaluate(x.get(), y, n, three);
+    size_t serial[2][2] = {};
+    for (size_t i = 0; i < n; i++) serial[y[i]][bin->forward(x[i])]++;
+    bool binary_ok = b1.confusion == b3.confusion && b3.samples() == n &&
+                     b3.count(0, 0) == serial[0][0] &&
+                     b3.count(0, 1) == serial[0][1] &&
+                     b3.count(1, 0) == serial[1][0] &&
+                     b3.count(1, 1) == serial[1][1] && b3.seconds > 0;
+
+    // Multi-class learns the two bit code.
+    using MultiClass = MultiClassTsetlinMachine<num_classes, EvalConfig>;
+    auto mc = std::unique_ptr<MultiClass>(new MultiClass(5));
+    for (uint32_t e = 0; e < 10; e++)
+        for (size_t i = 0; i < n; i++)
+            mc->forward_backward(x[i], labels[i], {e, (uint32_t)i});
+    EvalResult m = mc->evaluate(x.get(), labels, n, three);
+    EvalResult serial_m(num_classes);
+    for (size_t i = 0; i < n; i++)
+        serial_m.confusion[labels[i] * num_classes + mc->forward(x[i])]++;
+    bool multi_ok = m.accuracy() > .9 && m.confusion == serial_m.confusion;
+    // A label past the last class trains nothing.
+    try {
+        mc->forward_backward(x[0], num_classes, {0, 0});
+        multi_ok = false;
+    } catch (const std::out_of_range&) {
+    }
+
+    // A stream gives the same as the arrays, in chunks.
+    InMemoryStream<32> stream(x.get(), labels, n, 96, true);
+    EvalResult s = mc->evaluate(stream, three);
+    bool stream_ok = s.confusion == m.confusion;
+
+    // Ties are broken per machine, so two machines seeded alike break them
+    // alike, whatever else predicts in between. Untrained, most inputs tie.
+    auto t1 = std::unique_ptr<MultiClass>(new MultiClass(9));
+    auto t2 = std::unique_ptr<MultiClass>(new MultiClass(9));
+    auto other = std::unique_ptr<MultiClass>(new MultiClass(10));
+    bool ties_ok = true;
+    for (size_t i = 0; i < n; i++) {
+        size_t a = t1->forward(x[i]);
+        other->forward(x[i]);
+        ties_ok &= t2->forward(x[i]) == a;
+    }
+
+    std::cout << m.to_string() << std::endl;
+    check("Binary", binary_ok);
+    check("Multi-class", multi_ok);
+    check("Stream", stream_ok);
+    check("Ties", ties_ok);
+    return test_result();
+}
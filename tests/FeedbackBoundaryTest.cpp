@@ -0,0 +1,56 @@
+#include <iostream>
+
+#include "../machines/TsetlinMachine.h"
+#include "TestCommon.h"
+
+// 200 clauses puts the boundary between positive and negative clause outputs
+// inside a word (bit 100), and leaves unused bits in the last one. 128 puts
+// it between words.
+template <size_t clauses>
+using BoundaryConfig = TestConfig<8, clauses>;
+
+template <size_t clauses>
+static bool
+sums() {
+    using Machine = TsetlinMachine<BoundaryConfig<clauses>>;
+    constexpr int half = clauses / 2;
+    TBitset<clauses> out;
+    for (size_t i = 0; i < out.buf_len; i++) out.buf[i] = 0;
+    bool ok = Machine::summation_forward(out) == 0;
+    out[half - 1] = 1;
+    ok &= Machine::summation_forward(out) == 1;
+    out[half] = 1;
+    ok &= Machine::summation_forward(out) == 0;
+    for (size_t i = 0; i < clauses; i++) out[i] = i < (size_t)half;
+    ok &= Machine::summation_forward(out) == half;
+    for (size_t i = 0; i < clauses; i++) out[i] = i >= (size_t)half;
+    ok &= Machine::summation_forward(out) == -half;
+    // Bits past the last clause aren't outputs.
+    if constexpr (clauses % TINT_BIT_NUM)
+        out.buf[out.buf_len - 1] |= (tint)1 << (TINT_BIT_NUM - 1);
+    ok &= Machine::summation_forward(out) == -half;
+    return ok;
+}
+
+int
+main() {
+    // eq. 3 is for y = 1, eq. 4 for y = 0. No feedback once the sum is at
+    // the target for the desired output, all of it at the opposite one, and
+    // the sum is clipped to [-T, T] first.
+    using Machine = TsetlinMachine<BoundaryConfig<200>>;
+    constexpr int T = 10;
+    bool prob_ok = Machine::feedback_probability(T, true) == 0 &&
+                   Machine::feedback_probability(-T, true) == 1 &&
+                   Machine::feedback_probability(T, false) == 1 &&
+                   Machine::feedback_probability(-T, false) == 0 &&
+                   Machine::feedback_probability(3 * T, true) == 0 &&
+                   Machine::feedback_probability(-3 * T, false) == 0 &&
+                   Machine::feedback_probability(T - 1, true) == .05f &&
+                   Machine::feedback_probability(0, true) == .5f &&
+                   Machine::feedback_probability(0, false) == .5f;
+
+    bool sum_ok = sums<200>() && sums<128>();
+    check("Feedback at +-T", prob_ok);
+    check("Vote sums", sum_ok);
+    return test_result();
+}
@@ -0,0 +1,44 @@
+#include <iostream>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+// With S = 1 Type I feedback is deterministic: a clause that outputs 1
+// leaves every literal that is 1 alone, and pushes every excluded literal
+// that is 0 further toward exclude.
+class LiteralConfig {
+   public:
+    static constexpr size_t input_bits = 100;
+    static constexpr size_t num_clauses = 2;
+    static constexpr size_t summation_target = 10;
+    static constexpr float S = 1;
+    static char TsetlinAutomaton;
+    static constexpr size_t num_states = 256;
+};
+
+using Machine = TsetlinMachine<LiteralConfig>;
+static constexpr size_t bits = LiteralConfig::input_bits;
+
+int
+main() {
+    Machine m;
+    auto* aut = m.get_backing();
+    for (size_t i = 0; i < Machine::get_backing_size(); i++) aut[i] = -1;
+
+    TBitset<bits> x(true);
+    for (size_t i = 0; i < bits; i += 3) x[i] = 1;
+    TsetlinRandGen rg(1);
+    m.apply_t1_feedback(rg, 0, x, true);
+
+    // ~inp is the literal that's 1 for a 0 bit. ~input[i] used to be
+    // TBitRef::operator~, which was always false, so the ~inp automaton of
+    // every 0 bit got fed a 0 and moved.
+    bool ok = true;
+    for (size_t i = 0; i < bits; i++)
+        ok &= aut[2 * i] == (x[i] ? -1 : -2) &&
+              aut[2 * i + 1] == (x[i] ? -2 : -1);
+
+    check("Negated literal", ok);
+    return test_result();
+}
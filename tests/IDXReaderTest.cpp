@@ -0,0 +1,87 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../utils/IDXReader.h"
+#include "TestCommon.h"
+
+static void
+write_file(const char* path, const std::vector<unsigned char>& bytes) {
+    FILE* fp = fopen(path, "wb");
+    fwrite(bytes.data(), 1, bytes.size(), fp);
+    fclose(fp);
+}
+
+static bool
+rejects(const char* path, const std::vector<unsigned char>& bytes) {
+    write_file(path, bytes);
+    try {
+        IDXFile f(path);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+int
+main() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/tsetlin-idx-test-%d.idx", (int)getpid());
+
+    // 3 x 2 x 2 uint8, like a tiny image file.
+    std::vector<unsigned char> u8 = {0, 0, 0x08, 3, 0, 0, 0, 3, 0, 0,
+                                     0, 2, 0, 0, 0, 2};
+    for (int i = 0; i < 12; i++) u8.push_back(i * 10);
+    write_file(path, u8);
+    bool u8_ok;
+    {
+        IDXFile f(path);
+        u8_ok = f.dtype() == IDXType::U8 && f.count() == 3 &&
+                f.shape() == std::vector<size_t>{3, 2, 2} &&
+                f.header().item_bytes() == 4 && f.item(2)[1] == 90;
+        try {
+            f.expect(IDXType::U8, {4}, path);
+            u8_ok = false;
+        } catch (const std::runtime_error&) {
+        }
+        f.expect(IDXType::U8, {2, 2}, path);
+    }
+
+    // 2 big endian int32s and 2 float32s.
+    std::vector<unsigned char> i32 = {0, 0, 0x0C, 1, 0, 0, 0, 2,
+                                      0xff, 0xff, 0xff, 0xfe, 0, 1, 0, 0};
+    write_file(path, i32);
+    bool i32_ok;
+    {
+        IDXFile f(path);
+        i32_ok = f.at<int32_t>(0) == -2 && f.at<int32_t>(1) == 65536;
+    }
+    std::vector<unsigned char> f32 = {0, 0, 0x0D, 1, 0, 0, 0, 2,
+                                      0x3f, 0x80, 0, 0, 0xc0, 0x20, 0, 0};
+    write_file(path, f32);
+    {
+        IDXFile f(path);
+        i32_ok &= f.at<float>(0) == 1.0f && f.at<float>(1) == -2.5f;
+    }
+
+    std::vector<unsigned char> bad_magic = u8, bad_type = u8, bad_ndim = u8;
+    std::vector<unsigned char> truncated = u8, trailing = u8;
+    bad_magic[1] = 1;
+    bad_type[2] = 0x0A;
+    bad_ndim[3] = 0;
+    truncated.pop_back();
+    trailing.push_back(0);
+    bool rejected = rejects(path, bad_magic) && rejects(path, bad_type) &&
+                    rejects(path, bad_ndim) && rejects(path, truncated) &&
+                    rejects(path, trailing) && rejects(path, {0, 0, 8});
+    unlink(path);
+
+    check("uint8 items", u8_ok);
+    check("Multi byte dtypes", i32_ok);
+    check("Rejects malformed files", rejected);
+    return test_result();
+}
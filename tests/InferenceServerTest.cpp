@@ -0,0 +1,148 @@
+#include <unistd.h>
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../machines/InferenceClient.h"
+#include "../machines/InferenceServer.h"
+#include "../machines/ModelFile.h"
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+using ServeConfig = TestConfig<64, 100>;
+
+using Machine = TsetlinMachine<ServeConfig>;
+static constexpr size_t n = 400, num_clients = 4, per_client = 300,
+                        depth = 8;
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    unsigned char labels[n];
+    synth_noisy_xor(x.get(), y, n, .05);
+    for (size_t i = 0; i < n; i++) labels[i] = y[i] + 2 * x[i][5];
+
+    auto binary = std::unique_ptr<Machine>(new Machine(1));
+    auto multi = std::unique_ptr<MultiClassTsetlinMachine<4, ServeConfig>>(
+        new MultiClassTsetlinMachine<4, ServeConfig>(2));
+    for (uint32_t e = 0; e < 3; e++)
+        for (size_t i = 0; i < n; i++) {
+            binary->forward_backward(x[i], y[i], {e, (uint32_t)i});
+            multi->forward_backward(x[i], labels[i], {e, (uint32_t)i});
+        }
+
+    // Through a model file and back.
+    std::string model_path =
+        "/tmp/tsetlin_serve_test_" + std::to_string(getpid()) + ".tsm";
+    const Machine* classes[4];
+    for (size_t c = 0; c < 4; c++) classes[c] = &multi->machine(c);
+    save_model(model_path.c_str(), classes, 4);
+    auto loaded = std::unique_ptr<Machine>(new Machine());
+    load_model(model_path.c_str(), *loaded, 2);
+    bool file_ok = model_file_machines<ServeConfig>(model_path.c_str()) == 4;
+    for (size_t i = 0; i < n; i++)
+        file_ok &= loaded->votes(x[i]) == multi->machine(2).votes(x[i]);
+
+    std::vector<InferenceModel<ServeConfig>> models;
+    models.push_back(inference_model(*binary));
+    models.push_back(load_inference_model<ServeConfig>(model_path.c_str()));
+    // Three copies of one machine tie on every input.
+    models.emplace_back();
+    for (size_t c = 0; c < 3; c++)
+        models.back().emplace_back(new TsetlinSnapshot<ServeConfig>(*binary));
+    std::remove(model_path.c_str());
+
+    std::string sock =
+        "/tmp/tsetlin_serve_test_" + std::to_string(getpid()) + ".sock";
+    InferenceServerOptions options;
+    options.max_batch = 16;
+    options.max_wait_us = 2000;
+    options.threads = 2;
+    InferenceServer<ServeConfig> server(sock.c_str(), std::move(models),
+                                        options);
+
+    // Several clients, each with several requests in flight, alternating
+    // between the models. Every answer must be what the machines say.
+    std::vector<char> client_ok(num_clients, 1);
+    std::vector<std::thread> clients;
+    for (size_t t = 0; t < num_clients; t++)
+        clients.emplace_back([&, t] {
+            InferenceClient<64> client(sock.c_str());
+            auto expect = [&](size_t k) {
+                InferenceResult r = client.receive();
+                size_t i = (t * 97 + k) % n;
+                bool ok = r.id == k && r.status == INFER_OK;
+                if (k % 2 == 0) {
+                    ok &= r.votes.size() == 1 &&
+                          r.votes[0] == binary->votes(x[i]) &&
+                          r.predicted == binary->forward(x[i]);
+                } else {
+                    ok &= r.votes.size() == 4 && r.predicted < 4;
+                    for (size_t c = 0; ok && c < 4; c++)
+                        ok &= r.votes[c] == multi->machine(c).votes(x[i]);
+#if ARGMAX_TIEBREAK == AM_RANDOM
+                    // Not the machine's tie stream, so only as good a class.
+                    ok = ok && r.votes[r.predicted] ==
+                                   r.votes[multi->forward(x[i])];
+#else
+                    ok &= r.predicted == multi->forward(x[i]);
+#endif
+                }
+                client_ok[t] &= ok;
+            };
+            for (size_t k = 0; k < per_client; k++) {
+                client.send(k % 2, x[(t * 97 + k) % n]);
+                if (k >= depth) expect(k - depth);
+            }
+            for (size_t k = per_client - depth; k < per_client; k++) expect(k);
+        });
+    for (auto& c : clients) c.join();
+    bool answers_ok = true;
+    for (char ok : client_ok) answers_ok &= ok;
+
+    InferenceClient<64> client(sock.c_str());
+    bool errors_ok = client.infer(7, x[0]).status == INFER_BAD_MODEL;
+    InferenceClient<128> wrong_shape(sock.c_str());
+    errors_ok &= wrong_shape.infer(0, TBitset<128>()).status == INFER_BAD_SHAPE;
+    errors_ok &= client.infer(0, x[0]).status == INFER_OK;
+
+    // Ties are broken like the multi-class machine breaks them.
+    size_t tie_winners[3] = {};
+    for (size_t i = 0; i < 60; i++) {
+        InferenceResult r = client.infer(2, x[i]);
+        tie_winners[r.predicted < 3 ? r.predicted : 0]++;
+    }
+#if ARGMAX_TIEBREAK == AM_FIRST
+    bool ties_ok = tie_winners[0] == 60;
+#elif ARGMAX_TIEBREAK == AM_LAST
+    bool ties_ok = tie_winners[2] == 60;
+#else
+    bool ties_ok = tie_winners[0] && tie_winners[1] && tie_winners[2];
+#endif
+
+    // Pipelined requests have company, so batches hold more than one.
+    InferenceStats stats = server.stats();
+    bool stats_ok = stats.requests == num_clients * per_client + 63 &&
+                    stats.mean_batch() > 1 && stats.p50_us <= stats.p99_us &&
+                    stats.p99_us <= stats.max_us;
+
+    // A request is counted by the time its answer arrives.
+    for (uint64_t k = 1; k <= 200; k++) {
+        client.infer(k % 2, x[k % n]);
+        stats_ok &= server.stats().requests == stats.requests + k;
+    }
+
+    std::cout << stats.to_string() << std::endl;
+    check("Model file", file_ok);
+    check("Answers", answers_ok);
+    check("Errors", errors_ok);
+    check("Ties", ties_ok);
+    check("Stats", stats_ok);
+    return test_result();
+}
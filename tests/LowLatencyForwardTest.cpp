@@ -0,0 +1,43 @@
+#include <iostream>
+#include <memory>
+
+#include "../machines/LowLatencyForward.h"
+#include "../machines/TsetlinMachine.h"
+#include "../machines/TsetlinSnapshot.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+using LatencyConfig = TestConfig<64, 202>;
+
+using Machine = TsetlinMachine<LatencyConfig>;
+static constexpr size_t n = 300;
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .05);
+    auto m = std::unique_ptr<Machine>(new Machine(3));
+    for (uint32_t e = 0; e < 3; e++)
+        for (size_t i = 0; i < n; i++)
+            m->forward_backward(x[i], y[i], {e, (uint32_t)i});
+    TsetlinSnapshot<LatencyConfig> snapshot(*m);
+
+    // Any split of the clauses adds up to the same votes, including splits
+    // into more threads than there are cores.
+    bool machine_ok = true, snapshot_ok = true;
+    for (size_t threads : {1, 2, 3, 5}) {
+        LowLatencyForward<LatencyConfig> fast(*m, threads);
+        LowLatencyForward<LatencyConfig, TsetlinSnapshot> fast_snap(snapshot,
+                                                                    threads);
+        for (size_t i = 0; i < n; i++) {
+            machine_ok &= fast.votes(x[i]) == m->votes(x[i]) &&
+                          fast.forward(x[i]) == m->forward(x[i]);
+            snapshot_ok &= fast_snap.votes(x[i]) == m->votes(x[i]);
+        }
+    }
+
+    check("Machine", machine_ok);
+    check("Snapshot", snapshot_ok);
+    return test_result();
+}
@@ -0,0 +1,73 @@
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "../utils/MetricsReporter.h"
+#include "TestCommon.h"
+
+static std::string
+slurp(const char* path) {
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static size_t
+count_lines(const std::string& s) {
+    size_t n = 0;
+    for (char c : s) n += c == '\n';
+    return n;
+}
+
+int
+main() {
+    const char* csv_path = "/tmp/tsetlin_metrics_test.csv";
+    const char* json_path = "/tmp/tsetlin_metrics_test.json";
+    MetricsOptions options;
+    options.progress = false;
+    options.epochs = false;
+    options.csv_path = csv_path;
+    options.json_path = json_path;
+
+    // One epoch, logged once flushed.
+    bool logged_ok;
+    {
+        MetricsReporter reporter(options);
+        reporter.begin_phase("Train", 100);
+        for (size_t i = 1; i <= 100; i++) reporter.progress(i, i / 2);
+        EpochMetrics m;
+        m.epoch = 3;
+        m.train_accurate = 50, m.num_train = 100;
+        m.valid_accurate = 30, m.num_valid = 40;
+        m.train_seconds = 2, m.valid_seconds = .5;
+        reporter.epoch(m);
+        reporter.flush();
+
+        std::string csv = slurp(csv_path), json = slurp(json_path);
+        logged_ok =
+            csv.find("\n3,0.500000,0.750000,2.000,0.500,50.0,80.0\n") !=
+                std::string::npos &&
+            json == "{\"epoch\": 3, \"train_accuracy\": 0.500000, "
+                    "\"valid_accuracy\": 0.750000, \"train_seconds\": 2.000, "
+                    "\"valid_seconds\": 0.500, \"train_samples_per_sec\": "
+                    "50.0, \"valid_samples_per_sec\": 80.0}\n";
+    }
+
+    // A full ring drops records instead of blocking, and everything that
+    // made it in is written by the time the reporter is gone.
+    size_t pushed = 1000, dropped;
+    options.interval = 10;
+    {
+        MetricsReporter reporter(options);
+        for (size_t i = 0; i < pushed; i++) reporter.epoch(EpochMetrics());
+        dropped = reporter.num_dropped();
+    }
+    size_t rows = count_lines(slurp(csv_path)) - 1;
+    bool ring_ok = dropped > 0 && rows + dropped == pushed;
+
+    check("Epoch logs", logged_ok);
+    check("Full ring drops", ring_ok);
+    return test_result();
+}
@@ -0,0 +1,95 @@
+#define TSETLIN_STATS 1
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+using CacheConfig = TestConfig<100, 100>;
+
+using Machine = TsetlinMachine<CacheConfig>;
+static constexpr size_t n = 300, bits = CacheConfig::input_bits;
+
+static bool
+same(const Machine& a, const Machine& b) {
+    return !std::memcmp(a.get_backing(), b.get_backing(),
+                        Machine::get_backing_size());
+}
+
+int
+main() {
+    TsetlinRandGen rg(17);
+    auto x = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    std::vector<std::vector<uint32_t>> idx(n);
+    bool y[n];
+    unsigned char labels[n];
+    for (size_t i = 0; i < n; i++) {
+        for (size_t j = 0; j < bits; j++) {
+            x[i][j] = rg.rand_bernoulli(.2);
+            if (x[i][j]) idx[i].push_back((uint32_t)j);
+        }
+        y[i] = x[i][3] | x[i][40];
+        labels[i] = x[i][3] + x[i][40];
+    }
+
+    // The same training, with and without the cache, dense and sparse.
+    auto plain = std::unique_ptr<Machine>(new Machine(5));
+    auto cached = std::unique_ptr<Machine>(new Machine(5));
+    auto sparse = std::unique_ptr<Machine>(new Machine(5));
+    cached->enable_output_cache(n);
+    sparse->enable_output_cache(n);
+    bool train_ok = true;
+    double first_rate = 0, last_rate = 0;
+    for (uint32_t e = 0; e < 20; e++) {
+        TsetlinStats before = cached->stats();
+        for (size_t i = 0; i < n; i++) {
+            TsetlinSampleKey key{e, (uint32_t)i};
+            TSparseBitset<bits> s{idx[i].data(), idx[i].size()};
+            bool a = plain->forward_backward(x[i], y[i], key);
+            train_ok &= cached->forward_backward(x[i], y[i], key) == a &&
+                        sparse->forward_backward(s, y[i], key) == a;
+        }
+        double rate = (cached->stats() - before).cache_hit_rate();
+        (e ? last_rate : first_rate) = rate;
+    }
+    train_ok &= same(*plain, *cached) && same(*plain, *sparse);
+
+    auto multi = std::unique_ptr<MultiClassTsetlinMachine<3, CacheConfig>>(
+        new MultiClassTsetlinMachine<3, CacheConfig>(6));
+    auto multi_cached =
+        std::unique_ptr<MultiClassTsetlinMachine<3, CacheConfig>>(
+            new MultiClassTsetlinMachine<3, CacheConfig>(6));
+    multi_cached->enable_output_cache(n);
+    bool multi_ok = true;
+    for (uint32_t e = 0; e < 5; e++)
+        for (size_t i = 0; i < n; i++) {
+            TsetlinSampleKey key{e, (uint32_t)i};
+            multi_ok &= multi->forward_backward(x[i], labels[i], key) ==
+                        multi_cached->forward_backward(x[i], labels[i], key);
+        }
+    for (size_t c = 0; c < 3; c++)
+        multi_ok &= same(multi->machine(c), multi_cached->machine(c));
+
+    // Writing the automata directly throws everything cached away.
+    auto* aut = cached->get_backing();
+    for (size_t i = 0; i < Machine::get_backing_size(); i += 7)
+        aut[i] = (char)~aut[i];
+    cached->recount_included();
+    bool invalidate_ok = true;
+    for (size_t i = 0; i < n; i++)
+        invalidate_ok &=
+            cached->votes(x[i], (uint32_t)i) == cached->votes(x[i]);
+
+    std::cout << "Cache hit rate, first epoch: " << first_rate
+              << ", last: " << last_rate << std::endl;
+    check("Training unchanged", train_ok);
+    check("Multi-class unchanged", multi_ok);
+    check("Invalidation", invalidate_ok);
+    check("Hits after the first epoch", first_rate == 0 && last_rate > .5);
+    return test_result();
+}
@@ -0,0 +1,64 @@
+#define TSETLIN_PERF 1
+
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TestCommon.h"
+
+using PerfConfig = TestConfig<64, 128, 16>;
+
+using Machine = TsetlinMachine<PerfConfig>;
+static constexpr size_t n = 256;
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .1);
+    auto m = std::unique_ptr<Machine>(new Machine(3));
+
+    // Many machines have no PMU to count with. Then there must be nothing
+    // counted, and a reason.
+    PerfReport before = perf_collect();
+    for (size_t i = 0; i < n; i++) m->forward_backward(x[i], y[i]);
+    PerfReport single = perf_collect() - before;
+
+    bool counted_ok;
+    if (single.available)
+        counted_ok = single.samples == n &&
+                     single.counts[PERF_FORWARD][PERF_INSTRUCTIONS] &&
+                     single.counts[PERF_BACKWARD][PERF_INSTRUCTIONS];
+    else
+        counted_ok = !single.samples && !single.why_unavailable.empty() &&
+                     !single.counts[PERF_FORWARD][PERF_CYCLES];
+
+    // Every 4th sample, and batches count each sample once over the threads.
+    perf_set_sample_every(4);
+    before = perf_collect();
+    for (size_t i = 0; i < n; i++) m->forward_backward(x[i], y[i]);
+    TThreadpool pool(3);
+    for (size_t i = 0; i < n; i += 16)
+        m->train_batch(&x[i], &y[i], 16, {1, (uint32_t)i}, pool);
+    PerfReport sampled = perf_collect() - before;
+    bool sampled_ok = !sampled.available ||
+                      sampled.samples == n / 4 + (n / 16 + 3) / 4 * 16;
+
+    // Threads that have exited still count.
+    PerfReport live = perf_collect();
+    std::thread([&] {
+        TSETLIN_PERF_BEGIN(PERF_FORWARD);
+        TSETLIN_PERF_END();
+    }).join();
+    bool retired_ok =
+        !live.available || perf_collect().samples == live.samples + 1;
+
+    std::cout << single.to_string() << std::endl;
+    check("Counted", counted_ok);
+    check("Sampled", sampled_ok);
+    check("Retired threads", retired_ok);
+    return test_result();
+}
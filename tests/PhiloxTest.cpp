@@ -0,0 +1,44 @@
+#include <cstdio>
+#include <iostream>
+
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+// Known answers from the Random123 distribution (kat_vectors).
+int
+main() {
+    struct {
+        uint32_t ctr[4], key[2], expected[4];
+    } kats[] = {
+        {{0, 0, 0, 0}, {0, 0}, {0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8}},
+        {{0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+         {0xffffffff, 0xffffffff},
+         {0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}},
+        {{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344},
+         {0xa4093822, 0x299f31d0},
+         {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}},
+    };
+
+    bool ok = true;
+    for (auto& kat : kats) {
+        uint32_t res[4];
+        TsetlinCounterRandGen::philox4x32_10(kat.ctr, kat.key, res);
+        for (size_t i = 0; i < 4; i++) ok &= res[i] == kat.expected[i];
+        printf("%08x %08x %08x %08x\n", res[0], res[1], res[2], res[3]);
+    }
+    check("Known answers", ok);
+
+    // The stream for a key must not depend on anything drawn before.
+    TsetlinCounterRandGen a(42, 3, 1000, 7), b(42, 3, 1000, 7),
+        c(42, 3, 1000, 8);
+    bool same = true, differs = false;
+    for (size_t i = 0; i < 1000; i++) {
+        uint64_t x = a.rand_64();
+        same &= x == b.rand_64();
+        differs |= x != c.rand_64();
+    }
+    check("Same key, same stream", same);
+    check("Other clause, other stream", differs);
+
+    return test_result();
+}
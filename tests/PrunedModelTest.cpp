@@ -0,0 +1,136 @@
+// Ties go to the first class here, where the default sends them to the last.
+#ifndef ARGMAX_TIEBREAK
+#define ARGMAX_TIEBREAK AM_FIRST
+#endif
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../machines/CompactModel.h"
+#include "../machines/MultiClassTsetlinMachine.h"
+#include "../machines/PrunedModel.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/Binarizer.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+using PruneConfig = TestConfig<200, 100>;
+
+using Machine = TsetlinMachine<PruneConfig>;
+static constexpr size_t n = 400, bits = PruneConfig::input_bits;
+
+int
+main() {
+    // Pixels through a binarizer, so the binarizer's bits can be checked too.
+    // 100 features at 2 levels.
+    TsetlinRandGen rg(11);
+    std::vector<uint8_t> pixels(n * 100);
+    for (auto& p : pixels) p = (uint8_t)rg.rand_64();
+    auto bin = Binarizer<uint8_t>::thermometer(100, 2, 0, 255);
+    auto x = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    for (size_t i = 0; i < n; i++)
+        bin.transform_row(pixels.data() + i * 100, x[i].buf);
+    bool y[n];
+    unsigned char labels[n];
+    for (size_t i = 0; i < n; i++) {
+        y[i] = x[i][3] ^ x[i][140];
+        labels[i] = y[i] + x[i][77];
+    }
+
+    auto m = std::unique_ptr<Machine>(new Machine(1));
+    auto multi = std::unique_ptr<MultiClassTsetlinMachine<3, PruneConfig>>(
+        new MultiClassTsetlinMachine<3, PruneConfig>(2));
+    for (uint32_t e = 0; e < 5; e++)
+        for (size_t i = 0; i < n; i++) {
+            m->forward_backward(x[i], y[i], {e, (uint32_t)i});
+            multi->forward_backward(x[i], labels[i], {e, (uint32_t)i});
+        }
+
+    // Whatever the trained machines use, the predictions can't change.
+    CompactModel<PruneConfig> compact(*m);
+    PrunedModel<PruneConfig> pruned(compact);
+    std::unique_ptr<CompactModel<PruneConfig>> compact_multi[3];
+    const CompactModel<PruneConfig>* classes[3];
+    for (size_t c = 0; c < 3; c++) {
+        compact_multi[c].reset(
+            new CompactModel<PruneConfig>(multi->machine(c)));
+        classes[c] = compact_multi[c].get();
+    }
+    PrunedModel<PruneConfig> pruned_multi(classes, 3);
+    bool trained_ok = true;
+    for (size_t i = 0; i < n; i++) {
+        trained_ok &= pruned.predict(x[i]) == m->forward(x[i]);
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        // Not the machine's tie stream, so only as good a class.
+        trained_ok &=
+            multi->machine(pruned_multi.predict(x[i])).votes(x[i]) ==
+            multi->machine(multi->forward(x[i])).votes(x[i]);
+#else
+        trained_ok &= pruned_multi.predict(x[i]) == multi->forward(x[i]);
+#endif
+    }
+
+    // A machine whose classes are all the same machine ties on every input,
+    // and the pruned model has to break the ties the same way.
+    auto tied = std::unique_ptr<MultiClassTsetlinMachine<3, PruneConfig>>(
+        new MultiClassTsetlinMachine<3, PruneConfig>(4));
+    const CompactModel<PruneConfig>* same[3] = {&compact, &compact, &compact};
+    for (size_t c = 0; c < 3; c++) {
+        std::memcpy(tied->machine(c).get_backing(), m->get_backing(),
+                    Machine::get_backing_size() * sizeof(*m->get_backing()));
+        tied->machine(c).recount_included();
+    }
+    PrunedModel<PruneConfig> pruned_tied(same, 3);
+    bool ties_ok = true;
+    for (size_t i = 0; i < n; i++) {
+#if ARGMAX_TIEBREAK == AM_RANDOM
+        ties_ok &= pruned_tied.predict(x[i]) < 3;
+#else
+        size_t expected = ARGMAX_TIEBREAK == AM_FIRST ? 0 : 2;
+        ties_ok &= pruned_tied.predict(x[i]) == expected &&
+                   tied->forward(x[i]) == expected;
+#endif
+    }
+
+    // Binarizing only the used bits gives the same packed input.
+    bool binarize_ok = true;
+    std::vector<tint> a(pruned.input_words()), b(pruned.input_words());
+    for (size_t i = 0; i < n; i++) {
+        pruned.pack(x[i], a.data());
+        bin.transform_bits(pixels.data() + i * 100, pruned.used_bits().data(),
+                           pruned.used_bits().size(), b.data());
+        binarize_ok &= a == b;
+    }
+
+    // A machine that only ever looks at bits 5, 70 and 199 takes 3 bits. Bit
+    // 70 is only in positive clauses, so compaction can't cancel it out.
+    auto p = std::unique_ptr<Machine>(new Machine(3));
+    auto* aut = p->get_backing();
+    size_t per_clause = Machine::get_backing_size() / PruneConfig::num_clauses;
+    for (size_t c = 0; c < PruneConfig::num_clauses; c++) {
+        auto* cl = aut + c * per_clause;
+        for (size_t i = 0; i < per_clause; i++) cl[i] = -1;
+        bool positive = c < PruneConfig::num_clauses / 2;
+        cl[2 * (c % 2 || !positive ? 5 : 70) + c % 3 % 2] = 0;
+        if (c % 7 == 0) cl[2 * 199] = 0;
+    }
+    p->recount_included();
+    CompactModel<PruneConfig> compact_narrow(*p);
+    PrunedModel<PruneConfig> narrow(compact_narrow);
+    bool narrow_ok = narrow.used_bits() == std::vector<uint32_t>{5, 70, 199} &&
+                     narrow.input_words() == 1;
+    for (size_t i = 0; i < n; i++)
+        narrow_ok &= narrow.predict(x[i]) == p->forward(x[i]);
+
+    std::cout << "Trained model uses " << pruned.used_bits().size() << '/'
+              << bits << " bits, multi-class "
+              << pruned_multi.used_bits().size() << '/' << bits << std::endl;
+    check("Trained", trained_ok);
+    check("Ties", ties_ok);
+    check("Binarize used bits", binarize_ok);
+    check("Planted", narrow_ok);
+    return test_result();
+}
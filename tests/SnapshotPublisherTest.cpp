@@ -0,0 +1,86 @@
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "../machines/SnapshotPublisher.h"
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+using PublishConfig = TestConfig<64, 100>;
+
+using Machine = TsetlinMachine<PublishConfig>;
+static constexpr size_t n = 500, num_readers = 3, probes = 8;
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .05);
+    auto m = std::unique_ptr<Machine>(new Machine(4));
+
+    // What each published snapshot says about the probes.
+    std::vector<std::vector<int>> published;
+    auto record = [&] {
+        std::vector<int> v;
+        for (size_t p = 0; p < probes; p++) v.push_back(m->votes(x[p]));
+        published.push_back(v);
+    };
+    record();
+    SnapshotPublisher<PublishConfig> publisher(*m);
+
+    // Readers never see anything but a whole published snapshot, while the
+    // machine trains underneath them.
+    std::atomic<bool> done{false};
+    std::vector<std::vector<std::vector<int>>> seen(num_readers);
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < num_readers; r++)
+        readers.emplace_back([&, r] {
+            auto reader = publisher.reader();
+            while (!done.load(std::memory_order_relaxed)) {
+                std::vector<int> v;
+                reader.read([&](const TsetlinSnapshot<PublishConfig>& s) {
+                    for (size_t p = 0; p < probes; p++)
+                        v.push_back(s.votes(x[p]));
+                    return 0;
+                });
+                seen[r].push_back(v);
+            }
+        });
+
+    for (uint32_t e = 0; e < 4; e++)
+        for (size_t i = 0; i < n; i++) {
+            m->forward_backward(x[i], y[i], {e, (uint32_t)i});
+            if (i % 50 == 49) {
+                record();
+                publisher.publish(*m);
+            }
+        }
+    done = true;
+    for (auto& t : readers) t.join();
+
+    std::set<std::vector<int>> valid(published.begin(), published.end());
+    bool consistent_ok = true;
+    size_t reads = 0;
+    for (auto& r : seen)
+        for (auto& v : r) consistent_ok &= valid.count(v) > 0, reads++;
+
+    // With the readers gone, everything retired can be reused, and the
+    // steady state publishes without allocating a third snapshot.
+    publisher.publish(*m);
+    publisher.publish(*m);
+    bool reclaim_ok = publisher.num_retired() <= 1 &&
+                      publisher.num_published() == published.size() + 2;
+    auto reader = publisher.reader();
+    bool latest_ok = reader.votes(x[0]) == m->votes(x[0]) &&
+                     reader.forward(x[1]) == m->forward(x[1]);
+
+    std::cout << "Reads: " << reads << std::endl;
+    check("Readers see whole snapshots", consistent_ok);
+    check("Reclamation", reclaim_ok);
+    check("Latest published", latest_ok);
+    return test_result();
+}
@@ -0,0 +1,120 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SparseDataset.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+using SparseConfig = TestConfig<200, 20, 8>;
+
+using Machine = TsetlinMachine<SparseConfig>;
+static constexpr size_t bits = SparseConfig::input_bits;
+
+static bool
+parses() {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/tsetlin-svmlight-test-%d.txt",
+             (int)getpid());
+    FILE* fp = fopen(path, "w");
+    fputs("# header comment\n"
+          "+1 qid:3 3:1 1:0.5 7:0\n"
+          "\n"
+          "-1 200:2.5 2:1 # trailing comment\n"
+          "1.0\n",
+          fp);
+    fclose(fp);
+
+    auto all = load_svmlight<bits>(path);
+    bool ok = all.size() == 3 && all.nnz() == 4 && all.label(0) == 1 &&
+              all.label(1) == -1 && all.label(2) == 1;
+    auto r0 = all.row(0), r1 = all.row(1), r2 = all.row(2);
+    ok &= r0.nnz == 2 && r0.idx[0] == 0 && r0.idx[1] == 2;
+    ok &= r1.nnz == 2 && r1.idx[0] == 1 && r1.idx[1] == 199;
+    ok &= r2.nnz == 0;
+
+    // Reading two rows at a time gives the same rows.
+    SvmlightReader<bits> reader(path, false, 0, 2);
+    CSRDataset<bits> chunk;
+    size_t rows = 0;
+    while (reader.next_chunk(chunk)) {
+        for (size_t i = 0; i < chunk.size(); i++, rows++) {
+            auto a = chunk.row(i), b = all.row(rows);
+            ok &= a.nnz == b.nnz && chunk.label(i) == all.label(rows) &&
+                  !std::memcmp(a.idx, b.idx, a.nnz * sizeof(uint32_t));
+        }
+    }
+    ok &= rows == 3;
+
+    // Out of range features are errors.
+    fp = fopen(path, "w");
+    fputs("1 201:1\n", fp);
+    fclose(fp);
+    try {
+        load_svmlight<bits>(path);
+        ok = false;
+    } catch (const std::runtime_error&) {
+    }
+    unlink(path);
+    return ok;
+}
+
+int
+main() {
+    bool parse_ok = parses();
+
+    // A random sparse dataset, and the same thing dense.
+    static constexpr size_t n = 300;
+    TsetlinRandGen rg(1234);
+    CSRDataset<bits> ds;
+    auto dense = std::unique_ptr<TBitset<bits>[]>(new TBitset<bits>[n]);
+    for (size_t i = 0; i < n; i++) {
+        std::vector<uint32_t> idx;
+        for (uint32_t b = 0; b < bits; b++)
+            if (rg.rand_bernoulli(.05)) idx.push_back(b);
+        ds.add_row(idx.data(), idx.size(), i % 2);
+        ds.row(i).to_dense(dense[i]);
+    }
+
+    // Train one machine on each, both ways of drawing random numbers. They
+    // should stay identical.
+    auto dm = std::unique_ptr<Machine>(new Machine(42));
+    auto sm = std::unique_ptr<Machine>(new Machine(42));
+    bool same_outputs = true;
+    for (uint32_t epoch = 0; epoch < 4; epoch++) {
+        for (size_t i = 0; i < n; i++) {
+            bool label = ds.label(i);
+            if (epoch % 2)
+                same_outputs &= dm->forward_backward(dense[i], label) ==
+                                sm->forward_backward(ds.row(i), label);
+            else
+                same_outputs &=
+                    dm->forward_backward(dense[i], label, {epoch, (uint32_t)i}) ==
+                    sm->forward_backward(ds.row(i), label, {epoch, (uint32_t)i});
+        }
+    }
+    bool same_model =
+        !std::memcmp(dm->get_backing(), sm->get_backing(),
+                     Machine::get_backing_size() * sizeof(char));
+
+    // Sparse and dense clause evaluation agree clause by clause.
+    bool same_clauses = true;
+    for (size_t i = 0; i < n; i++) {
+        TBitset<SparseConfig::num_clauses> a, b;
+        sm->clauses_forward(dense[i], a);
+        sm->clauses_forward(ds.row(i), b);
+        for (size_t c = 0; c < SparseConfig::num_clauses; c++)
+            same_clauses &= a[c] == b[c];
+    }
+
+    check("svmlight parsing", parse_ok);
+    check("Same outputs while training", same_outputs);
+    check("Same model after training", same_model);
+    check("Sparse clause evaluation", same_clauses);
+    return test_result();
+}
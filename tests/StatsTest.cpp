@@ -0,0 +1,79 @@
+#define TSETLIN_STATS 1
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TestCommon.h"
+
+using StatsConfig = TestConfig<64, 100>;
+
+using Machine = TsetlinMachine<StatsConfig>;
+static constexpr size_t n = 640;
+
+static TsetlinStats
+train(size_t threads, const TBitset<64>* x, const bool* y) {
+    auto m = std::unique_ptr<Machine>(new Machine(3));
+    TThreadpool pool(threads);
+    for (uint32_t e = 0; e < 3; e++)
+        for (size_t i = 0; i < n; i += 32)
+            m->train_batch(x + i, y + i, 32, {e, (uint32_t)i}, pool);
+    return m->stats();
+}
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .1);
+
+    // Counts are merged over threads, so they can't depend on how many.
+    TsetlinStats one = train(1, x.get(), y), four = train(4, x.get(), y);
+    bool merged = true;
+    for (auto c : TsetlinStats::counters) merged &= one.*c == four.*c;
+
+    uint64_t evals = 3 * n * StatsConfig::num_clauses;
+    bool consistent = one.samples == 3 * n && one.clause_evals == evals &&
+                      one.t1_sampled + one.t2_sampled == evals &&
+                      one.t1_applied <= one.t1_sampled &&
+                      one.t2_applied <= one.t2_sampled &&
+                      one.clause_fires <= evals && one.include_flips > 0 &&
+                      one.zero_feedback <= one.saturated_sums;
+
+    // Deltas between snapshots.
+    auto m = std::unique_ptr<Machine>(new Machine(3));
+    TsetlinStats before = m->stats();
+    for (size_t i = 0; i < 10; i++) m->forward_backward(x[i], y[i]);
+    TsetlinStats delta = m->stats() - before;
+    m->reset_stats();
+    bool snapshots = delta.samples == 10 && m->stats().samples == 0;
+
+    // Many short lived threads, more than there are slots at once. Slots
+    // are reused after a thread exits, and the overflow ones share one
+    // without losing counts.
+    TsetlinStatsCounters counters;
+    for (int wave = 0; wave < 4; wave++) {
+        std::atomic<int> ready{0};
+        std::vector<std::thread> threads;
+        for (int t = 0; t < 100; t++)
+            threads.emplace_back([&] {
+                ready++;
+                while (ready < 100) std::this_thread::yield();
+                for (int i = 0; i < 100000; i++)
+                    counters.add(TsetlinStatsCounters::SAMPLES, 1);
+            });
+        for (auto& t : threads) t.join();
+    }
+    bool no_lost_counts = counters.read().samples == 4 * 100 * 100000;
+
+    check("Merged over threads", merged);
+    check("Consistent counts", consistent);
+    check("Snapshots", snapshots);
+    check("No lost counts", no_lost_counts);
+    return test_result();
+}
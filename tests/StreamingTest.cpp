@@ -0,0 +1,128 @@
+#include <dirent.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "../utils/StreamingDataset.h"
+#include "../utils/TsetlinRand.h"
+#include "TestCommon.h"
+
+static constexpr size_t rows = 4, cols = 5, bits = rows * cols;
+static constexpr size_t n = 1000;
+
+static size_t
+open_fds() {
+    size_t count = 0;
+    DIR* dir = opendir("/proc/self/fd");
+    while (readdir(dir)) count++;
+    closedir(dir);
+    return count;
+}
+
+static void
+write_be32(FILE* fp, uint32_t x) {
+    unsigned char b[4] = {(unsigned char)(x >> 24), (unsigned char)(x >> 16),
+                          (unsigned char)(x >> 8), (unsigned char)x};
+    fwrite(b, 1, 4, fp);
+}
+
+// Every sample has to come out exactly once per epoch, binarized the same
+// way BinaryMNIST does it, and the block order has to change between epochs.
+int
+main() {
+    char img_path[64], label_path[64];
+    snprintf(img_path, sizeof(img_path), "/tmp/tsetlin-stream-%d.idx3",
+             (int)getpid());
+    snprintf(label_path, sizeof(label_path), "/tmp/tsetlin-stream-%d.idx1",
+             (int)getpid());
+
+    TsetlinRandGen rg;
+    std::vector<unsigned char> pixels(n * bits), labels(n);
+    for (auto& p : pixels) p = rg.rand_64();
+    for (auto& l : labels) l = rg.rand_64() % 10;
+
+    FILE* fp = fopen(img_path, "wb");
+    write_be32(fp, 0x803), write_be32(fp, n), write_be32(fp, rows);
+    write_be32(fp, cols);
+    fwrite(pixels.data(), 1, pixels.size(), fp);
+    fclose(fp);
+    fp = fopen(label_path, "wb");
+    write_be32(fp, 0x801), write_be32(fp, n);
+    fwrite(labels.data(), 1, labels.size(), fp);
+    fclose(fp);
+
+    bool ok = true;
+    std::vector<size_t> first_blocks;
+    {
+        StreamingIDXDataset<bits> ds(img_path, label_path, .3, 64, true);
+        for (size_t epoch = 0; epoch < 3; epoch++) {
+            std::vector<int> seen(n, 0);
+            SampleChunk<bits> chunk;
+            ds.begin_epoch(epoch);
+            bool first = true;
+            while (ds.next_chunk(chunk)) {
+                if (first) first_blocks.push_back(chunk.first_index);
+                first = false;
+                for (size_t j = 0; j < chunk.size; j++) {
+                    size_t i = chunk.first_index + j;
+                    seen[i]++;
+                    ok &= chunk.labels[j] == labels[i];
+                    for (size_t b = 0; b < bits; b++)
+                        ok &= chunk.samples[j][b] ==
+                              (pixels[i * bits + b] > 255 * .3);
+                }
+            }
+            for (int s : seen) ok &= s == 1;
+        }
+        // Stop halfway through an epoch, the loader has to shut down cleanly.
+        SampleChunk<bits> chunk;
+        ds.begin_epoch(3);
+        ds.next_chunk(chunk);
+    }
+
+    // Empty blocks would never get through an epoch.
+    try {
+        StreamingIDXDataset<bits> ds(img_path, label_path, .3, 0);
+        ok = false;
+    } catch (const std::invalid_argument&) {
+    }
+    try {
+        InMemoryStream<bits> mem(NULL, NULL, n, 0);
+        ok = false;
+    } catch (const std::invalid_argument&) {
+    }
+
+    // A label file one short of the images, the constructor throws after
+    // both files are open and mustn't keep them.
+    char short_path[64];
+    snprintf(short_path, sizeof(short_path), "/tmp/tsetlin-stream-%d.short",
+             (int)getpid());
+    fp = fopen(short_path, "wb");
+    write_be32(fp, 0x801), write_be32(fp, n - 1);
+    fwrite(labels.data(), 1, n - 1, fp);
+    fclose(fp);
+    size_t fds_before = open_fds();
+    bool threw = true;
+    for (int i = 0; i < 100; i++) {
+        try {
+            StreamingIDXDataset<bits> ds(img_path, short_path);
+            threw = false;
+        } catch (const std::runtime_error&) {
+        }
+    }
+    size_t fds_after = open_fds();
+    unlink(short_path);
+    unlink(img_path);
+    unlink(label_path);
+
+    bool shuffled = first_blocks[0] != first_blocks[1] ||
+                    first_blocks[1] != first_blocks[2];
+    check("Every sample once, binarized", ok);
+    check("Block order changes", shuffled);
+    check("Mismatched pair rejected", threw);
+    check("No fds leaked", fds_after == fds_before);
+    return test_result();
+}
@@ -0,0 +1,37 @@
+#ifndef TEST_COMMON_INCLUDE
+#define TEST_COMMON_INCLUDE
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// The machine the tests train, in whatever shape the test needs.
+template <size_t bits, size_t clauses, size_t target = 10>
+class TestConfig {
+   public:
+    static constexpr size_t input_bits = bits;
+    static constexpr size_t num_clauses = clauses;
+    static constexpr size_t summation_target = target;
+    static constexpr float S = 3.9;
+    static char TsetlinAutomaton;
+    static constexpr size_t num_states = 256;
+};
+
+inline bool test_failed = false;
+
+// Prints "what: OK" or "what: MISMATCH". Any mismatch fails the test, see
+// test_result().
+static inline bool
+check(const std::string& what, bool ok) {
+    std::cout << what << ": " << (ok ? "OK" : "MISMATCH") << std::endl;
+    test_failed |= !ok;
+    return ok;
+}
+
+// What main() returns.
+static inline int
+test_result() {
+    return test_failed ? 1 : 0;
+}
+
+#endif  // TEST_COMMON_INCLUDE
@@ -0,0 +1,91 @@
+#define TSETLIN_TRACE 1
+
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "../machines/TsetlinMachine.h"
+#include "../utils/SyntheticData.h"
+#include "../utils/TsetlinThreadpool.h"
+#include "TestCommon.h"
+
+using TraceConfig = TestConfig<64, 128, 16>;
+
+using Machine = TsetlinMachine<TraceConfig>;
+static constexpr size_t n = 64;
+
+static size_t
+occurrences(const std::string& s, const std::string& what) {
+    size_t count = 0;
+    for (size_t at = s.find(what); at != std::string::npos;
+         at = s.find(what, at + 1))
+        count++;
+    return count;
+}
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<64>[]>(new TBitset<64>[n]);
+    bool y[n];
+    synth_noisy_xor(x.get(), y, n, .1);
+    auto m = std::unique_ptr<Machine>(new Machine(3));
+
+    TSETLIN_TRACE_THREAD_NAME("trainer \"main\"");
+    trace_set_sample_every(8);
+    {
+        TSETLIN_TRACE_SPAN("epoch", 0);
+        for (size_t i = 0; i < n; i++) m->forward_backward(x[i], y[i]);
+        TThreadpool pool(3);
+        for (size_t i = 0; i < n; i += 16)
+            m->train_batch(&x[i], &y[i], 16, {0, (uint32_t)i}, pool);
+    }
+
+    // Threads that come and go one after another, like the per-epoch
+    // loader, reuse one buffer. Their events are kept, each on its own track.
+    auto buffers_allocated = [] {
+        TraceRegistry& r = trace_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        return r.buffers.size() + r.spare.size();
+    };
+    size_t allocated_before = buffers_allocated();
+    for (int t = 0; t < 10; t++)
+        std::thread([t] {
+            TSETLIN_TRACE_THREAD_NAME("short lived " + std::to_string(t));
+            TSETLIN_TRACE_SPAN("short span", t);
+        }).join();
+    bool recycled = buffers_allocated() <= allocated_before + 1;
+
+    const char* path = "/tmp/tsetlin_trace_test.json";
+    uint64_t dropped = trace_write_json(path);
+    std::ifstream in(path);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string json = ss.str();
+
+    // Every 8th sample, each split into three phases.
+    bool sampled_ok = occurrences(json, "\"name\":\"sample\"") == n / 8 &&
+                      occurrences(json, "\"name\":\"backward\"") == n / 8;
+    // Batch work on every pool thread, which are named after they exit.
+    bool batch_ok =
+        occurrences(json, "\"name\":\"batch\"") == n / 16 &&
+        occurrences(json, "\"name\":\"batch forward\"") == 3 * n / 16 &&
+        occurrences(json, "pool worker 2") == 1 &&
+        occurrences(json, "\"name\":\"pool barrier\"") >= n / 8;
+    bool json_ok =
+        !json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0) &&
+        json.find("trainer \\\"main\\\"") != std::string::npos &&
+        json.find("\"args\":{\"n\":16}") != std::string::npos &&
+        json.substr(json.size() - 4) == "\n]}\n" && !dropped;
+
+    recycled &= occurrences(json, "\"name\":\"short span\"") == 10 &&
+                occurrences(json, "short lived 9") == 1;
+
+    check("Sampled phases", sampled_ok);
+    check("Batch and pool spans", batch_ok);
+    check("Trace JSON", json_ok);
+    check("Buffers recycled", recycled);
+    return test_result();
+}
@@ -0,0 +1,125 @@
+#include <condition_variable>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "../machines/Trainer.h"
+#include "../machines/TsetlinMachine.h"
+#include "../machines/TsetlinSnapshot.h"
+#include "../utils/StreamingDataset.h"
+#include "../utils/SyntheticData.h"
+#include "TestCommon.h"
+
+// 70 input bits, not a multiple of 64.
+using TrainerConfig = TestConfig<70, 100>;
+
+using Machine = TsetlinMachine<TrainerConfig>;
+static constexpr size_t n = 600, n_valid = 200, epochs = 4;
+
+int
+main() {
+    auto x = std::unique_ptr<TBitset<70>[]>(new TBitset<70>[n + n_valid]);
+    bool y[n + n_valid];
+    unsigned char labels[n + n_valid];
+    synth_noisy_xor(x.get(), y, n + n_valid, .05);
+    for (size_t i = 0; i < n + n_valid; i++) labels[i] = y[i];
+    auto as_bool = [](unsigned char l) { return l != 0; };
+
+    // Reference: the same training, validated synchronously.
+    auto ref = std::unique_ptr<Machine>(new Machine(9));
+    TThreadpool pool(2);
+    std::vector<EvalResult> expected;
+    bool snapshot_ok = true;
+    for (uint32_t e = 0; e < epochs; e++) {
+        for (size_t i = 0; i < n; i++)
+            ref->forward_backward(x[i], y[i], {e, (uint32_t)i});
+        expected.push_back(ref->evaluate(x.get() + n, y + n, n_valid, pool));
+
+        // A snapshot predicts what the machine does, vote for vote.
+        TsetlinSnapshot<TrainerConfig> snap(*ref);
+        for (size_t i = 0; i < n + n_valid; i++)
+            snapshot_ok &= snap.votes(x[i]) == ref->votes(x[i]) &&
+                           snap.forward(x[i]) == ref->forward(x[i]);
+    }
+
+    // Pipelined. Validation of epoch e runs while epoch e + 1 trains.
+    auto m = std::unique_ptr<Machine>(new Machine(9));
+    InMemoryStream<70> train(x.get(), labels, n, 128);
+    InMemoryStream<70> valid(x.get() + n, labels + n, n_valid);
+    std::vector<SnapshotEval> got;
+    {
+        Trainer<TrainerConfig> trainer(
+            *m,
+            [&](const TsetlinSnapshot<TrainerConfig>& s, TThreadpool& p) {
+                return s.evaluate(valid, p, as_bool);
+            },
+            2);
+        SnapshotEval v;
+        for (size_t e = 0; e < epochs; e++) {
+            trainer.train_epoch(train, e, as_bool, [](size_t, size_t) {});
+            while (trainer.poll(v)) got.push_back(v);
+        }
+        while (trainer.wait_result(v)) got.push_back(v);
+    }
+    // Epochs may be skipped if validation falls behind, never the last.
+    bool pipelined_ok = !got.empty() && got.back().epoch == epochs - 1;
+    for (size_t i = 0; pipelined_ok && i < got.size(); i++)
+        pipelined_ok &= (!i || got[i].epoch > got[i - 1].epoch) &&
+                        got[i].result.confusion ==
+                            expected[got[i].epoch].confusion;
+
+    // A failed validation surfaces in the training thread.
+    bool error_ok = false;
+    {
+        Trainer<TrainerConfig> trainer(
+            *m, [](const TsetlinSnapshot<TrainerConfig>&, TThreadpool&)
+                    -> EvalResult { throw std::runtime_error("bad"); });
+        trainer.validate_snapshot(0);
+        SnapshotEval v;
+        try {
+            trainer.wait_result(v);
+        } catch (const std::runtime_error&) {
+            error_ok = true;
+        }
+    }
+
+    // While epoch 0 is being validated, later snapshots replace each other
+    // and only the newest is validated next.
+    std::vector<size_t> validated;
+    {
+        std::mutex gate;
+        std::condition_variable gate_cv;
+        bool started = false, release = false;
+        Trainer<TrainerConfig> trainer(
+            *m, [&](const TsetlinSnapshot<TrainerConfig>&, TThreadpool&) {
+                std::unique_lock<std::mutex> lock(gate);
+                started = true;
+                gate_cv.notify_all();
+                gate_cv.wait(lock, [&] { return release; });
+                return EvalResult();
+            });
+        trainer.validate_snapshot(0);
+        {
+            std::unique_lock<std::mutex> lock(gate);
+            gate_cv.wait(lock, [&] { return started; });
+        }
+        for (size_t e = 1; e < 4; e++) trainer.validate_snapshot(e);
+        validated.push_back(trainer.pending());
+        {
+            std::lock_guard<std::mutex> lock(gate);
+            release = true;
+        }
+        gate_cv.notify_all();
+        SnapshotEval v;
+        while (trainer.wait_result(v)) validated.push_back(v.epoch);
+    }
+    bool bounded_ok = validated == std::vector<size_t>{2, 0, 3};
+
+    check("Snapshot matches machine", snapshot_ok);
+    check("Pipelined validation", pipelined_ok);
+    check("Validation errors", error_ok);
+    check("Stale snapshots replaced", bounded_ok);
+    return test_result();
+}
@@ -0,0 +1,60 @@
+#include <unistd.h>
+
+#include <cstdio>
+#include <iostream>
+
+#include "../utils/TsetlinTransport.h"
+#include "TestCommon.h"
+
+static constexpr size_t workers = 4;
+static constexpr size_t len = 100000;  // Bigger than one shared memory slot
+
+// Every rank contributes rank + i at index i, so the sum at i is
+// (0 + 1 + ... + workers-1) + workers * i.
+template <TsetlinTransport Transport>
+static void
+exercise(Transport& t) {
+    std::vector<int64_t> buf(len);
+    for (size_t i = 0; i < len; i++) buf[i] = t.rank() + i;
+    t.allreduce_sum(buf.data(), len);
+
+    int64_t rank_sum = workers * (workers - 1) / 2;
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != rank_sum + (int64_t)(workers * i)) {
+            std::cout << "Rank " << t.rank() << ": allreduce mismatch at " << i
+                      << std::endl;
+            throw std::runtime_error("allreduce");
+        }
+    }
+
+    for (size_t i = 0; i < len; i++) buf[i] = t.rank() ? 0 : i * 3;
+    t.broadcast(buf.data(), len);
+    for (size_t i = 0; i < len; i++) {
+        if (buf[i] != (int64_t)(i * 3)) {
+            std::cout << "Rank " << t.rank() << ": broadcast mismatch at " << i
+                      << std::endl;
+            throw std::runtime_error("broadcast");
+        }
+    }
+    t.barrier();
+}
+
+int
+main() {
+    SharedMemoryGroup group(workers);
+    size_t shm_failed = launch_local_workers(workers, [&](size_t rank) {
+        SharedMemoryTransport t(group, rank);
+        exercise(t);
+    });
+    check("Shared memory", !shm_failed);
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/tsetlin-test-%d.sock", (int)getpid());
+    size_t uds_failed = launch_local_workers(workers, [&](size_t rank) {
+        UnixSocketTransport t(path, rank, workers);
+        exercise(t);
+    });
+    unlink(path);
+    check("Unix sockets", !uds_failed);
+    return test_result();
+}
@@ -1,8 +1,23 @@
 #ifndef BENCHMARKER_INCLUDE
 #define BENCHMARKER_INCLUDE
 
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
 
 #ifndef TIMER_DISABLE
 #define TIMER_DISABLE 0
@@ -42,4 +57,232 @@ example_usage() {
     TIMER_SHOW_MIN
 }
 
+///////////////////
+// Bench harness //
+///////////////////
+
+// Keeps the compiler from throwing away a result that's never used.
+template <typename T>
+static inline void
+bench_keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Timestamp counter ticks. On current x86 these tick at a constant rate, not
+// with the core clock, so bytes/cycle is per reference cycle. 0 elsewhere.
+static inline uint64_t
+bench_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+struct BenchResult {
+    std::string name;    // Kernel
+    std::string config;  // Shape it ran at
+    double bytes_per_op;
+    // Per rep, sorted.
+    std::vector<double> ns_per_op;
+    double ticks_per_op;  // Median, 0 if there's no tick counter
+
+    double
+    percentile(double p) const {
+        if (ns_per_op.empty()) return 0;
+        double pos = p / 100 * (ns_per_op.size() - 1);
+        size_t lo = (size_t)pos;
+        size_t hi = std::min(lo + 1, ns_per_op.size() - 1);
+        return ns_per_op[lo] + (pos - lo) * (ns_per_op[hi] - ns_per_op[lo]);
+    }
+
+    double
+    median() const {
+        return percentile(50);
+    }
+
+    double
+    bytes_per_cycle() const {
+        return ticks_per_op ? bytes_per_op / ticks_per_op : 0;
+    }
+
+    std::string
+    key() const {
+        return name + " " + config;
+    }
+};
+
+// Runs kernels a few times to warm up, then times a number of repetitions,
+// each long enough for the clock to be meaningful. Reports the distribution
+// of per-op times, not just one number, so noise is visible.
+class BenchSuite {
+    size_t warmup_reps, reps;
+    double min_rep_ns;
+    std::string filter;
+    std::vector<BenchResult> results;
+
+    using clock = std::chrono::steady_clock;
+
+    static std::string
+    json_escape(const std::string& s) {
+        std::string out;
+        for (char c : s) {
+            if (c == '"' || c == '\\') out += '\\';
+            out += c;
+        }
+        return out;
+    }
+
+    // Pulls "key": value out of one line of our own JSON output.
+    static bool
+    json_field(const std::string& line, const char* key, std::string& out) {
+        std::string k = std::string("\"") + key + "\": ";
+        size_t at = line.find(k);
+        if (at == std::string::npos) return false;
+        at += k.size();
+        if (line[at] == '"') {
+            size_t end = line.find('"', at + 1);
+            out = line.substr(at + 1, end - at - 1);
+        } else {
+            size_t end = line.find_first_of(",}", at);
+            out = line.substr(at, end - at);
+        }
+        return true;
+    }
+
+   public:
+    BenchSuite(size_t warmups = 3, size_t repetitions = 25,
+               double min_ns = 2e6)
+        : warmup_reps(warmups), reps(repetitions), min_rep_ns(min_ns) {
+        // The median and min of no reps are meaningless.
+        if (!reps) throw std::invalid_argument("A benchmark needs a rep.");
+    }
+
+    // Only run benchmarks whose "name config" contains this.
+    void
+    set_filter(const std::string& f) {
+        filter = f;
+    }
+
+    const std::vector<BenchResult>&
+    get_results() const noexcept {
+        return results;
+    }
+
+    // op() is one operation, moving bytes_per_op bytes of useful data.
+    template <typename Op>
+    void
+    run(const std::string& name, const std::string& config,
+        double bytes_per_op, Op&& op) {
+        BenchResult r{name, config, bytes_per_op, {}, 0};
+        if (!filter.empty() && r.key().find(filter) == std::string::npos)
+            return;
+
+        // Find how many ops make a rep last min_rep_ns.
+        size_t iters = 1;
+        for (;;) {
+            auto t0 = clock::now();
+            for (size_t i = 0; i < iters; i++) op();
+            double ns =
+                std::chrono::duration<double, std::nano>(clock::now() - t0)
+                    .count();
+            if (ns >= min_rep_ns || iters >= ((size_t)1 << 40)) break;
+            iters *= ns > 0 ? std::clamp<size_t>(min_rep_ns / ns * 1.2, 2, 100)
+                            : 100;
+        }
+
+        for (size_t w = 0; w < warmup_reps; w++)
+            for (size_t i = 0; i < iters; i++) op();
+
+        std::vector<double> ticks;
+        for (size_t rep = 0; rep < reps; rep++) {
+            uint64_t c0 = bench_ticks();
+            auto t0 = clock::now();
+            for (size_t i = 0; i < iters; i++) op();
+            auto t1 = clock::now();
+            uint64_t c1 = bench_ticks();
+            r.ns_per_op.push_back(
+                std::chrono::duration<double, std::nano>(t1 - t0).count() /
+                iters);
+            ticks.push_back((double)(c1 - c0) / iters);
+        }
+        std::sort(r.ns_per_op.begin(), r.ns_per_op.end());
+        std::sort(ticks.begin(), ticks.end());
+        r.ticks_per_op = ticks[ticks.size() / 2];
+
+        std::printf(
+            "%-28s %-26s %12.2f ns/op  (p10 %.2f, p90 %.2f)  %8.3f B/cycle\n",
+            r.name.c_str(), r.config.c_str(), r.median(), r.percentile(10),
+            r.percentile(90), r.bytes_per_cycle());
+        std::fflush(stdout);
+        results.push_back(std::move(r));
+    }
+
+    // One result per line, so that baselines can be read back with a grep.
+    std::string
+    to_json() const {
+        std::ostringstream os;
+        os << "{\"results\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            os << "  {\"name\": \"" << json_escape(r.name)
+               << "\", \"config\": \"" << json_escape(r.config)
+               << "\", \"median_ns\": " << r.median()
+               << ", \"p10_ns\": " << r.percentile(10)
+               << ", \"p90_ns\": " << r.percentile(90)
+               << ", \"p99_ns\": " << r.percentile(99)
+               << ", \"min_ns\": " << r.ns_per_op.front()
+               << ", \"bytes_per_op\": " << r.bytes_per_op
+               << ", \"bytes_per_cycle\": " << r.bytes_per_cycle()
+               << ", \"reps\": " << r.ns_per_op.size() << "}"
+               << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        os << "]}\n";
+        return os.str();
+    }
+
+    void
+    write_json(const char* path) const {
+        std::ofstream f(path);
+        f << to_json();
+        if (!f) throw std::runtime_error("Couldn't write " + std::string(path));
+    }
+
+    // Compares medians against a file written by write_json(). Anything
+    // slower by more than tolerance (a fraction) counts as a regression.
+    // Returns the number of regressions.
+    size_t
+    compare(const char* baseline_path, double tolerance = .05) const {
+        std::ifstream f(baseline_path);
+        if (!f)
+            throw std::runtime_error("Couldn't read baseline " +
+                                     std::string(baseline_path));
+
+        std::vector<std::pair<std::string, double>> base;
+        std::string line, name, config, median;
+        while (std::getline(f, line))
+            if (json_field(line, "name", name) &&
+                json_field(line, "config", config) &&
+                json_field(line, "median_ns", median))
+                base.push_back({name + " " + config, std::stod(median)});
+
+        size_t regressions = 0;
+        std::printf("\n%-56s %12s %12s %8s\n", "benchmark", "baseline",
+                    "now", "speedup");
+        for (const BenchResult& r : results) {
+            auto it = std::find_if(base.begin(), base.end(), [&](auto& b) {
+                return b.first == r.key();
+            });
+            if (it == base.end()) continue;
+            double speedup = it->second / r.median();
+            bool regressed = speedup < 1 / (1 + tolerance);
+            regressions += regressed;
+            std::printf("%-56s %12.2f %12.2f %7.3fx%s\n", r.key().c_str(),
+                        it->second, r.median(), speedup,
+                        regressed ? "  REGRESSION" : "");
+        }
+        return regressions;
+    }
+};
+
 #endif  // BENCHMARKER_INCLUDE
\ No newline at end of file
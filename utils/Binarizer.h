@@ -0,0 +1,394 @@
+#ifndef BINARIZER_INCLUDE
+#define BINARIZER_INCLUDE
+
+#include <immintrin.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "TsetlinBitset.h"
+#include "TsetlinThreadpool.h"
+
+//////////////////////////
+// Compare and pack     //
+//////////////////////////
+
+// Bit i of the result is x[i] > t[i], for 64 consecutive values. The
+// threshold is either one value for every lane, or an array of per lane
+// thresholds. One compare and movemask emits 32 (AVX2) or 64 (AVX-512BW)
+// bits for bytes, 8 or 16 for floats.
+
+template <typename T, typename Thr>
+static inline T
+gt_threshold_at(Thr t, size_t i) {
+    if constexpr (std::is_pointer_v<Thr>)
+        return t[i];
+    else
+        return t;
+}
+
+static inline tint
+gt_mask64(const uint8_t* x, uint8_t t) {
+#if defined(__AVX512BW__)
+    return _mm512_cmpgt_epu8_mask(_mm512_loadu_si512(x),
+                                  _mm512_set1_epi8((char)t));
+#elif defined(__AVX2__)
+    // No unsigned byte compare, so flip the sign bits of both sides.
+    const __m256i flip = _mm256_set1_epi8((char)0x80);
+    const __m256i thr = _mm256_set1_epi8((char)(t ^ 0x80));
+    __m256i lo = _mm256_loadu_si256((const __m256i*)x);
+    __m256i hi = _mm256_loadu_si256((const __m256i*)(x + 32));
+    uint32_t mlo = _mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(_mm256_xor_si256(lo, flip), thr));
+    uint32_t mhi = _mm256_movemask_epi8(
+        _mm256_cmpgt_epi8(_mm256_xor_si256(hi, flip), thr));
+    return (tint)mlo | ((tint)mhi << 32);
+#else
+    tint m = 0;
+    for (size_t i = 0; i < TINT_BIT_NUM; i++) m |= (tint)(x[i] > t) << i;
+    return m;
+#endif
+}
+
+static inline tint
+gt_mask64(const uint8_t* x, const uint8_t* t) {
+#if defined(__AVX512BW__)
+    return _mm512_cmpgt_epu8_mask(_mm512_loadu_si512(x),
+                                  _mm512_loadu_si512(t));
+#elif defined(__AVX2__)
+    const __m256i flip = _mm256_set1_epi8((char)0x80);
+    tint m = 0;
+    for (size_t h = 0; h < 64; h += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x + h));
+        __m256i thr = _mm256_loadu_si256((const __m256i*)(t + h));
+        uint32_t mh = _mm256_movemask_epi8(_mm256_cmpgt_epi8(
+            _mm256_xor_si256(v, flip), _mm256_xor_si256(thr, flip)));
+        m |= (tint)mh << h;
+    }
+    return m;
+#else
+    tint m = 0;
+    for (size_t i = 0; i < TINT_BIT_NUM; i++) m |= (tint)(x[i] > t[i]) << i;
+    return m;
+#endif
+}
+
+template <typename Thr>
+static inline tint
+gt_mask64(const float* x, Thr t) {
+    tint m = 0;
+#if defined(__AVX512F__)
+    for (size_t q = 0; q < 64; q += 16) {
+        __m512 thr;
+        if constexpr (std::is_pointer_v<Thr>)
+            thr = _mm512_loadu_ps(t + q);
+        else
+            thr = _mm512_set1_ps(t);
+        __mmask16 mq =
+            _mm512_cmp_ps_mask(_mm512_loadu_ps(x + q), thr, _CMP_GT_OQ);
+        m |= (tint)mq << q;
+    }
+#elif defined(__AVX2__)
+    for (size_t q = 0; q < 64; q += 8) {
+        __m256 thr;
+        if constexpr (std::is_pointer_v<Thr>)
+            thr = _mm256_loadu_ps(t + q);
+        else
+            thr = _mm256_set1_ps(t);
+        int mq = _mm256_movemask_ps(
+            _mm256_cmp_ps(_mm256_loadu_ps(x + q), thr, _CMP_GT_OQ));
+        m |= (tint)mq << q;
+    }
+#else
+    for (size_t i = 0; i < TINT_BIT_NUM; i++)
+        m |= (tint)(x[i] > gt_threshold_at<float>(t, i)) << i;
+#endif
+    return m;
+}
+
+// OR the low len bits of m into out, starting at bit out_bit.
+static inline void
+or_bits(tint* out, size_t out_bit, tint m) {
+    size_t w = out_bit / TINT_BIT_NUM, o = out_bit % TINT_BIT_NUM;
+    out[w] |= m << o;
+    if (o && (m >> (TINT_BIT_NUM - o))) out[w + 1] |= m >> (TINT_BIT_NUM - o);
+}
+
+// Sets bits [out_bit, out_bit + n) of out to x[i] > t. Bits are OR'd in, so
+// the output has to start out zeroed.
+template <typename T, typename Thr>
+static inline void
+pack_gt(const T* x, Thr t, size_t n, tint* out, size_t out_bit = 0) {
+    size_t i = 0;
+    for (; i + TINT_BIT_NUM <= n; i += TINT_BIT_NUM) {
+        if constexpr (std::is_pointer_v<Thr>)
+            or_bits(out, out_bit + i, gt_mask64(x + i, t + i));
+        else
+            or_bits(out, out_bit + i, gt_mask64(x + i, t));
+    }
+    tint m = 0;
+    for (size_t j = 0; i + j < n; j++)
+        m |= (tint)(x[i + j] > gt_threshold_at<T>(t, i + j)) << j;
+    if (i < n) or_bits(out, out_bit + i, m);
+}
+
+///////////////
+// Binarizer //
+///////////////
+
+// How each feature turns into bits. Bits are laid out level major: all the
+// features' level 0 bits, then all their level 1 bits, and so on, so each
+// level is one contiguous pack_gt.
+//
+// THRESHOLD:   1 bit, x > t.
+// THERMOMETER: levels bits, x > t_l, for levels evenly spaced thresholds.
+// QUANTILE:    Like THERMOMETER, but each feature gets its own thresholds,
+//              at its quantiles over a dataset (see fit()). Every bit is
+//              then set for about the same fraction of the dataset.
+// ADAPTIVE:    1 bit, x > mean(row) + offset. Follows the overall brightness
+//              of each image, for example.
+enum class Encoding { THRESHOLD, THERMOMETER, QUANTILE, ADAPTIVE };
+
+template <typename T>
+class Binarizer {
+    static_assert(std::is_same_v<T, uint8_t> || std::is_same_v<T, float>,
+                  "Binarizer supports uint8_t and float features.");
+
+    Encoding encoding;
+    size_t num_features, levels;
+    // One threshold per level, or levels x num_features for QUANTILE.
+    std::vector<T> thresholds;
+    T offset = 0;
+
+    Binarizer(Encoding enc, size_t feature_count, size_t level_count)
+        : encoding(enc), num_features(feature_count), levels(level_count) {
+        if (!num_features || !levels)
+            throw std::invalid_argument(
+                "Binarizer needs at least one feature and one level.");
+    }
+
+    T
+    row_mean(const T* x) const {
+        if constexpr (std::is_same_v<T, uint8_t>) {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < num_features; i++) sum += x[i];
+            return (T)(sum / num_features);
+        } else {
+            double sum = 0;
+            for (size_t i = 0; i < num_features; i++) sum += x[i];
+            return (T)(sum / num_features);
+        }
+    }
+
+    T
+    adaptive_threshold(const T* x) const {
+        T t = row_mean(x);
+        // Saturate instead of wrapping for bytes.
+        if constexpr (std::is_same_v<T, uint8_t>)
+            return (T)std::min<int>(255, std::max<int>(0, t + offset));
+        else
+            return t + offset;
+    }
+
+    // Per feature thresholds at the quantiles (l + 1) / (levels + 1). Bytes
+    // go through per thread histograms, floats are sorted per feature.
+    void
+    fit_quantiles(const T* rows, size_t num_rows, TThreadpool& pool) {
+        thresholds.assign(levels * num_features, 0);
+        auto rank = [&](size_t l) {
+            return (size_t)((num_rows - 1) * (double)(l + 1) / (levels + 1));
+        };
+
+        if constexpr (std::is_same_v<T, uint8_t>) {
+            std::vector<std::vector<uint32_t>> hists(pool.size());
+            pool.parallel_for(num_rows, [&](size_t begin, size_t end,
+                                            size_t t) {
+                std::vector<uint32_t>& h = hists[t];
+                h.assign(num_features * 256, 0);
+                for (size_t r = begin; r < end; r++) {
+                    const uint8_t* x = rows + r * num_features;
+                    for (size_t f = 0; f < num_features; f++)
+                        h[f * 256 + x[f]]++;
+                }
+            });
+            pool.parallel_for(num_features, [&](size_t begin, size_t end,
+                                                size_t) {
+                for (size_t f = begin; f < end; f++) {
+                    size_t cum = 0, l = 0;
+                    for (size_t v = 0; v < 256 && l < levels; v++) {
+                        for (auto& h : hists)
+                            if (!h.empty()) cum += h[f * 256 + v];
+                        while (l < levels && cum > rank(l))
+                            thresholds[l++ * num_features + f] = (uint8_t)v;
+                    }
+                }
+            });
+        } else {
+            pool.parallel_for(num_features, [&](size_t begin, size_t end,
+                                                size_t) {
+                std::vector<T> column(num_rows);
+                for (size_t f = begin; f < end; f++) {
+                    for (size_t r = 0; r < num_rows; r++)
+                        column[r] = rows[r * num_features + f];
+                    for (size_t l = 0; l < levels; l++) {
+                        std::nth_element(column.begin(),
+                                         column.begin() + rank(l),
+                                         column.end());
+                        thresholds[l * num_features + f] = column[rank(l)];
+                    }
+                }
+            });
+        }
+    }
+
+   public:
+    static Binarizer
+    threshold(size_t num_features, T t) {
+        Binarizer b(Encoding::THRESHOLD, num_features, 1);
+        b.thresholds = {t};
+        return b;
+    }
+
+    // Thresholds evenly spaced strictly between lo and hi.
+    static Binarizer
+    thermometer(size_t num_features, size_t levels, T lo, T hi) {
+        Binarizer b(Encoding::THERMOMETER, num_features, levels);
+        for (size_t l = 0; l < levels; l++)
+            b.thresholds.push_back(
+                (T)(lo + (double)(hi - lo) * (l + 1) / (levels + 1)));
+        return b;
+    }
+
+    // Needs fit() before use.
+    static Binarizer
+    quantile(size_t num_features, size_t levels) {
+        return Binarizer(Encoding::QUANTILE, num_features, levels);
+    }
+
+    static Binarizer
+    adaptive(size_t num_features, T offset = 0) {
+        Binarizer b(Encoding::ADAPTIVE, num_features, 1);
+        b.offset = offset;
+        return b;
+    }
+
+    size_t
+    output_bits() const noexcept {
+        return levels * num_features;
+    }
+
+    size_t
+    output_words() const noexcept {
+        return (output_bits() + TINT_BIT_NUM - 1) / TINT_BIT_NUM;
+    }
+
+    // Rows are num_features values each, back to back. Only QUANTILE has
+    // anything to learn.
+    void
+    fit(const T* rows, size_t num_rows, TThreadpool& pool) {
+        if (encoding != Encoding::QUANTILE) return;
+        if (!num_rows)
+            throw std::invalid_argument("Can't fit quantiles to no rows.");
+        fit_quantiles(rows, num_rows, pool);
+    }
+
+    // Writes all output_words() words of out.
+    void
+    transform_row(const T* x, tint* out) const {
+        std::memset(out, 0, output_words() * sizeof(tint));
+        switch (encoding) {
+            case Encoding::THRESHOLD:
+            case Encoding::THERMOMETER:
+                for (size_t l = 0; l < levels; l++)
+                    pack_gt(x, thresholds[l], num_features, out,
+                            l * num_features);
+                break;
+            case Encoding::QUANTILE:
+                if (thresholds.empty())
+                    throw std::logic_error("Quantile binarizer wasn't fit.");
+                for (size_t l = 0; l < levels; l++)
+                    pack_gt(x, thresholds.data() + l * num_features,
+                            num_features, out, l * num_features);
+                break;
+            case Encoding::ADAPTIVE:
+                pack_gt(x, adaptive_threshold(x), num_features, out);
+                break;
+        }
+    }
+
+    // Only some of the output bits: bit j of out is output bit bits[j]. For
+    // models that only look at some of their inputs (see PrunedModel), so
+    // the rest never get computed. Writes all (n + 63) / 64 words of out.
+    void
+    transform_bits(const T* x, const uint32_t* bits, size_t n,
+                   tint* out) const {
+        size_t words = (n + TINT_BIT_NUM - 1) / TINT_BIT_NUM;
+        std::memset(out, 0, words * sizeof(tint));
+        if (encoding == Encoding::QUANTILE && thresholds.empty())
+            throw std::logic_error("Quantile binarizer wasn't fit.");
+        T adaptive = encoding == Encoding::ADAPTIVE ? adaptive_threshold(x) : 0;
+        for (size_t j = 0; j < n; j++) {
+            if (bits[j] >= output_bits())
+                throw std::out_of_range("Binarizer has no bit " +
+                                        std::to_string(bits[j]) + ".");
+            size_t l = bits[j] / num_features, f = bits[j] % num_features;
+            T t = encoding == Encoding::ADAPTIVE   ? adaptive
+                  : encoding == Encoding::QUANTILE ? thresholds[bits[j]]
+                                                   : thresholds[l];
+            out[j / TINT_BIT_NUM] |= (tint)(x[f] > t) << (j % TINT_BIT_NUM);
+        }
+    }
+
+    // Binarizes num_rows row major rows into out, split across the pool.
+    template <size_t bits>
+    void
+    transform(const T* rows, size_t num_rows, TBitset<bits>* out,
+              TThreadpool& pool) const {
+        check_width(bits);
+        pool.parallel_for(num_rows, [&](size_t begin, size_t end, size_t) {
+            for (size_t r = begin; r < end; r++)
+                transform_row(rows + r * num_features, out[r].buf);
+        });
+    }
+
+    // Same, for column major (tabular) data: columns[f][r] is feature f of
+    // row r. Blocks of rows are transposed into a scratch buffer first, so
+    // the row kernel can still compare contiguous values.
+    template <size_t bits>
+    void
+    transform_columns(const T* const* columns, size_t num_rows,
+                      TBitset<bits>* out, TThreadpool& pool) const {
+        static constexpr size_t block = 64;
+        check_width(bits);
+        size_t num_blocks = (num_rows + block - 1) / block;
+        pool.parallel_for(num_blocks, [&](size_t begin, size_t end, size_t) {
+            std::vector<T> scratch(block * num_features);
+            for (size_t b = begin; b < end; b++) {
+                size_t first = b * block;
+                size_t n = std::min(block, num_rows - first);
+                for (size_t f = 0; f < num_features; f++)
+                    for (size_t r = 0; r < n; r++)
+                        scratch[r * num_features + f] = columns[f][first + r];
+                for (size_t r = 0; r < n; r++)
+                    transform_row(scratch.data() + r * num_features,
+                                  out[first + r].buf);
+            }
+        });
+    }
+
+    void
+    check_width(size_t bits) const {
+        if (bits != output_bits())
+            throw std::invalid_argument(
+                "Binarizer produces " + std::to_string(output_bits()) +
+                " bits, but the bitsets hold " + std::to_string(bits) + ".");
+    }
+};
+
+#endif  // BINARIZER_INCLUDE
@@ -0,0 +1,222 @@
+#ifndef BINARY_DATASET_CACHE_INCLUDE
+#define BINARY_DATASET_CACHE_INCLUDE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "TsetlinBitset.h"
+
+// On disk format for datasets that have already been binarized.
+//
+// [header, padded to a page]
+// [num_samples rows of sizeof(TBitset<num_bits>) bytes, page aligned]
+// [num_samples uint8 labels]
+//
+// Rows are stored exactly as TBitset lays them out in memory, so the mapped
+// file can be used as an array of TBitsets with no conversion. The key is a
+// hash of whatever produced the data (source files, binarization
+// parameters); a cache with the wrong key is stale and gets rebuilt.
+
+static constexpr char binary_cache_magic[8] = {'T', 'B', 'I', 'N',
+                                               'D', 'S', '\0', '\1'};
+static constexpr size_t binary_cache_align = 4096;
+
+struct BinaryCacheHeader {
+    char magic[8];
+    uint64_t key;
+    uint64_t num_bits;
+    uint64_t row_bytes;
+    uint64_t num_samples;
+    uint64_t rows_offset;
+    uint64_t labels_offset;
+    uint64_t file_size;
+};
+
+static inline uint64_t
+binary_cache_round_up(uint64_t x) {
+    return (x + binary_cache_align - 1) & ~(uint64_t)(binary_cache_align - 1);
+}
+
+// FNV-1a. Only used to tell caches apart, so nothing fancier is needed.
+static inline uint64_t
+binary_cache_hash(const void* data, size_t len,
+                  uint64_t h = 0xcbf29ce484222325) {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3;
+    }
+    return h;
+}
+
+// Hash a source file's identity (path, size and modification time) into h,
+// so that replacing the source invalidates the cache.
+static inline uint64_t
+binary_cache_hash_file(const char* path, uint64_t h) {
+    struct stat st;
+    if (::stat(path, &st) == -1)
+        throw std::runtime_error("Couldn't stat dataset source " +
+                                 std::string(path) + ": " +
+                                 std::strerror(errno));
+    int64_t id[3] = {(int64_t)st.st_size, (int64_t)st.st_mtim.tv_sec,
+                     (int64_t)st.st_mtim.tv_nsec};
+    h = binary_cache_hash(path, std::strlen(path), h);
+    return binary_cache_hash(id, sizeof(id), h);
+}
+
+// Where caches go when the caller doesn't say: $XDG_CACHE_HOME/tsetlin, or
+// ./cache without it. Never next to the source data, which may be checked in.
+// Creates the folder and any missing parents.
+static inline std::string
+binary_cache_default_folder() {
+    const char* xdg = std::getenv("XDG_CACHE_HOME");
+    std::string folder =
+        xdg && *xdg ? std::string(xdg) + "/tsetlin" : std::string("cache");
+    for (size_t i = 1; i <= folder.size(); i++) {
+        if (i < folder.size() && folder[i] != '/') continue;
+        std::string prefix = folder.substr(0, i);
+        if (::mkdir(prefix.c_str(), 0755) == -1 && errno != EEXIST)
+            throw std::runtime_error("Couldn't create cache folder " + prefix +
+                                     ": " + std::strerror(errno));
+    }
+    return folder;
+}
+
+// Writes to a temporary file and renames it into place, so a reader never
+// sees a half written cache.
+template <size_t num_bits>
+static inline void
+write_binary_cache(const char* path, uint64_t key,
+                   const TBitset<num_bits>* rows, const unsigned char* labels,
+                   size_t num_samples) {
+    BinaryCacheHeader h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, binary_cache_magic, sizeof(h.magic));
+    h.key = key;
+    h.num_bits = num_bits;
+    h.row_bytes = sizeof(TBitset<num_bits>);
+    h.num_samples = num_samples;
+    h.rows_offset = binary_cache_round_up(sizeof(h));
+    h.labels_offset = h.rows_offset + h.row_bytes * num_samples;
+    h.file_size = h.labels_offset + num_samples;
+
+    std::string tmp = std::string(path) + ".tmp";
+    FILE* fp = std::fopen(tmp.c_str(), "wb");
+    if (!fp)
+        throw std::runtime_error("Couldn't create " + tmp + ": " +
+                                 std::strerror(errno));
+
+    static const char zeros[binary_cache_align] = {};
+    bool ok = std::fwrite(&h, sizeof(h), 1, fp) == 1 &&
+              std::fwrite(zeros, h.rows_offset - sizeof(h), 1, fp) == 1 &&
+              std::fwrite(rows, h.row_bytes, num_samples, fp) == num_samples &&
+              std::fwrite(labels, 1, num_samples, fp) == num_samples;
+    ok &= std::fclose(fp) == 0;
+    if (!ok || std::rename(tmp.c_str(), path) == -1) {
+        std::remove(tmp.c_str());
+        throw std::runtime_error("Couldn't write binary dataset cache " +
+                                 std::string(path) + ".");
+    }
+}
+
+// A read only view of a cache file. Every process mapping the same file
+// shares the same page cache pages, and nothing is read until it's touched.
+template <size_t num_bits>
+class MappedBinaryDataset {
+    void* map = MAP_FAILED;
+    size_t map_size = 0;
+    const TBitset<num_bits>* rows = NULL;
+    const unsigned char* labels = NULL;
+    size_t num_samples = 0;
+
+   public:
+    // Returns false if the file is missing, malformed, or was built with a
+    // different key. Throws only if the file exists but can't be mapped.
+    bool
+    open(const char* path, uint64_t key) {
+        close();
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1) return false;
+
+        struct stat st;
+        BinaryCacheHeader h;
+        bool valid =
+            ::fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(h) &&
+            ::pread(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+            !std::memcmp(h.magic, binary_cache_magic, sizeof(h.magic)) &&
+            h.key == key && h.num_bits == num_bits &&
+            h.row_bytes == sizeof(TBitset<num_bits>) &&
+            h.file_size == (uint64_t)st.st_size &&
+            h.rows_offset % binary_cache_align == 0 &&
+            h.labels_offset == h.rows_offset + h.row_bytes * h.num_samples &&
+            h.file_size == h.labels_offset + h.num_samples;
+        if (!valid) {
+            ::close(fd);
+            return false;
+        }
+
+        map = ::mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        int err = errno;
+        ::close(fd);
+        if (map == MAP_FAILED)
+            throw std::runtime_error("Couldn't map " + std::string(path) +
+                                     ": " + std::strerror(err));
+        map_size = st.st_size;
+        rows = (const TBitset<num_bits>*)((const char*)map + h.rows_offset);
+        labels = (const unsigned char*)map + h.labels_offset;
+        num_samples = h.num_samples;
+        return true;
+    }
+
+    void
+    close() {
+        if (map != MAP_FAILED) ::munmap(map, map_size);
+        map = MAP_FAILED;
+        rows = NULL;
+        labels = NULL;
+        num_samples = 0;
+    }
+
+    MappedBinaryDataset() = default;
+    MappedBinaryDataset(const MappedBinaryDataset&) = delete;
+    MappedBinaryDataset& operator=(const MappedBinaryDataset&) = delete;
+    ~MappedBinaryDataset() { close(); }
+
+    size_t
+    size() const noexcept {
+        return num_samples;
+    }
+
+    const TBitset<num_bits>&
+    sample(size_t i) const noexcept {
+        return rows[i];
+    }
+
+    const TBitset<num_bits>*
+    samples() const noexcept {
+        return rows;
+    }
+
+    unsigned char
+    label(size_t i) const noexcept {
+        return labels[i];
+    }
+
+    const unsigned char*
+    all_labels() const noexcept {
+        return labels;
+    }
+};
+
+#endif  // BINARY_DATASET_CACHE_INCLUDE
@@ -1,49 +1,74 @@
+#ifndef BINARY_MNIST_INCLUDE
+#define BINARY_MNIST_INCLUDE
+
 extern "C" {
-#include "MNIST-dataloader-for-C/mnist.h"
+#include "MNIST-dataloader-for-C/mnist.h"  // MNIST_IMG_SIZE
 }
 
+#include "BinaryDatasetCache.h"
+#include "Binarizer.h"
+#include "IDXReader.h"
 #include "TsetlinBitset.h"
+#include "TsetlinThreadpool.h"
 
 // For convernience in creating a unique_ptr of this class
 #include <memory>
+#include <string>
+#include <vector>
+
+// Opens one of the four MNIST files and checks it holds count items of
+// item_shape uint8s. Works just as well for EMNIST, KMNIST, and Fashion-MNIST,
+// which use the same file names and layout.
+static inline std::unique_ptr<IDXFile>
+open_mnist_idx(const char* data_folder, const char* name, size_t count,
+               std::vector<size_t> item_shape) {
+    std::string path = data_folder;
+    if (!path.empty() && path.back() != '/') path += '/';
+    path += name;
+    auto f = std::unique_ptr<IDXFile>(new IDXFile(path.c_str()));
+    f->expect(IDXType::U8, item_shape, path);
+    if (f->count() != count)
+        throw std::runtime_error(path + " has " + std::to_string(f->count()) +
+                                 " items, expected " + std::to_string(count) +
+                                 ".");
+    return f;
+}
 
 struct BinaryMNIST {
     static constexpr size_t num_train = 60000;
     static constexpr size_t num_test = 10000;
     TBitset<MNIST_IMG_SIZE> train_60k[num_train];
     TBitset<MNIST_IMG_SIZE> test_10k[num_test];
-    unsigned char* label_60k;
-    unsigned char* label_10k;
+    // Labels are used straight out of the mapped files.
+    std::unique_ptr<IDXFile> train_labels, test_labels;
+    const unsigned char* label_60k;
+    const unsigned char* label_10k;
 
     BinaryMNIST(char data_folder[], float threshold = .3)
         : train_60k(), test_10k() {
-        // Load the original dataset.
-        MNIST mnist;
-        MNIST_load(&mnist, data_folder);
-
-        // Convert and store the images
-        auto convert = [&](unsigned char* img, TBitset<MNIST_IMG_SIZE>* bref) {
-            for (size_t j = 0; j < MNIST_IMG_SIZE; j++)
-                (*bref)[j] = (img[j] > (255 * threshold));
-        };
-        for (size_t i = 0; i < num_train; i++)
-            convert(MNIST_train_img(&mnist, i), this->train_60k + i);
-        for (size_t i = 0; i < num_test; i++)
-            convert(MNIST_test_img(&mnist, i), this->test_10k + i);
-
-        // Yoink the label references and prevent them from being freed by
-        // setting them to null, we just yoinked them.
-        this->label_60k = mnist.label_60k;
-        this->label_10k = mnist.label_10k;
-        mnist.label_60k = NULL;
-        mnist.label_10k = NULL;
-
-        // Free the original dataset.
-        MNIST_destroy(&mnist);
-    }
-    ~BinaryMNIST() {
-        free(label_60k);
-        free(label_10k);
+        // Map the original dataset. The images are only read while they're
+        // binarized, and unmapped right after.
+        auto train_images = open_mnist_idx(data_folder, "train-images.idx3-ubyte",
+                                           num_train, {28, 28});
+        auto test_images = open_mnist_idx(data_folder, "t10k-images.idx3-ubyte",
+                                          num_test, {28, 28});
+        train_labels = open_mnist_idx(data_folder, "train-labels.idx1-ubyte",
+                                      num_train, {});
+        test_labels = open_mnist_idx(data_folder, "t10k-labels.idx1-ubyte",
+                                     num_test, {});
+
+        // Convert and store the images. Pixels are integers, so comparing
+        // against the floor of the threshold is the same test.
+        TThreadpool pool;
+        auto binarizer = Binarizer<uint8_t>::threshold(
+            MNIST_IMG_SIZE, (uint8_t)(255 * threshold));
+        binarizer.transform(train_images->data(), num_train, this->train_60k,
+                            pool);
+        binarizer.transform(test_images->data(), num_test, this->test_10k,
+                            pool);
+
+        this->label_60k = train_labels->data();
+        this->label_10k = test_labels->data();
     }
 
     TBitset<MNIST_IMG_SIZE>&
@@ -62,4 +87,83 @@ struct BinaryMNIST {
     test_label(size_t i) {
         return label_10k[i];
     }
-};
\ No newline at end of file
+};
+
+// Same interface as BinaryMNIST, but the images come out of a binarized cache
+// that's mapped read only. The cache is built from the IDX files the first
+// time, and rebuilt whenever they change or the threshold does. Without a
+// cache_folder it goes in binary_cache_default_folder().
+struct CachedBinaryMNIST {
+    static constexpr size_t num_train = BinaryMNIST::num_train;
+    static constexpr size_t num_test = BinaryMNIST::num_test;
+    MappedBinaryDataset<MNIST_IMG_SIZE> train_set;
+    MappedBinaryDataset<MNIST_IMG_SIZE> test_set;
+
+    CachedBinaryMNIST(char data_folder[], const char* cache_folder = NULL,
+                      float threshold = .3) {
+        auto join = [](const char* folder, const std::string& name) {
+            std::string path = folder;
+            if (!path.empty() && path.back() != '/') path += '/';
+            return path + name;
+        };
+        std::string default_folder;
+        if (!cache_folder) {
+            default_folder = binary_cache_default_folder();
+            cache_folder = default_folder.c_str();
+        }
+
+        // Bump the version whenever the binarization itself changes.
+        static constexpr uint64_t version = 1;
+        uint64_t key = binary_cache_hash(&version, sizeof(version));
+        key = binary_cache_hash(&threshold, sizeof(threshold), key);
+        const char* sources[] = {
+            "train-images.idx3-ubyte", "train-labels.idx1-ubyte",
+            "t10k-images.idx3-ubyte", "t10k-labels.idx1-ubyte"};
+        for (const char* src : sources)
+            key = binary_cache_hash_file(join(data_folder, src).c_str(), key);
+
+        char suffix[32];
+        snprintf(suffix, sizeof(suffix), "-%016llx.tbin",
+                 (unsigned long long)key);
+        std::string train_path =
+            join(cache_folder, "mnist-train" + std::string(suffix));
+        std::string test_path =
+            join(cache_folder, "mnist-test" + std::string(suffix));
+
+        if (train_set.open(train_path.c_str(), key) &&
+            test_set.open(test_path.c_str(), key))
+            return;
+
+        // Miss. Do the slow load once and write it out.
+        {
+            auto bmnist = std::unique_ptr<BinaryMNIST>(
+                new BinaryMNIST(data_folder, threshold));
+            write_binary_cache(train_path.c_str(), key, bmnist->train_60k,
+                               bmnist->label_60k, num_train);
+            write_binary_cache(test_path.c_str(), key, bmnist->test_10k,
+                               bmnist->label_10k, num_test);
+        }
+        if (!train_set.open(train_path.c_str(), key) ||
+            !test_set.open(test_path.c_str(), key))
+            throw std::runtime_error("Couldn't read back the MNIST cache.");
+    }
+
+    const TBitset<MNIST_IMG_SIZE>&
+    train(size_t i) const {
+        return train_set.sample(i);
+    }
+    const TBitset<MNIST_IMG_SIZE>&
+    test(size_t i) const {
+        return test_set.sample(i);
+    }
+    unsigned char
+    train_label(size_t i) const {
+        return train_set.label(i);
+    }
+    unsigned char
+    test_label(size_t i) const {
+        return test_set.label(i);
+    }
+};
+
+#endif  // BINARY_MNIST_INCLUDE
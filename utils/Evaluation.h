@@ -0,0 +1,175 @@
+#ifndef EVALUATION_INCLUDE
+#define EVALUATION_INCLUDE
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SampleStream.h"
+#include "TsetlinThreadpool.h"
+
+// How a classifier did on a dataset. confusion[actual * num_classes +
+// predicted] counts the samples of class actual that were predicted as
+// class predicted.
+struct EvalResult {
+    size_t num_classes = 0;
+    std::vector<size_t> confusion;
+    double seconds = 0;
+
+    EvalResult(size_t classes = 0)
+        : num_classes(classes), confusion(classes * classes) {}
+
+    size_t
+    count(size_t actual, size_t predicted) const noexcept {
+        return confusion[actual * num_classes + predicted];
+    }
+
+    EvalResult&
+    operator+=(const EvalResult& o) {
+        if (o.num_classes != num_classes)
+            throw std::invalid_argument("Evaluations of different shapes.");
+        for (size_t i = 0; i < confusion.size(); i++)
+            confusion[i] += o.confusion[i];
+        seconds += o.seconds;
+        return *this;
+    }
+
+    size_t
+    samples() const noexcept {
+        size_t n = 0;
+        for (size_t c : confusion) n += c;
+        return n;
+    }
+    size_t
+    correct() const noexcept {
+        size_t n = 0;
+        for (size_t c = 0; c < num_classes; c++) n += count(c, c);
+        return n;
+    }
+    // Samples of class c.
+    size_t
+    support(size_t c) const noexcept {
+        size_t n = 0;
+        for (size_t p = 0; p < num_classes; p++) n += count(c, p);
+        return n;
+    }
+    // Samples predicted as class c.
+    size_t
+    predicted(size_t c) const noexcept {
+        size_t n = 0;
+        for (size_t a = 0; a < num_classes; a++) n += count(a, c);
+        return n;
+    }
+
+    static double
+    ratio(double a, double b) noexcept {
+        return b ? a / b : 0;
+    }
+
+    double
+    accuracy() const noexcept {
+        return ratio(correct(), samples());
+    }
+    double
+    precision(size_t c) const noexcept {
+        return ratio(count(c, c), predicted(c));
+    }
+    double
+    recall(size_t c) const noexcept {
+        return ratio(count(c, c), support(c));
+    }
+    double
+    f1(size_t c) const noexcept {
+        return ratio(2 * precision(c) * recall(c), precision(c) + recall(c));
+    }
+    double
+    samples_per_sec() const noexcept {
+        return ratio(samples(), seconds);
+    }
+
+    std::string
+    to_string() const {
+        std::string s;
+        char line[128];
+        snprintf(line, sizeof(line),
+                 "Accuracy: %zu/%zu (%.2f%%), %.1f samples/sec\n", correct(),
+                 samples(), 100 * accuracy(), samples_per_sec());
+        s += line;
+
+        // Rows are the actual class, columns the predicted one.
+        s += "Confusion:";
+        for (size_t p = 0; p < num_classes; p++) {
+            snprintf(line, sizeof(line), " %7zu", p);
+            s += line;
+        }
+        for (size_t a = 0; a < num_classes; a++) {
+            snprintf(line, sizeof(line), "\n%10zu", a);
+            s += line;
+            for (size_t p = 0; p < num_classes; p++) {
+                snprintf(line, sizeof(line), " %7zu", count(a, p));
+                s += line;
+            }
+        }
+        s += "\nClass  precision  recall      f1  support";
+        for (size_t c = 0; c < num_classes; c++) {
+            snprintf(line, sizeof(line), "\n%5zu  %9.4f  %6.4f  %6.4f  %7zu",
+                     c, precision(c), recall(c), f1(c), support(c));
+            s += line;
+        }
+        return s;
+    }
+};
+
+// Evaluates samples [0, n) split across the pool's threads. predict(j) and
+// actual(j) give sample j's predicted and true class. Each thread counts
+// into its own confusion matrix, and they're added up at the end.
+template <typename Predict, typename Actual>
+static inline EvalResult
+evaluate_range(size_t num_classes, size_t n, TThreadpool& pool,
+               Predict&& predict, Actual&& actual) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<EvalResult> partial(pool.size(), EvalResult(num_classes));
+    pool.parallel_for(n, [&](size_t begin, size_t end, size_t t) {
+        size_t* confusion = partial[t].confusion.data();
+        for (size_t j = begin; j < end; j++) {
+            size_t a = actual(j);
+            if (a >= num_classes)
+                throw std::out_of_range("Class " + std::to_string(a) +
+                                        " out of range.");
+            confusion[a * num_classes + predict(j)]++;
+        }
+    });
+
+    EvalResult result(num_classes);
+    for (const EvalResult& r : partial) result += r;
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return result;
+}
+
+// The same over one epoch of a stream, a chunk at a time. to_class maps a
+// label byte to a class. Timed including the stream's loading.
+template <size_t num_bits, typename Stream, typename Predict, typename ToClass>
+static inline EvalResult
+evaluate_stream(Stream& stream, size_t num_classes, TThreadpool& pool,
+                Predict&& predict, ToClass&& to_class) {
+    auto start = std::chrono::steady_clock::now();
+    EvalResult result(num_classes);
+    SampleChunk<num_bits> chunk;
+    stream.begin_epoch(0);
+    while (stream.next_chunk(chunk))
+        result += evaluate_range(
+            num_classes, chunk.size, pool,
+            [&](size_t j) -> size_t { return predict(chunk.samples[j]); },
+            [&](size_t j) -> size_t { return to_class(chunk.labels[j]); });
+    result.seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    return result;
+}
+
+#endif  // EVALUATION_INCLUDE
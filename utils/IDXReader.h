@@ -0,0 +1,216 @@
+#ifndef IDX_READER_INCLUDE
+#define IDX_READER_INCLUDE
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// IDX, the format MNIST, EMNIST, KMNIST and Fashion-MNIST ship in.
+// http://yann.lecun.com/exdb/mnist/ (bottom of the page)
+//
+// [0x00 0x00 dtype ndim] [ndim big endian uint32 dims] [data, big endian]
+
+enum class IDXType : uint8_t {
+    U8 = 0x08,
+    I8 = 0x09,
+    I16 = 0x0B,
+    I32 = 0x0C,
+    F32 = 0x0D,
+    F64 = 0x0E,
+};
+
+static inline size_t
+idx_type_size(IDXType t) {
+    switch (t) {
+        case IDXType::U8:
+        case IDXType::I8: return 1;
+        case IDXType::I16: return 2;
+        case IDXType::I32:
+        case IDXType::F32: return 4;
+        case IDXType::F64: return 8;
+    }
+    return 0;
+}
+
+struct IDXHeader {
+    IDXType dtype;
+    std::vector<size_t> shape;
+    size_t data_offset;  // Header length
+    size_t data_size;    // Bytes of data that should follow
+
+    // bytes holds at least the first min(file_size, 4 + 4 * 255) bytes of a
+    // file that's file_size bytes long. Throws unless it's a well formed IDX
+    // file whose data exactly fills the rest of the file.
+    static IDXHeader
+    parse(const unsigned char* bytes, size_t available, size_t file_size,
+          const std::string& name) {
+        auto fail = [&](const std::string& why) {
+            throw std::runtime_error("Bad IDX file " + name + ": " + why);
+        };
+        if (available < 4 || file_size < 4) fail("too short");
+        if (bytes[0] || bytes[1]) fail("bad magic number");
+
+        IDXHeader h;
+        h.dtype = (IDXType)bytes[2];
+        size_t elem = idx_type_size(h.dtype);
+        if (!elem) fail("unknown dtype " + std::to_string(bytes[2]));
+
+        size_t ndim = bytes[3];
+        if (!ndim) fail("no dimensions");
+        h.data_offset = 4 + 4 * ndim;
+        if (available < h.data_offset || file_size < h.data_offset)
+            fail("truncated header");
+
+        h.data_size = elem;
+        for (size_t d = 0; d < ndim; d++) {
+            const unsigned char* b = bytes + 4 + 4 * d;
+            size_t dim = ((size_t)b[0] << 24) | ((size_t)b[1] << 16) |
+                         ((size_t)b[2] << 8) | (size_t)b[3];
+            if (dim && h.data_size > SIZE_MAX / dim) fail("shape overflows");
+            h.data_size *= dim;
+            h.shape.push_back(dim);
+        }
+        if (file_size - h.data_offset != h.data_size)
+            fail("expected " + std::to_string(h.data_size) +
+                 " bytes of data, found " +
+                 std::to_string(file_size - h.data_offset));
+        return h;
+    }
+
+    // Number of items along the first dimension (images, labels, ...).
+    size_t
+    count() const noexcept {
+        return shape[0];
+    }
+
+    // Elements per item, the product of the other dimensions.
+    size_t
+    item_elems() const noexcept {
+        size_t n = 1;
+        for (size_t d = 1; d < shape.size(); d++) n *= shape[d];
+        return n;
+    }
+
+    size_t
+    item_bytes() const noexcept {
+        return item_elems() * idx_type_size(dtype);
+    }
+};
+
+// Maps an IDX file read only. The data is used in place: nothing is read
+// until it's touched, and every process that maps the same file shares the
+// same page cache pages.
+class IDXFile {
+    void* map = MAP_FAILED;
+    size_t map_size = 0;
+    IDXHeader h;
+
+    template <typename T>
+    static T
+    load_be(const unsigned char* p) noexcept {
+        unsigned char b[sizeof(T)];
+        for (size_t i = 0; i < sizeof(T); i++) b[i] = p[sizeof(T) - 1 - i];
+        T t;
+        std::memcpy(&t, b, sizeof(T));
+        return t;
+    }
+
+   public:
+    explicit IDXFile(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error("Couldn't open IDX file " +
+                                     std::string(path) + ": " +
+                                     std::strerror(errno));
+        struct stat st;
+        if (::fstat(fd, &st) == -1 || st.st_size == 0) {
+            ::close(fd);
+            throw std::runtime_error("Bad IDX file " + std::string(path) +
+                                     ": empty or unreadable");
+        }
+        map_size = st.st_size;
+        map = ::mmap(NULL, map_size, PROT_READ, MAP_SHARED, fd, 0);
+        int err = errno;
+        ::close(fd);
+        if (map == MAP_FAILED)
+            throw std::runtime_error("Couldn't map IDX file " +
+                                     std::string(path) + ": " +
+                                     std::strerror(err));
+        try {
+            h = IDXHeader::parse((const unsigned char*)map, map_size, map_size,
+                                 path);
+        } catch (...) {
+            ::munmap(map, map_size);
+            throw;
+        }
+    }
+
+    IDXFile(const IDXFile&) = delete;
+    IDXFile& operator=(const IDXFile&) = delete;
+    ~IDXFile() { ::munmap(map, map_size); }
+
+    const IDXHeader&
+    header() const noexcept {
+        return h;
+    }
+
+    IDXType
+    dtype() const noexcept {
+        return h.dtype;
+    }
+
+    const std::vector<size_t>&
+    shape() const noexcept {
+        return h.shape;
+    }
+
+    size_t
+    count() const noexcept {
+        return h.count();
+    }
+
+    // The raw (big endian) data, in place.
+    const unsigned char*
+    data() const noexcept {
+        return (const unsigned char*)map + h.data_offset;
+    }
+
+    // Item i, for example image i. Single byte dtypes can be used as is.
+    const unsigned char*
+    item(size_t i) const noexcept {
+        return data() + i * h.item_bytes();
+    }
+
+    // Throws unless the file holds items of exactly this dtype and shape
+    // (not counting the first dimension).
+    void
+    expect(IDXType dtype, std::vector<size_t> item_shape,
+           const std::string& name) const {
+        std::vector<size_t> got(h.shape.begin() + 1, h.shape.end());
+        if (h.dtype != dtype || got != item_shape)
+            throw std::runtime_error("IDX file " + name +
+                                     " doesn't have the expected dtype or "
+                                     "shape.");
+    }
+
+    // Element i of the flattened data, converted from big endian. Use this
+    // for the multi byte dtypes.
+    template <typename T>
+    T
+    at(size_t i) const {
+        if (sizeof(T) != idx_type_size(h.dtype))
+            throw std::invalid_argument("IDX element size mismatch.");
+        return load_be<T>(data() + i * sizeof(T));
+    }
+};
+
+#endif  // IDX_READER_INCLUDE
@@ -0,0 +1,99 @@
+#ifndef INFERENCE_PROTOCOL_INCLUDE
+#define INFERENCE_PROTOCOL_INCLUDE
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+// What the inference server and its clients say to each other over a Unix
+// stream socket. Both ends are the same machine, so everything is in native
+// byte order. A request is a header and then input_words words of the input
+// bitset. A response is a header and then num_votes vote sums, one per
+// class (one in all for a binary model). Responses on a connection come back
+// in the order the requests were sent.
+
+static constexpr uint32_t inference_magic = 0x54534d31;  // "TSM1"
+
+struct InferenceRequestHeader {
+    uint32_t magic;
+    uint32_t model;  // Index of the model on the server
+    uint64_t id;     // Echoed back in the response
+    uint64_t input_words;
+};
+
+enum InferenceStatus : uint32_t {
+    INFER_OK = 0,
+    INFER_BAD_MODEL = 1,  // No model with that index
+    INFER_BAD_SHAPE = 2,  // Input isn't the size the model takes
+};
+
+struct InferenceResponseHeader {
+    uint64_t id;
+    uint32_t status;
+    uint32_t predicted;  // Class, or 0/1 for a binary model
+    uint32_t num_votes;
+    uint32_t reserved;
+};
+
+static inline void
+inference_panic(const char* what) {
+    throw std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+static inline sockaddr_un
+inference_addr(const char* path) {
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (std::strlen(path) >= sizeof(addr.sun_path))
+        throw std::invalid_argument("Socket path too long: " +
+                                    std::string(path));
+    std::strcpy(addr.sun_path, path);
+    return addr;
+}
+
+// False if the peer has gone away.
+static inline bool
+inference_send_all(int fd, const void* buf, size_t len) {
+    const char* p = (const char*)buf;
+    while (len) {
+        ssize_t w = ::send(fd, p, len, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EPIPE || errno == ECONNRESET) return false;
+            inference_panic("inference send");
+        }
+        p += w;
+        len -= (size_t)w;
+    }
+    return true;
+}
+
+// False on a clean end of stream before the first byte.
+static inline bool
+inference_recv_all(int fd, void* buf, size_t len) {
+    char* p = (char*)buf;
+    size_t got = 0;
+    while (got < len) {
+        ssize_t r = ::recv(fd, p + got, len - got, 0);
+        if (r < 0) {
+            if (errno == EINTR) continue;
+            inference_panic("inference recv");
+        }
+        if (r == 0) {
+            if (!got) return false;
+            throw std::runtime_error("Inference peer closed mid-message.");
+        }
+        got += (size_t)r;
+    }
+    return true;
+}
+
+#endif  // INFERENCE_PROTOCOL_INCLUDE
@@ -0,0 +1,291 @@
+#ifndef METRICS_REPORTER_INCLUDE
+#define METRICS_REPORTER_INCLUDE
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// What one epoch did. Filled in by the trainer, rendered by the reporter.
+struct EpochMetrics {
+    size_t epoch = 0;
+    size_t train_accurate = 0, num_train = 0;
+    size_t valid_accurate = 0, num_valid = 0;
+    double train_seconds = 0, valid_seconds = 0;
+
+    double
+    train_accuracy() const noexcept {
+        return num_train ? (double)train_accurate / num_train : 0;
+    }
+    double
+    valid_accuracy() const noexcept {
+        return num_valid ? (double)valid_accurate / num_valid : 0;
+    }
+};
+
+struct MetricsOptions {
+    bool progress = true;             // Redraw a progress line on stdout
+    bool epochs = true;               // Print epoch summaries on stdout
+    double interval = .25;            // Seconds between progress redraws
+    const char* csv_path = nullptr;   // One row per epoch
+    const char* json_path = nullptr;  // One object per line per epoch
+};
+
+// Progress and epoch reporting off the training thread. The trainer only
+// ever stores to memory: progress is the latest value of two counters, and
+// everything else (phases, epoch summaries, text) goes through a single
+// producer ring. A background thread renders the progress line at a fixed
+// rate, prints what comes through the ring, and appends epochs to optional
+// CSV and JSON lines logs. If the ring is full, records are dropped and
+// counted rather than making the trainer wait.
+//
+// Only one thread may produce.
+class MetricsReporter {
+    enum class Kind : uint8_t { PHASE, EPOCH, TEXT };
+
+    struct Record {
+        Kind kind = Kind::TEXT;
+        const char* phase = nullptr;  // PHASE only
+        size_t total = 0;             // PHASE only
+        EpochMetrics epoch;
+        std::string text;
+    };
+
+    static constexpr size_t ring_size = 256;  // Power of two
+    Record ring[ring_size];
+    alignas(64) std::atomic<size_t> head{0};  // Written by the trainer
+    alignas(64) std::atomic<size_t> tail{0};  // Written by the reporter
+
+    alignas(64) std::atomic<size_t> seen{0};
+    std::atomic<size_t> accurate{0};
+    std::atomic<uint64_t> dropped{0};
+
+    MetricsOptions options;
+    FILE* csv = nullptr;
+    FILE* json = nullptr;
+
+    // Reporter thread state.
+    const char* phase = nullptr;
+    size_t phase_total = 0;
+    bool line_drawn = false;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool stopping = false;
+    size_t flush_requests = 0, flushes_done = 0;
+    std::thread thread;
+
+    bool
+    push(Record&& r) noexcept {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) == ring_size) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ring[h % ring_size] = std::move(r);
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    void
+    erase_line() {
+        if (line_drawn) std::printf("\r\33[2K");
+        line_drawn = false;
+    }
+
+    void
+    draw_progress() {
+        if (!options.progress || !phase) return;
+        size_t s = seen.load(std::memory_order_relaxed);
+        size_t a = accurate.load(std::memory_order_relaxed);
+        std::printf(
+            "\r%s epoch progress: %zu/%zu, epoch accuracy: %zu/%zu, (%.2f%%)",
+            phase, s, phase_total, a, s, s ? 100.0 * a / s : 0.0);
+        line_drawn = true;
+    }
+
+    void
+    print_epoch(const EpochMetrics& m) {
+        if (options.epochs && m.num_valid) {
+            erase_line();
+            std::printf(
+                "=============================\nFinished epoch %zu."
+                "\nTrain Accuracy: %zu/%zu (%g%%)"
+                "\nValid Accuracy: %zu/%zu (%g%%)"
+                "\nTrain time: %.2f seconds.\nValid time: %.2f seconds."
+                "\nTotal time: %.2f seconds.\n\n",
+                m.epoch, m.train_accurate, m.num_train,
+                100 * m.train_accuracy(), m.valid_accurate, m.num_valid,
+                100 * m.valid_accuracy(), m.train_seconds, m.valid_seconds,
+                m.train_seconds + m.valid_seconds);
+        } else if (options.epochs) {
+            // Validated elsewhere, e.g. by a Trainer.
+            erase_line();
+            std::printf(
+                "=============================\nFinished epoch %zu."
+                "\nTrain Accuracy: %zu/%zu (%g%%)"
+                "\nTrain time: %.2f seconds.\n\n",
+                m.epoch, m.train_accurate, m.num_train,
+                100 * m.train_accuracy(), m.train_seconds);
+        }
+        double train_sps = m.train_seconds ? m.num_train / m.train_seconds : 0;
+        double valid_sps = m.valid_seconds ? m.num_valid / m.valid_seconds : 0;
+        if (csv)
+            std::fprintf(csv, "%zu,%.6f,%.6f,%.3f,%.3f,%.1f,%.1f\n", m.epoch,
+                         m.train_accuracy(), m.valid_accuracy(),
+                         m.train_seconds, m.valid_seconds, train_sps,
+                         valid_sps);
+        if (json)
+            std::fprintf(json,
+                         "{\"epoch\": %zu, \"train_accuracy\": %.6f, "
+                         "\"valid_accuracy\": %.6f, \"train_seconds\": %.3f, "
+                         "\"valid_seconds\": %.3f, \"train_samples_per_sec\": "
+                         "%.1f, \"valid_samples_per_sec\": %.1f}\n",
+                         m.epoch, m.train_accuracy(), m.valid_accuracy(),
+                         m.train_seconds, m.valid_seconds, train_sps,
+                         valid_sps);
+    }
+
+    void
+    drain() {
+        size_t h = head.load(std::memory_order_acquire);
+        for (size_t t = tail.load(std::memory_order_relaxed); t != h; t++) {
+            Record& r = ring[t % ring_size];
+            if (r.kind == Kind::PHASE) {
+                erase_line();
+                phase = r.phase;
+                phase_total = r.total;
+            } else if (r.kind == Kind::EPOCH) {
+                print_epoch(r.epoch);
+            } else {
+                erase_line();
+                std::printf("%s\n", r.text.c_str());
+            }
+            r.text.clear();
+            tail.store(t + 1, std::memory_order_release);
+        }
+    }
+
+    void
+    run() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            bool stop = stopping;
+            size_t flush_to = flush_requests;
+            lock.unlock();
+
+            drain();
+            if (!stop) draw_progress();
+            std::fflush(stdout);
+            if (csv) std::fflush(csv);
+            if (json) std::fflush(json);
+
+            lock.lock();
+            flushes_done = flush_to;
+            cv.notify_all();
+            if (stop) return;
+            cv.wait_for(lock, std::chrono::duration<double>(options.interval),
+                        [&] { return stopping || flush_requests != flush_to; });
+        }
+    }
+
+    static FILE*
+    open_log(const char* path, const char* csv_header) {
+        if (!path) return nullptr;
+        FILE* f = std::fopen(path, "w");
+        if (!f) throw std::runtime_error("Couldn't open " + std::string(path));
+        if (csv_header) std::fputs(csv_header, f);
+        return f;
+    }
+
+   public:
+    MetricsReporter(MetricsOptions opts = MetricsOptions()) : options(opts) {
+        csv = open_log(options.csv_path,
+                       "epoch,train_accuracy,valid_accuracy,train_seconds,"
+                       "valid_seconds,train_samples_per_sec,"
+                       "valid_samples_per_sec\n");
+        try {
+            json = open_log(options.json_path, nullptr);
+        } catch (...) {
+            if (csv) std::fclose(csv);
+            throw;
+        }
+        thread = std::thread([this] { run(); });
+    }
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    // Prints everything still in the ring first.
+    ~MetricsReporter() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        cv.notify_all();
+        thread.join();
+        erase_line();
+        std::fflush(stdout);
+        if (csv) std::fclose(csv);
+        if (json) std::fclose(json);
+    }
+
+    // Starts a progress line, e.g. ("Train", 60000). name must outlive the
+    // reporter, so a string literal.
+    void
+    begin_phase(const char* name, size_t total) noexcept {
+        Record r;
+        r.kind = Kind::PHASE;
+        r.phase = name;
+        r.total = total;
+        progress(0, 0);
+        push(std::move(r));
+    }
+
+    // Samples seen and predicted correctly so far in this phase. Two
+    // relaxed stores, cheap enough to call on every sample.
+    inline void
+    progress(size_t samples_seen, size_t samples_accurate) noexcept {
+        seen.store(samples_seen, std::memory_order_relaxed);
+        accurate.store(samples_accurate, std::memory_order_relaxed);
+    }
+
+    void
+    epoch(const EpochMetrics& m) {
+        Record r;
+        r.kind = Kind::EPOCH;
+        r.epoch = m;
+        push(std::move(r));
+    }
+
+    // A line to print between progress redraws, e.g. counters.
+    void
+    note(std::string text) {
+        Record r;
+        r.kind = Kind::TEXT;
+        r.text = std::move(text);
+        push(std::move(r));
+    }
+
+    // Waits until everything pushed so far has been printed and logged.
+    void
+    flush() {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t request = ++flush_requests;
+        cv.notify_all();
+        cv.wait(lock, [&] { return flushes_done >= request; });
+    }
+
+    uint64_t
+    num_dropped() const noexcept {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
+
+#endif  // METRICS_REPORTER_INCLUDE
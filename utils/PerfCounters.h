@@ -0,0 +1,363 @@
+#ifndef PERF_COUNTERS_INCLUDE
+#define PERF_COUNTERS_INCLUDE
+
+// Build with -DTSETLIN_PERF=1 to read the CPU's performance counters around
+// each phase of training. Otherwise the TSETLIN_PERF_* marks in the machine
+// compile to nothing. Needs perf_event_paranoid <= 2 (user space counting
+// only) and a PMU, which many VMs don't expose; without one every count
+// reads as zero and the report says why.
+#ifndef TSETLIN_PERF
+#define TSETLIN_PERF 0
+#endif
+
+#if TSETLIN_PERF
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if TSETLIN_PERF
+#define TSETLIN_PERF_BEGIN(...) perf_thread_recorder().begin(__VA_ARGS__)
+#define TSETLIN_PERF_END() perf_thread_recorder().end()
+#else
+#define TSETLIN_PERF_BEGIN(...)
+#define TSETLIN_PERF_END()
+#endif
+
+enum PerfPhase {
+    PERF_FORWARD,    // Clause evaluation
+    PERF_SUMMATION,  // Vote sum and threshold
+    PERF_BACKWARD,   // Feedback
+    PERF_NUM_PHASES
+};
+
+enum PerfEvent {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NUM_EVENTS
+};
+
+static constexpr const char* perf_phase_names[PERF_NUM_PHASES] = {
+    "forward", "summation", "backward"};
+static constexpr const char* perf_event_names[PERF_NUM_EVENTS] = {
+    "cycles",     "instructions", "L1D misses",
+    "LLC misses", "dTLB misses",  "branch misses"};
+
+// Counts per phase, summed over threads. Subtract two reports to get one
+// epoch.
+struct PerfReport {
+    uint64_t counts[PERF_NUM_PHASES][PERF_NUM_EVENTS] = {};
+    uint64_t samples = 0;  // Samples measured (see perf_set_sample_every)
+    bool available = false;
+    // The kernel had more events than counters and time shared them, so
+    // the counts are extrapolated from the time each was counting.
+    bool multiplexed = false;
+    std::string why_unavailable;
+
+    PerfReport
+    operator-(const PerfReport& o) const {
+        PerfReport d = *this;
+        for (size_t p = 0; p < PERF_NUM_PHASES; p++)
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++)
+                d.counts[p][e] -= o.counts[p][e];
+        d.samples -= o.samples;
+        return d;
+    }
+
+    std::string
+    to_string() const {
+        if (!available)
+            return "Perf counters unavailable: " + why_unavailable;
+
+        // Per measured sample, and IPC.
+        std::string s;
+        char line[256];
+        if (multiplexed)
+            s += "Counters were multiplexed, counts are scaled estimates.\n";
+        snprintf(line, sizeof(line), "%-10s %8s", "per sample", "IPC");
+        s += line;
+        for (size_t e = 0; e < PERF_NUM_EVENTS; e++) {
+            snprintf(line, sizeof(line), " %14s", perf_event_names[e]);
+            s += line;
+        }
+        for (size_t p = 0; p < PERF_NUM_PHASES; p++) {
+            const uint64_t* c = counts[p];
+            double ipc = c[PERF_CYCLES]
+                             ? (double)c[PERF_INSTRUCTIONS] / c[PERF_CYCLES]
+                             : 0;
+            snprintf(line, sizeof(line), "\n%-10s %8.3f", perf_phase_names[p],
+                     ipc);
+            s += line;
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++) {
+                snprintf(line, sizeof(line), " %14.1f",
+                         samples ? (double)c[e] / samples : 0.0);
+                s += line;
+            }
+        }
+        return s;
+    }
+};
+
+static std::atomic<size_t> perf_sample_every{1};
+
+// Only measure every nth sample, to bound the overhead. Each mark costs a
+// read() syscall, which is a lot next to a small machine's forward pass.
+static inline void
+perf_set_sample_every(size_t n) {
+    perf_sample_every.store(n ? n : 1, std::memory_order_relaxed);
+}
+
+#if TSETLIN_PERF
+
+// One thread's counters, opened as a group so they're all read at once.
+// Counters the CPU doesn't have are left out.
+class PerfCounterGroup {
+    int fds[PERF_NUM_EVENTS];
+    uint64_t ids[PERF_NUM_EVENTS];
+    std::string error;
+    bool was_multiplexed = false;
+
+    static int
+    open_event(uint32_t type, uint64_t config, int group_fd) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = group_fd == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+                           PERF_FORMAT_TOTAL_TIME_ENABLED |
+                           PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return (int)::syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    }
+
+    static constexpr uint64_t
+    cache_miss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+               (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+   public:
+    PerfCounterGroup() {
+        static constexpr struct {
+            uint32_t type;
+            uint64_t config;
+        } events[PERF_NUM_EVENTS] = {
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+            {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+            {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+            {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+            {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        };
+
+        for (size_t e = 0; e < PERF_NUM_EVENTS; e++) {
+            fds[e] = open_event(events[e].type, events[e].config,
+                                e ? fds[0] : -1);
+            if (e == 0 && fds[0] == -1) {
+                error = std::string("perf_event_open: ") + std::strerror(errno);
+                for (size_t i = 1; i < PERF_NUM_EVENTS; i++) fds[i] = -1;
+                return;
+            }
+            if (fds[e] != -1) ::ioctl(fds[e], PERF_EVENT_IOC_ID, &ids[e]);
+        }
+        ::ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ::ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    PerfCounterGroup(const PerfCounterGroup&) = delete;
+    PerfCounterGroup& operator=(const PerfCounterGroup&) = delete;
+
+    ~PerfCounterGroup() {
+        for (int fd : fds)
+            if (fd != -1) ::close(fd);
+    }
+
+    bool
+    available() const noexcept {
+        return fds[0] != -1;
+    }
+
+    const std::string&
+    why_unavailable() const noexcept {
+        return error;
+    }
+
+    // Whether any read so far found the group sharing the PMU with other
+    // events, see PerfReport::multiplexed.
+    bool
+    multiplexed() const noexcept {
+        return was_multiplexed;
+    }
+
+    // Current value of every counter, 0 for the missing ones. One syscall.
+    // A group is scheduled all or nothing, so when it only got part of the
+    // time it was enabled, every count is scaled up by the same ratio.
+    void
+    read(uint64_t out[PERF_NUM_EVENTS]) noexcept {
+        std::memset(out, 0, sizeof(uint64_t) * PERF_NUM_EVENTS);
+        if (!available()) return;
+        // nr, time enabled, time running, then a value and id per event.
+        uint64_t buf[3 + 2 * PERF_NUM_EVENTS];
+        if (::read(fds[0], buf, sizeof(buf)) <= 0) return;
+        uint64_t enabled = buf[1], running = buf[2];
+        double scale = 1;
+        if (running < enabled) {
+            was_multiplexed = true;
+            scale = running ? (double)enabled / running : 0;
+        }
+        for (uint64_t i = 0; i < buf[0]; i++)
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++)
+                if (fds[e] != -1 && ids[e] == buf[4 + 2 * i])
+                    out[e] = (uint64_t)(buf[3 + 2 * i] * scale);
+    }
+};
+
+class PerfPhaseRecorder;
+
+// Every thread's recorder, plus the totals of threads that have exited.
+struct PerfRegistry {
+    std::mutex mutex;
+    std::vector<PerfPhaseRecorder*> live;
+    PerfReport retired;
+};
+
+static inline PerfRegistry&
+perf_registry() {
+    static PerfRegistry registry;
+    return registry;
+}
+
+// Splits one thread's counts between phases. begin(phase) ends whatever
+// phase was running, and PERF_FORWARD starts a new sample. Which samples are
+// measured is decided by how many the thread has seen, or by index when
+// there is one. When a sample's work is split over threads, every thread
+// should pass the same index, so that they all measure the same samples,
+// and only one of them should count it.
+class PerfPhaseRecorder {
+    PerfCounterGroup group;
+    uint64_t start[PERF_NUM_EVENTS];
+    int current = -1;
+    size_t seen = 0;
+    bool measuring = false;
+
+    // Written only by the owning thread, read by collect().
+    std::atomic<uint64_t> totals[PERF_NUM_PHASES][PERF_NUM_EVENTS] = {};
+    std::atomic<uint64_t> samples{0};
+
+    static void
+    bump(std::atomic<uint64_t>& a, uint64_t n) noexcept {
+        a.store(a.load(std::memory_order_relaxed) + n,
+                std::memory_order_relaxed);
+    }
+
+   public:
+    static constexpr uint64_t no_index = UINT64_MAX;
+
+    PerfPhaseRecorder() {
+        PerfRegistry& r = perf_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.live.push_back(this);
+    }
+
+    ~PerfPhaseRecorder() {
+        PerfRegistry& r = perf_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        add_to(r.retired);
+        std::erase(r.live, this);
+    }
+
+    // With an index, any phase decides again whether to measure, for the
+    // threads that only do part of a sample's work.
+    void
+    begin(PerfPhase phase, uint64_t num_samples = 1,
+          uint64_t index = no_index) noexcept {
+        if (phase == PERF_FORWARD || index != no_index) {
+            end();
+            size_t every = perf_sample_every.load(std::memory_order_relaxed);
+            bool pick = index == no_index ? seen++ % every == 0
+                                          : index % every == 0;
+            measuring = group.available() && pick;
+            if (measuring) bump(samples, num_samples);
+        }
+        if (!measuring) return;
+
+        uint64_t now[PERF_NUM_EVENTS];
+        group.read(now);
+        if (current != -1)
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++)
+                bump(totals[current][e], now[e] - start[e]);
+        std::memcpy(start, now, sizeof(now));
+        current = phase;
+    }
+
+    void
+    end() noexcept {
+        if (measuring && current != -1) {
+            uint64_t now[PERF_NUM_EVENTS];
+            group.read(now);
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++)
+                bump(totals[current][e], now[e] - start[e]);
+        }
+        current = -1;
+    }
+
+    void
+    add_to(PerfReport& r) const {
+        for (size_t p = 0; p < PERF_NUM_PHASES; p++)
+            for (size_t e = 0; e < PERF_NUM_EVENTS; e++)
+                r.counts[p][e] += totals[p][e].load(std::memory_order_relaxed);
+        r.samples += samples.load(std::memory_order_relaxed);
+        r.multiplexed |= group.multiplexed();
+        if (group.available())
+            r.available = true;
+        else if (r.why_unavailable.empty())
+            r.why_unavailable = group.why_unavailable();
+    }
+};
+
+static inline PerfPhaseRecorder&
+perf_thread_recorder() {
+    thread_local PerfPhaseRecorder recorder;
+    return recorder;
+}
+
+#endif  // TSETLIN_PERF
+
+// Totals over every thread that has recorded anything.
+static inline PerfReport
+perf_collect() {
+    PerfReport report;
+#if TSETLIN_PERF
+    PerfRegistry& r = perf_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    report = r.retired;
+    for (PerfPhaseRecorder* rec : r.live) rec->add_to(report);
+    if (report.available) report.why_unavailable.clear();
+    if (!report.available && report.why_unavailable.empty())
+        report.why_unavailable = "nothing recorded yet";
+#else
+    report.why_unavailable = "built without TSETLIN_PERF";
+#endif
+    return report;
+}
+
+#endif  // PERF_COUNTERS_INCLUDE
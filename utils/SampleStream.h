@@ -0,0 +1,33 @@
+#ifndef SAMPLE_STREAM_INCLUDE
+#define SAMPLE_STREAM_INCLUDE
+
+#include <concepts>
+#include <cstddef>
+
+#include "TsetlinBitset.h"
+
+// A run of consecutive samples from a dataset. Sample j of the chunk is
+// sample first_index + j of the dataset. Only valid until the next call to
+// next_chunk() on the stream it came from.
+template <size_t num_bits>
+struct SampleChunk {
+    const TBitset<num_bits>* samples;
+    const unsigned char* labels;
+    size_t first_index;
+    size_t size;
+};
+
+// Anything the trainer can pull samples from. An epoch is begin_epoch()
+// followed by next_chunk() until it returns false. The order can change from
+// epoch to epoch, but every sample shows up exactly once. StreamingDataset.h
+// has streams over memory and over IDX files.
+// clang-format off
+template <typename T, size_t num_bits>
+concept SampleStream = requires(T s, size_t epoch, SampleChunk<num_bits>& c) {
+    { s.size() } -> std::convertible_to<size_t>;
+    s.begin_epoch(epoch);
+    { s.next_chunk(c) } -> std::same_as<bool>;
+};
+// clang-format on
+
+#endif  // SAMPLE_STREAM_INCLUDE
@@ -0,0 +1,208 @@
+#ifndef SPARSE_DATASET_INCLUDE
+#define SPARSE_DATASET_INCLUDE
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "TsetlinBitset.h"
+
+// Binary samples stored by their set bits, in compressed sparse row form.
+// Row i's set bits are col_idx[row_ptr[i] .. row_ptr[i + 1]), increasing.
+// Memory is proportional to the number of set bits, not to num_bits.
+template <size_t num_bits>
+class CSRDataset {
+   public:
+    std::vector<size_t> row_ptr = {0};
+    std::vector<uint32_t> col_idx;
+    std::vector<int32_t> labels;
+
+    size_t
+    size() const noexcept {
+        return labels.size();
+    }
+
+    size_t
+    nnz() const noexcept {
+        return col_idx.size();
+    }
+
+    TSparseBitset<num_bits>
+    row(size_t i) const noexcept {
+        return {col_idx.data() + row_ptr[i], row_ptr[i + 1] - row_ptr[i]};
+    }
+
+    int32_t
+    label(size_t i) const noexcept {
+        return labels[i];
+    }
+
+    void
+    clear() noexcept {
+        row_ptr.assign(1, 0);
+        col_idx.clear();
+        labels.clear();
+    }
+
+    // The indices can come in any order, and repeats are dropped.
+    void
+    add_row(const uint32_t* idx, size_t n, int32_t label) {
+        size_t begin = col_idx.size();
+        for (size_t k = 0; k < n; k++) {
+            if (idx[k] >= num_bits)
+                throw std::out_of_range("Feature " + std::to_string(idx[k]) +
+                                        " doesn't fit in " +
+                                        std::to_string(num_bits) + " bits.");
+            col_idx.push_back(idx[k]);
+        }
+        auto first = col_idx.begin() + begin;
+        std::sort(first, col_idx.end());
+        col_idx.erase(std::unique(first, col_idx.end()), col_idx.end());
+        row_ptr.push_back(col_idx.size());
+        labels.push_back(label);
+    }
+};
+
+// Reads an svmlight/libsvm file a chunk of rows at a time, so a file of any
+// size can be trained on in bounded memory.
+//
+// <label> [qid:<n>] <index>:<value> <index>:<value> ... [# comment]
+//
+// A feature is set when its value is above threshold. Indices are 1 based
+// unless zero_based is set, as in the original svmlight.
+template <size_t num_bits>
+class SvmlightReader {
+    FILE* fp;
+    std::string path;
+    bool zero_based;
+    float threshold;
+    size_t chunk_rows;
+
+    char* line = NULL;
+    size_t line_cap = 0;
+    size_t line_num = 0;
+    std::vector<uint32_t> row;
+
+    [[noreturn]] void
+    fail(const std::string& why) const {
+        throw std::runtime_error(path + ":" + std::to_string(line_num) + ": " +
+                                 why);
+    }
+
+    // Parses the current line into row. Returns false for blank lines and
+    // comments.
+    bool
+    parse_line(int32_t& label) {
+        char* p = line;
+        if (char* hash = std::strchr(p, '#')) *hash = '\0';
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0' || *p == '\n' || *p == '\r') return false;
+
+        char* end;
+        errno = 0;
+        long l = std::strtol(p, &end, 10);
+        if (end == p || errno) fail("bad label");
+        // Some files write labels as 1.0
+        if (*end == '.')
+            while (*++end >= '0' && *end <= '9');
+        label = (int32_t)l;
+        p = end;
+
+        row.clear();
+        for (;;) {
+            while (*p == ' ' || *p == '\t') p++;
+            if (*p == '\0' || *p == '\n' || *p == '\r') return true;
+            if (!std::strncmp(p, "qid:", 4)) {
+                while (*p && *p != ' ' && *p != '\t' && *p != '\n') p++;
+                continue;
+            }
+
+            unsigned long idx = std::strtoul(p, &end, 10);
+            if (end == p || *end != ':') fail("expected <index>:<value>");
+            p = end + 1;
+            float value = std::strtof(p, &end);
+            if (end == p) fail("expected <index>:<value>");
+            p = end;
+
+            if (!zero_based) {
+                if (idx == 0) fail("index 0 in a 1 based file");
+                idx--;
+            }
+            if (idx >= num_bits)
+                fail("feature " + std::to_string(idx) + " doesn't fit in " +
+                     std::to_string(num_bits) + " bits");
+            if (value > threshold) row.push_back((uint32_t)idx);
+        }
+    }
+
+   public:
+    SvmlightReader(const char* file_path, bool zero_based_indices = false,
+                   float value_threshold = 0, size_t rows_per_chunk = 4096)
+        : path(file_path),
+          zero_based(zero_based_indices),
+          threshold(value_threshold),
+          chunk_rows(rows_per_chunk) {
+        fp = std::fopen(file_path, "r");
+        if (!fp)
+            throw std::runtime_error("Couldn't open " + path + ": " +
+                                     std::strerror(errno));
+    }
+
+    SvmlightReader(const SvmlightReader&) = delete;
+    SvmlightReader& operator=(const SvmlightReader&) = delete;
+
+    ~SvmlightReader() {
+        std::fclose(fp);
+        free(line);
+    }
+
+    // Start over from the top of the file, for the next epoch.
+    void
+    rewind() {
+        std::rewind(fp);
+        line_num = 0;
+    }
+
+    // Replaces the contents of chunk with up to chunk_rows more rows. Returns
+    // false at the end of the file.
+    bool
+    next_chunk(CSRDataset<num_bits>& chunk) {
+        chunk.clear();
+        int32_t label;
+        while (chunk.size() < chunk_rows &&
+               ::getline(&line, &line_cap, fp) != -1) {
+            line_num++;
+            if (parse_line(label))
+                chunk.add_row(row.data(), row.size(), label);
+        }
+        if (std::ferror(fp)) fail("read error");
+        return chunk.size();
+    }
+};
+
+// The whole file at once. Still only costs memory for the set bits.
+template <size_t num_bits>
+static inline CSRDataset<num_bits>
+load_svmlight(const char* path, bool zero_based = false, float threshold = 0) {
+    SvmlightReader<num_bits> reader(path, zero_based, threshold);
+    CSRDataset<num_bits> all, chunk;
+    while (reader.next_chunk(chunk)) {
+        size_t base = all.col_idx.size();
+        all.col_idx.insert(all.col_idx.end(), chunk.col_idx.begin(),
+                           chunk.col_idx.end());
+        for (size_t i = 1; i < chunk.row_ptr.size(); i++)
+            all.row_ptr.push_back(base + chunk.row_ptr[i]);
+        all.labels.insert(all.labels.end(), chunk.labels.begin(),
+                          chunk.labels.end());
+    }
+    return all;
+}
+
+#endif  // SPARSE_DATASET_INCLUDE
@@ -0,0 +1,312 @@
+#ifndef STREAMING_DATASET_INCLUDE
+#define STREAMING_DATASET_INCLUDE
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Binarizer.h"
+#include "IDXReader.h"
+#include "SampleStream.h"
+#include "TsetlinBitset.h"
+#include "Trace.h"
+#include "TsetlinRand.h"
+
+// Block order for an epoch. Blocks are shuffled, but samples inside a block
+// stay in order, so reads within a block stay sequential. Epoch 0 of an
+// unshuffled stream is just the file order.
+static inline void
+block_shuffle_order(std::vector<size_t>& order, size_t num_blocks,
+                    size_t epoch, bool shuffle, uint64_t seed) {
+    order.resize(num_blocks);
+    for (size_t i = 0; i < num_blocks; i++) order[i] = i;
+    if (!shuffle) return;
+    TsetlinRandGen rg(seed ^ (0x9e3779b97f4a7c15 * (epoch + 1)));
+    for (size_t i = num_blocks; i > 1; i--)
+        std::swap(order[i - 1], order[rg.rand_64() % i]);
+}
+
+// Streams over samples that are already in memory (BinaryMNIST, a mapped
+// cache, ...). Nothing gets copied, chunks point into the arrays.
+template <size_t num_bits>
+class InMemoryStream {
+    const TBitset<num_bits>* samples;
+    const unsigned char* labels;
+    size_t num_samples, block_size;
+    bool shuffle;
+    uint64_t seed;
+
+    std::vector<size_t> order;
+    size_t next_block = 0;
+
+   public:
+    InMemoryStream(const TBitset<num_bits>* sample_data,
+                   const unsigned char* label_data, size_t count,
+                   size_t samples_per_block = 1024, bool shuffle_blocks = false,
+                   uint64_t random_seed = 0xabcdef0123456789)
+        : samples(sample_data),
+          labels(label_data),
+          num_samples(count),
+          block_size(samples_per_block),
+          shuffle(shuffle_blocks),
+          seed(random_seed) {
+        if (!block_size)
+            throw std::invalid_argument("Blocks need at least one sample.");
+        begin_epoch(0);
+    }
+
+    size_t
+    size() const noexcept {
+        return num_samples;
+    }
+
+    void
+    begin_epoch(size_t epoch) {
+        size_t num_blocks = (num_samples + block_size - 1) / block_size;
+        block_shuffle_order(order, num_blocks, epoch, shuffle, seed);
+        next_block = 0;
+    }
+
+    bool
+    next_chunk(SampleChunk<num_bits>& chunk) {
+        if (next_block == order.size()) return false;
+        size_t first = order[next_block++] * block_size;
+        chunk.samples = samples + first;
+        chunk.labels = labels + first;
+        chunk.first_index = first;
+        chunk.size = std::min(block_size, num_samples - first);
+        return true;
+    }
+};
+
+// Streams a uint8 IDX image file and its label file from disk,
+// without ever holding more than two blocks in memory. A loader thread reads
+// and binarizes the next block while the trainer works on the current one.
+template <size_t num_bits>
+class StreamingIDXDataset {
+    struct Slot {
+        std::vector<TBitset<num_bits>> samples;
+        std::vector<unsigned char> labels;
+        std::vector<unsigned char> raw;
+        size_t first_index = 0, size = 0;
+        bool full = false;
+    };
+
+    int img_fd = -1, label_fd = -1;
+    size_t img_offset, label_offset;  // Where the data starts in each file
+    size_t num_samples, block_size;
+    uint8_t threshold;
+    bool shuffle;
+    uint64_t seed;
+
+    std::vector<size_t> order;
+    Slot slots[2];
+    size_t produced = 0, consumed = 0;  // Blocks, this epoch
+    bool holding = false;               // Consumer has slot consumed % 2
+    bool stop = false;
+    std::string loader_error;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread loader;
+
+    static IDXHeader
+    read_header(int fd, const char* path) {
+        struct stat st;
+        if (::fstat(fd, &st) == -1)
+            throw std::runtime_error("Couldn't stat " + std::string(path) +
+                                     ": " + std::strerror(errno));
+        unsigned char b[4 + 4 * 255];
+        ssize_t got = ::pread(fd, b, sizeof(b), 0);
+        return IDXHeader::parse(b, got < 0 ? 0 : got, st.st_size, path);
+    }
+
+    static int
+    open_or_throw(const char* path) {
+        int fd = ::open(path, O_RDONLY);
+        if (fd == -1)
+            throw std::runtime_error("Couldn't open " + std::string(path) +
+                                     ": " + std::strerror(errno));
+        return fd;
+    }
+
+    static void
+    pread_all(int fd, void* buf, size_t len, size_t offset) {
+        char* p = (char*)buf;
+        while (len) {
+            ssize_t r = ::pread(fd, p, len, offset);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) throw std::runtime_error("Short read from dataset.");
+            p += r, len -= r, offset += r;
+        }
+    }
+
+    void
+    fill(Slot& s, size_t block) {
+        s.first_index = block * block_size;
+        s.size = std::min(block_size, num_samples - s.first_index);
+        s.raw.resize(s.size * num_bits);
+        pread_all(img_fd, s.raw.data(), s.size * num_bits,
+                  img_offset + s.first_index * num_bits);
+        pread_all(label_fd, s.labels.data(), s.size,
+                  label_offset + s.first_index);
+        for (size_t i = 0; i < s.size; i++) {
+            std::memset(s.samples[i].buf, 0, sizeof(s.samples[i].buf));
+            pack_gt(s.raw.data() + i * num_bits, threshold, num_bits,
+                    s.samples[i].buf);
+        }
+    }
+
+    void
+    load_epoch() {
+        TSETLIN_TRACE_THREAD_NAME("loader");
+        try {
+            for (size_t b = 0; b < order.size(); b++) {
+                Slot& s = slots[b % 2];
+                {
+                    // Waiting for the trainer to hand a block back.
+                    TSETLIN_TRACE_SPAN("loader backpressure");
+                    std::unique_lock<std::mutex> lock(mutex);
+                    cv.wait(lock, [&] { return stop || !s.full; });
+                    if (stop) return;
+                }
+                TSETLIN_TRACE_SPAN("load block", order[b]);
+                fill(s, order[b]);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    s.full = true;
+                    produced++;
+                }
+                cv.notify_all();
+            }
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            loader_error = e.what();
+            cv.notify_all();
+        }
+    }
+
+    void
+    stop_loader() {
+        if (!loader.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        cv.notify_all();
+        loader.join();
+    }
+
+   public:
+    // threshold is a fraction of the 0-255 pixel range, like BinaryMNIST's.
+    StreamingIDXDataset(const char* images_path, const char* labels_path,
+                        float pixel_threshold = .3,
+                        size_t samples_per_block = 4096,
+                        bool shuffle_blocks = true,
+                        uint64_t random_seed = 0xabcdef0123456789)
+        : block_size(samples_per_block),
+          threshold((uint8_t)(255 * pixel_threshold)),
+          shuffle(shuffle_blocks),
+          seed(random_seed) {
+        if (!block_size)
+            throw std::invalid_argument("Blocks need at least one sample.");
+        // The destructor doesn't run if this throws, close what we opened.
+        try {
+            img_fd = open_or_throw(images_path);
+            label_fd = open_or_throw(labels_path);
+
+            IDXHeader img = read_header(img_fd, images_path);
+            IDXHeader lab = read_header(label_fd, labels_path);
+            if (img.dtype != IDXType::U8 || lab.dtype != IDXType::U8 ||
+                lab.shape.size() != 1)
+                throw std::runtime_error("Not an IDX image/label file pair.");
+            num_samples = img.count();
+            if (img.item_elems() != num_bits)
+                throw std::runtime_error(
+                    "IDX images have " + std::to_string(img.item_elems()) +
+                    " pixels, expected " + std::to_string(num_bits) + ".");
+            if (lab.count() != num_samples)
+                throw std::runtime_error("IDX image and label counts differ.");
+            img_offset = img.data_offset;
+            label_offset = lab.data_offset;
+
+            for (Slot& s : slots) {
+                s.samples.resize(block_size);
+                s.labels.resize(block_size);
+            }
+        } catch (...) {
+            if (img_fd != -1) ::close(img_fd);
+            if (label_fd != -1) ::close(label_fd);
+            throw;
+        }
+    }
+
+    StreamingIDXDataset(const StreamingIDXDataset&) = delete;
+    StreamingIDXDataset& operator=(const StreamingIDXDataset&) = delete;
+
+    ~StreamingIDXDataset() {
+        stop_loader();
+        ::close(img_fd);
+        ::close(label_fd);
+    }
+
+    size_t
+    size() const noexcept {
+        return num_samples;
+    }
+
+    void
+    begin_epoch(size_t epoch) {
+        stop_loader();
+        size_t num_blocks = (num_samples + block_size - 1) / block_size;
+        block_shuffle_order(order, num_blocks, epoch, shuffle, seed);
+        for (Slot& s : slots) s.full = false;
+        produced = consumed = 0;
+        holding = stop = false;
+        loader_error.clear();
+        loader = std::thread([this] { load_epoch(); });
+    }
+
+    bool
+    next_chunk(SampleChunk<num_bits>& chunk) {
+        std::unique_lock<std::mutex> lock(mutex);
+        // Hand the block we were holding back to the loader.
+        if (holding) {
+            slots[consumed % 2].full = false;
+            consumed++;
+            holding = false;
+            cv.notify_all();
+        }
+        if (consumed == order.size()) return false;
+
+        if (produced <= consumed && loader_error.empty()) {
+            // The trainer is starved for data.
+            TSETLIN_TRACE_SPAN("loader starved");
+            cv.wait(lock, [&] {
+                return produced > consumed || !loader_error.empty();
+            });
+        }
+        if (produced <= consumed) throw std::runtime_error(loader_error);
+
+        Slot& s = slots[consumed % 2];
+        holding = true;
+        chunk.samples = s.samples.data();
+        chunk.labels = s.labels.data();
+        chunk.first_index = s.first_index;
+        chunk.size = s.size;
+        return true;
+    }
+};
+
+#endif  // STREAMING_DATASET_INCLUDE
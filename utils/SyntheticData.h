@@ -0,0 +1,88 @@
+#ifndef SYNTHETIC_DATA_INCLUDE
+#define SYNTHETIC_DATA_INCLUDE
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "TsetlinBitset.h"
+#include "TsetlinRand.h"
+
+// Binary classification tasks that can be generated at any size, for
+// benchmarks and tests that have to run without a dataset on disk. Each
+// fills x[0..n) and y[0..n), and flips a label_noise fraction of the labels.
+
+template <size_t bits>
+static inline void
+synth_random_bits(TsetlinRandGen& rg, TBitset<bits>& x, float density = .5) {
+    for (size_t i = 0; i < x.buf_len; i++) x.buf[i] = 0;
+    for (size_t i = 0; i < bits; i++)
+        if (density == .5f ? rg.rand_64() & 1 : rg.rand_bernoulli(density))
+            x.buf[i / TINT_BIT_NUM] |= (tint)1 << (i % TINT_BIT_NUM);
+}
+
+// The label is the xor of the first two bits. The rest are noise. The same
+// problem as xor_() in Train.cpp, padded out to any width.
+template <size_t bits>
+static inline void
+synth_noisy_xor(TBitset<bits>* x, bool* y, size_t n, float label_noise,
+                uint64_t seed = 1) {
+    static_assert(bits >= 2, "Noisy XOR needs two bits.");
+    TsetlinRandGen rg(seed);
+    for (size_t i = 0; i < n; i++) {
+        synth_random_bits(rg, x[i]);
+        y[i] = (x[i][0] != x[i][1]) ^ rg.rand_bernoulli(label_noise);
+    }
+}
+
+// The label is the parity of the first k bits. Hard for a single clause,
+// since every one of the 2^(k-1) odd patterns needs its own.
+template <size_t bits>
+static inline void
+synth_k_parity(TBitset<bits>* x, bool* y, size_t n, size_t k,
+               float label_noise, uint64_t seed = 1) {
+    if (!k || k > bits)
+        throw std::invalid_argument("k-parity needs 0 < k <= bits.");
+    TsetlinRandGen rg(seed);
+    for (size_t i = 0; i < n; i++) {
+        synth_random_bits(rg, x[i]);
+        bool parity = 0;
+        for (size_t b = 0; b < k; b++) parity ^= x[i][b];
+        y[i] = parity ^ rg.rand_bernoulli(label_noise);
+    }
+}
+
+// Sparse inputs (each bit set with probability density). The label is true
+// if any of num_terms hidden conjunctions of term_size bits holds. Half of
+// the samples get one of the terms planted, so the classes are balanced
+// however sparse the input is. Exactly the kind of rule a clause learns.
+template <size_t bits>
+static inline void
+synth_sparse_conjunctions(TBitset<bits>* x, bool* y, size_t n,
+                          size_t num_terms, size_t term_size, float density,
+                          float label_noise, uint64_t seed = 1) {
+    if (!num_terms || !term_size || term_size > bits)
+        throw std::invalid_argument("Bad conjunction shape.");
+    TsetlinRandGen rg(seed);
+    std::vector<std::vector<size_t>> terms(num_terms);
+    for (auto& t : terms)
+        for (size_t b = 0; b < term_size; b++) t.push_back(rg.rand_64() % bits);
+
+    for (size_t i = 0; i < n; i++) {
+        synth_random_bits(rg, x[i], density);
+        if (rg.rand_64() & 1)
+            for (size_t b : terms[rg.rand_64() % num_terms])
+                x[i].buf[b / TINT_BIT_NUM] |= (tint)1 << (b % TINT_BIT_NUM);
+
+        bool any = 0;
+        for (auto& t : terms) {
+            bool all = 1;
+            for (size_t b : t) all &= x[i][b];
+            any |= all;
+        }
+        y[i] = any ^ rg.rand_bernoulli(label_noise);
+    }
+}
+
+#endif  // SYNTHETIC_DATA_INCLUDE
@@ -0,0 +1,319 @@
+#ifndef TRACE_INCLUDE
+#define TRACE_INCLUDE
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Build with -DTSETLIN_TRACE=1 to record a timeline of training: epochs,
+// batches, sample phases, thread pool jobs and barrier waits, and the data
+// loader. trace_write_json() writes it in Chrome's trace event format, which
+// opens in Perfetto (ui.perfetto.dev) or chrome://tracing. Otherwise the
+// TSETLIN_TRACE_* marks compile to nothing.
+#ifndef TSETLIN_TRACE
+#define TSETLIN_TRACE 0
+#endif
+
+#define TSETLIN_TRACE_CAT2(a, b) a##b
+#define TSETLIN_TRACE_CAT(a, b) TSETLIN_TRACE_CAT2(a, b)
+
+#if TSETLIN_TRACE
+// A span from here to the end of the enclosing scope. name must be a string
+// literal. An optional integer shows up as the span's argument.
+#define TSETLIN_TRACE_SPAN(...) \
+    TraceSpan TSETLIN_TRACE_CAT(trace_span_, __LINE__)(__VA_ARGS__)
+// One sample's span, split into phases with TSETLIN_TRACE_PHASE. Only every
+// nth sample is recorded (see trace_set_sample_every).
+#define TSETLIN_TRACE_SAMPLE(var) TraceSample var
+#define TSETLIN_TRACE_PHASE(var, name) var.phase(name)
+#define TSETLIN_TRACE_THREAD_NAME(name) trace_thread_name(name)
+#else
+#define TSETLIN_TRACE_SPAN(...)
+#define TSETLIN_TRACE_SAMPLE(var)
+#define TSETLIN_TRACE_PHASE(var, name)
+#define TSETLIN_TRACE_THREAD_NAME(name)
+#endif
+
+struct TraceEvent {
+    const char* name;
+    uint64_t begin_ns, end_ns;
+    int64_t arg;  // -1 for none
+};
+
+// One thread's events. Only the owning thread appends, and publishes the new
+// count with a release store, so the writer can read the buffer while the
+// thread is still recording. Events past the capacity are dropped and
+// counted.
+class TraceBuffer {
+   public:
+    static constexpr size_t capacity = 1 << 16;
+
+    uint32_t tid;             // Under the registry lock
+    std::string thread_name;  // Set by the owning thread, under the registry
+                              // lock
+    std::unique_ptr<TraceEvent[]> events{new TraceEvent[capacity]};
+    std::atomic<size_t> count{0};
+    std::atomic<uint64_t> dropped{0};
+
+    explicit TraceBuffer(uint32_t thread_id) : tid(thread_id) {}
+
+    inline void
+    push(const TraceEvent& e) noexcept {
+        size_t n = count.load(std::memory_order_relaxed);
+        if (n == capacity) {
+            dropped.store(dropped.load(std::memory_order_relaxed) + 1,
+                          std::memory_order_relaxed);
+            return;
+        }
+        events[n] = e;
+        count.store(n + 1, std::memory_order_release);
+    }
+};
+
+// The events of a thread that has exited, copied out of its buffer.
+struct TraceFinished {
+    uint32_t tid;
+    std::string thread_name;
+    std::vector<TraceEvent> events;
+    uint64_t dropped;
+};
+
+// Buffers are owned here rather than by their threads. When a thread exits
+// (pool workers, per-epoch loaders) its events are copied to finished, sized
+// to what it recorded, and its buffer goes to spare for the next thread, so
+// a loader started every epoch doesn't cost a full buffer each time.
+struct TraceRegistry {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<TraceBuffer>> buffers;  // Live threads
+    std::vector<std::unique_ptr<TraceBuffer>> spare;
+    std::vector<TraceFinished> finished;
+    uint32_t next_tid = 0;
+    std::chrono::steady_clock::time_point origin =
+        std::chrono::steady_clock::now();
+};
+
+static inline TraceRegistry&
+trace_registry() {
+    static TraceRegistry registry;
+    return registry;
+}
+
+// Takes a buffer for the calling thread, and gives it back when the thread
+// exits.
+class TraceThread {
+    TraceBuffer* buffer;
+
+   public:
+    TraceThread() {
+        TraceRegistry& r = trace_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        if (r.spare.empty()) {
+            r.buffers.emplace_back(new TraceBuffer(r.next_tid));
+        } else {
+            r.buffers.push_back(std::move(r.spare.back()));
+            r.spare.pop_back();
+            r.buffers.back()->tid = r.next_tid;
+        }
+        r.next_tid++;
+        buffer = r.buffers.back().get();
+    }
+
+    TraceThread(const TraceThread&) = delete;
+    TraceThread& operator=(const TraceThread&) = delete;
+
+    ~TraceThread() {
+        TraceRegistry& r = trace_registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        size_t n = buffer->count.load(std::memory_order_relaxed);
+        r.finished.push_back(
+            {buffer->tid, std::move(buffer->thread_name),
+             std::vector<TraceEvent>(buffer->events.get(),
+                                     buffer->events.get() + n),
+             buffer->dropped.load(std::memory_order_relaxed)});
+        buffer->thread_name.clear();
+        buffer->count.store(0, std::memory_order_relaxed);
+        buffer->dropped.store(0, std::memory_order_relaxed);
+        for (auto& b : r.buffers) {
+            if (b.get() != buffer) continue;
+            r.spare.push_back(std::move(b));
+            b = std::move(r.buffers.back());
+            r.buffers.pop_back();
+            break;
+        }
+    }
+
+    TraceBuffer&
+    get() noexcept {
+        return *buffer;
+    }
+};
+
+static inline TraceBuffer&
+trace_thread_buffer() {
+    thread_local TraceThread thread;
+    return thread.get();
+}
+
+static inline uint64_t
+trace_now_ns() noexcept {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - trace_registry().origin)
+        .count();
+}
+
+// Names the calling thread's track in the timeline.
+static inline void
+trace_thread_name(const std::string& name) {
+    TraceBuffer& b = trace_thread_buffer();
+    std::lock_guard<std::mutex> lock(trace_registry().mutex);
+    b.thread_name = name;
+}
+
+static std::atomic<size_t> trace_sample_every{1};
+
+// Only record every nth sample's spans. A sample takes microseconds on a
+// small machine, so tracing every one of them dwarfs the work and fills the
+// buffers within an epoch.
+static inline void
+trace_set_sample_every(size_t n) {
+    trace_sample_every.store(n ? n : 1, std::memory_order_relaxed);
+}
+
+class TraceSpan {
+    const char* name;
+    int64_t arg;
+    uint64_t begin_ns;
+
+   public:
+    TraceSpan(const char* span_name, int64_t span_arg = -1) noexcept
+        : name(span_name), arg(span_arg), begin_ns(trace_now_ns()) {}
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    ~TraceSpan() {
+        trace_thread_buffer().push({name, begin_ns, trace_now_ns(), arg});
+    }
+};
+
+// A "sample" span, and consecutive phase spans inside it. phase() ends the
+// previous phase.
+class TraceSample {
+    bool recording;
+    const char* phase_name = nullptr;
+    uint64_t sample_begin_ns = 0, phase_begin_ns = 0;
+
+    static bool
+    next_sample() noexcept {
+        thread_local size_t seen = 0;
+        return seen++ % trace_sample_every.load(std::memory_order_relaxed) ==
+               0;
+    }
+
+    void
+    end_phase(uint64_t now) noexcept {
+        if (phase_name)
+            trace_thread_buffer().push({phase_name, phase_begin_ns, now, -1});
+    }
+
+   public:
+    TraceSample() noexcept : recording(next_sample()) {
+        if (recording) sample_begin_ns = trace_now_ns();
+    }
+
+    TraceSample(const TraceSample&) = delete;
+    TraceSample& operator=(const TraceSample&) = delete;
+
+    void
+    phase(const char* name) noexcept {
+        if (!recording) return;
+        uint64_t now = trace_now_ns();
+        end_phase(now);
+        phase_name = name;
+        phase_begin_ns = now;
+    }
+
+    ~TraceSample() {
+        if (!recording) return;
+        uint64_t now = trace_now_ns();
+        end_phase(now);
+        trace_thread_buffer().push({"sample", sample_begin_ns, now, -1});
+    }
+};
+
+static inline void
+trace_write_escaped(FILE* f, const char* s) {
+    for (; *s; s++) {
+        if (*s == '"' || *s == '\\')
+            std::fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            std::fprintf(f, "\\u%04x", *s);
+        else
+            std::fputc(*s, f);
+    }
+}
+
+// Writes everything recorded so far as a trace event JSON file. Complete
+// ("X") events in microseconds, one track per thread. Safe to call while
+// threads are still recording; their newest events may be left out.
+// Returns the number of events dropped because a buffer was full.
+static inline uint64_t
+trace_write_json(const char* path) {
+    FILE* f = std::fopen(path, "w");
+    if (!f) throw std::runtime_error("Couldn't open " + std::string(path));
+
+    TraceRegistry& r = trace_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    uint64_t dropped = 0;
+    bool first = true;
+    std::fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    auto write_thread = [&](uint32_t tid, const std::string& name,
+                            const TraceEvent* events, size_t n) {
+        if (!name.empty()) {
+            std::fprintf(f,
+                         "%s\n{\"ph\":\"M\",\"pid\":1,\"tid\":%u,"
+                         "\"name\":\"thread_name\",\"args\":{\"name\":\"",
+                         first ? "" : ",", tid);
+            trace_write_escaped(f, name.c_str());
+            std::fprintf(f, "\"}}");
+            first = false;
+        }
+        for (size_t i = 0; i < n; i++) {
+            const TraceEvent& e = events[i];
+            std::fprintf(f,
+                         "%s\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+                         "\"name\":\"",
+                         first ? "" : ",", tid);
+            trace_write_escaped(f, e.name);
+            std::fprintf(f, "\",\"ts\":%.3f,\"dur\":%.3f", e.begin_ns / 1e3,
+                         (e.end_ns - e.begin_ns) / 1e3);
+            if (e.arg >= 0)
+                std::fprintf(f, ",\"args\":{\"n\":%lld}", (long long)e.arg);
+            std::fputc('}', f);
+            first = false;
+        }
+    };
+    for (const TraceFinished& t : r.finished) {
+        write_thread(t.tid, t.thread_name, t.events.data(), t.events.size());
+        dropped += t.dropped;
+    }
+    for (const auto& b : r.buffers) {
+        write_thread(b->tid, b->thread_name, b->events.get(),
+                     b->count.load(std::memory_order_acquire));
+        dropped += b->dropped.load(std::memory_order_relaxed);
+    }
+    std::fprintf(f, "\n]}\n");
+    bool failed = std::ferror(f);
+    if (std::fclose(f) || failed)
+        throw std::runtime_error("Couldn't write " + std::string(path));
+    return dropped;
+}
+
+#endif  // TRACE_INCLUDE
@@ -5,6 +5,7 @@
 #include <bit>
 #include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <ostream>
 #include <stdexcept>
 #include <string>
@@ -30,7 +31,7 @@ class TsetlinRandGen;
 template <size_t num_bits>
 class TBitset {
     friend class BitRef;
-    friend class TsetlinRanTsetlinRandGen;
+    friend class TsetlinRandGen;
 
    public:
     /////////////
@@ -156,7 +157,7 @@ class TBitset {
     // Bit access operators
     bool
     operator[](size_t pos) const noexcept {
-        return (bool)TBitRef(*this, pos);
+        return (buf[pos / TINT_BIT_NUM] >> (pos % TINT_BIT_NUM)) & 1;
     }
 
     TBitRef
@@ -268,4 +269,21 @@ class TBitset {
     }
 };
 
+// The set bits of a num_bits wide bitset, as strictly increasing indices. For
+// inputs that are almost all zeros, where walking the indices is much cheaper
+// than walking the bits. Points into someone else's storage.
+template <size_t num_bits>
+struct TSparseBitset {
+    const uint32_t* idx;
+    size_t nnz;
+
+    TBitset<num_bits>&
+    to_dense(TBitset<num_bits>& out) const noexcept {
+        for (size_t i = 0; i < out.buf_len; i++) out.buf[i] = 0;
+        for (size_t k = 0; k < nnz; k++)
+            out.buf[idx[k] / TINT_BIT_NUM] |= (tint)1 << (idx[k] % TINT_BIT_NUM);
+        return out;
+    }
+};
+
 #endif  // TBITSET_INCLUDE
@@ -4,6 +4,8 @@
 #ifndef TSETLIN_RAND_INCLUDE
 #define TSETLIN_RAND_INCLUDE
 
+#include <immintrin.h>
+
 #include "TsetlinBitset.h"
 
 class TsetlinRandGen {
@@ -194,13 +196,252 @@ class TsetlinRandGen {
     void
     biased_bits(TBitset<bits>& to_pack, float p) noexcept {
         static constexpr bool _32_bit = sizeof(tint) == sizeof(uint32_t);
-        static constexpr size_t backing_size =
-            (bits / TINT_BIT_NUM) + ((bits % TINT_BIT_NUM) != 0);
 
-        std::array<uint64_t, backing_size>& backing = to_pack.get_backing();
-        for (size_t i = 0; i < backing_size; i++)
+        tint* backing = to_pack.buf;
+        for (size_t i = 0; i < to_pack.buf_len; i++)
             backing[i] = _32_bit ? biased_bits_32(p) : biased_bits_64(p);
     }
 };
 
+// Sixteen xoshiro128+ lanes, stepped together. Bits are sampled by comparing
+// each lane's 32 bit output against an integer threshold, so a whole tint of
+// Bernoulli(p) bits costs four steps and no float math. The lane count is
+// fixed, so AVX-512, AVX2 and scalar builds produce the same bits.
+//
+// https://prng.di.unimi.it/xoshiro128plus.c
+class TsetlinSIMDRandGen {
+   public:
+    static constexpr size_t lanes = 16;
+
+   private:
+    alignas(64) uint32_t s0[lanes];
+    alignas(64) uint32_t s1[lanes];
+    alignas(64) uint32_t s2[lanes];
+    alignas(64) uint32_t s3[lanes];
+
+    static inline uint64_t
+    splitmix64(uint64_t& x) noexcept {
+        uint64_t z = (x += 0x9e3779b97f4a7c15);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+
+   public:
+    // The ways of stepping the lanes. Only the ones the build has the
+    // instructions for exist; best is what everything uses unless asked.
+    enum Path { SCALAR, AVX2, AVX512 };
+#if defined(__AVX512F__)
+    static constexpr Path best = AVX512;
+#elif defined(__AVX2__)
+    static constexpr Path best = AVX2;
+#else
+    static constexpr Path best = SCALAR;
+#endif
+
+   private:
+    // One step of every lane. Returns bit i set if lane i's output is below
+    // threshold.
+    template <Path path = best>
+    inline uint16_t
+    step_mask(uint32_t threshold) noexcept {
+        static_assert(path <= best, "Path not compiled in.");
+#if defined(__AVX512F__)
+        if constexpr (path == AVX512) {
+            __m512i a = _mm512_load_si512(s0), b = _mm512_load_si512(s1);
+            __m512i c = _mm512_load_si512(s2), d = _mm512_load_si512(s3);
+            __m512i result = _mm512_add_epi32(a, d);
+            __m512i t = _mm512_slli_epi32(b, 9);
+            c = _mm512_xor_si512(c, a);
+            d = _mm512_xor_si512(d, b);
+            b = _mm512_xor_si512(b, c);
+            a = _mm512_xor_si512(a, d);
+            c = _mm512_xor_si512(c, t);
+            d = _mm512_rol_epi32(d, 11);
+            _mm512_store_si512(s0, a), _mm512_store_si512(s1, b);
+            _mm512_store_si512(s2, c), _mm512_store_si512(s3, d);
+            return _mm512_cmplt_epu32_mask(result,
+                                           _mm512_set1_epi32(threshold));
+        }
+#endif
+#if defined(__AVX2__)
+        if constexpr (path == AVX2) {
+            // No unsigned compare, so flip the sign bits of both sides first.
+            const __m256i flip = _mm256_set1_epi32((int)0x80000000);
+            const __m256i thr =
+                _mm256_xor_si256(_mm256_set1_epi32(threshold), flip);
+            uint16_t mask = 0;
+            for (size_t h = 0; h < lanes; h += 8) {
+                __m256i a = _mm256_load_si256((__m256i*)(s0 + h));
+                __m256i b = _mm256_load_si256((__m256i*)(s1 + h));
+                __m256i c = _mm256_load_si256((__m256i*)(s2 + h));
+                __m256i d = _mm256_load_si256((__m256i*)(s3 + h));
+                __m256i result = _mm256_add_epi32(a, d);
+                __m256i t = _mm256_slli_epi32(b, 9);
+                c = _mm256_xor_si256(c, a);
+                d = _mm256_xor_si256(d, b);
+                b = _mm256_xor_si256(b, c);
+                a = _mm256_xor_si256(a, d);
+                c = _mm256_xor_si256(c, t);
+                d = _mm256_or_si256(_mm256_slli_epi32(d, 11),
+                                    _mm256_srli_epi32(d, 21));
+                _mm256_store_si256((__m256i*)(s0 + h), a);
+                _mm256_store_si256((__m256i*)(s1 + h), b);
+                _mm256_store_si256((__m256i*)(s2 + h), c);
+                _mm256_store_si256((__m256i*)(s3 + h), d);
+                __m256i lt =
+                    _mm256_cmpgt_epi32(thr, _mm256_xor_si256(result, flip));
+                mask |= (uint16_t)_mm256_movemask_ps(_mm256_castsi256_ps(lt))
+                        << h;
+            }
+            return mask;
+        }
+#endif
+        if constexpr (path == SCALAR) {
+            uint16_t mask = 0;
+            for (size_t i = 0; i < lanes; i++) {
+                uint32_t result = s0[i] + s3[i];
+                uint32_t t = s1[i] << 9;
+                s2[i] ^= s0[i];
+                s3[i] ^= s1[i];
+                s1[i] ^= s2[i];
+                s0[i] ^= s3[i];
+                s2[i] ^= t;
+                s3[i] = (s3[i] << 11) | (s3[i] >> 21);
+                mask |= (uint16_t)(result < threshold) << i;
+            }
+            return mask;
+        }
+    }
+
+   public:
+    inline TsetlinSIMDRandGen(uint64_t seed = 0xabcdef0123456789) {
+        for (size_t i = 0; i < lanes; i++) {
+            uint64_t a = splitmix64(seed), b = splitmix64(seed);
+            s0[i] = (uint32_t)a, s1[i] = (uint32_t)(a >> 32);
+            s2[i] = (uint32_t)b, s3[i] = (uint32_t)(b >> 32);
+            // The all zero state is the one state xoshiro can't leave.
+            if (!(s0[i] | s1[i] | s2[i] | s3[i])) s0[i] = 1;
+        }
+    }
+
+    // P(bit) = threshold / 2^32. Thresholds of 2^32 and up mean always.
+    static inline uint64_t
+    bernoulli_threshold(float p) noexcept {
+        if (!(p > 0)) return 0;
+        if (p >= 1) return (uint64_t)1 << 32;
+        return (uint64_t)((double)p * 4294967296.0);
+    }
+
+    // A tint of independent Bernoulli bits, P(bit) = threshold / 2^32. Every
+    // path gives the same bits from the same state.
+    template <Path path = best>
+    inline tint
+    threshold_bits_64(uint64_t threshold) noexcept {
+        if (threshold >> 32) return TINT_MAX;
+        uint32_t thr = (uint32_t)threshold;
+        tint m0 = step_mask<path>(thr), m1 = step_mask<path>(thr);
+        tint m2 = step_mask<path>(thr), m3 = step_mask<path>(thr);
+        return m0 | (m1 << 16) | (m2 << 32) | (m3 << 48);
+    }
+
+    inline tint
+    biased_bits_64(float p) noexcept {
+        return threshold_bits_64(bernoulli_threshold(p));
+    }
+
+    // Fill n words with Bernoulli(p) bits.
+    inline void
+    fill_bernoulli(tint* words, size_t n, float p) noexcept {
+        uint64_t threshold = bernoulli_threshold(p);
+        for (size_t i = 0; i < n; i++) words[i] = threshold_bits_64(threshold);
+    }
+
+    // Unlike TsetlinRandGen::biased_bits, the bits past the end stay zero,
+    // so .count() still works.
+    template <size_t bits>
+    void
+    biased_bits(TBitset<bits>& to_pack, float p) noexcept {
+        fill_bernoulli(to_pack.buf, to_pack.buf_len, p);
+        if constexpr (bits % TINT_BIT_NUM)
+            to_pack.buf[to_pack.buf_len - 1] &=
+                ((tint)1 << (bits % TINT_BIT_NUM)) - 1;
+    }
+};
+
+// Counter based generator (Philox4x32-10). The whole stream is a pure
+// function of (seed, epoch, sample, clause), so the random decisions made
+// while updating a clause don't depend on what any other clause or thread has
+// drawn before it. Same interface as TsetlinRandGen, so the feedback code can
+// take either.
+//
+// Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC11.
+class TsetlinCounterRandGen {
+    static constexpr uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+    constexpr static double max_64_inv =
+        1. / (double)std::numeric_limits<std::uint64_t>::max();
+
+    uint32_t key[2];
+    uint32_t ctr[4];   // epoch, sample, clause, block
+    uint32_t out[4];
+    size_t out_idx = 4;  // Next unused word of out
+
+    static inline void
+    mulhilo(uint32_t a, uint32_t b, uint32_t* hi, uint32_t* lo) noexcept {
+        uint64_t p = (uint64_t)a * b;
+        *hi = (uint32_t)(p >> 32);
+        *lo = (uint32_t)p;
+    }
+
+   public:
+    // Exposed for testing against the reference implementation.
+    static inline void
+    philox4x32_10(const uint32_t in[4], const uint32_t k[2],
+                  uint32_t res[4]) noexcept {
+        uint32_t c0 = in[0], c1 = in[1], c2 = in[2], c3 = in[3];
+        uint32_t k0 = k[0], k1 = k[1];
+        for (size_t round = 0; round < 10; round++) {
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(M0, c0, &hi0, &lo0);
+            mulhilo(M1, c2, &hi1, &lo1);
+            c0 = hi1 ^ c1 ^ k0;
+            c1 = lo1;
+            c2 = hi0 ^ c3 ^ k1;
+            c3 = lo0;
+            k0 += W0;
+            k1 += W1;
+        }
+        res[0] = c0, res[1] = c1, res[2] = c2, res[3] = c3;
+    }
+
+    inline TsetlinCounterRandGen(uint64_t seed, uint32_t epoch,
+                                 uint32_t sample, uint32_t clause) noexcept
+        : key{(uint32_t)seed, (uint32_t)(seed >> 32)},
+          ctr{epoch, sample, clause, 0} {}
+
+    uint32_t
+    rand_32() noexcept {
+        if (out_idx == 4) {
+            philox4x32_10(ctr, key, out);
+            ctr[3]++;
+            out_idx = 0;
+        }
+        return out[out_idx++];
+    }
+
+    uint64_t
+    rand_64() noexcept {
+        uint64_t lo = rand_32();
+        uint64_t hi = rand_32();
+        return lo | (hi << 32);
+    }
+
+    // Return a 0 or a 1 with probability p.
+    bool
+    rand_bernoulli(float p) noexcept {
+        return (this->rand_64() * max_64_inv) <= p;
+    }
+};
+
 #endif  // TSETLIN_RAND_INCLUDE
\ No newline at end of file
@@ -0,0 +1,208 @@
+#ifndef TSETLIN_STATS_INCLUDE
+#define TSETLIN_STATS_INCLUDE
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <sstream>
+#include <string>
+
+// Build with -DTSETLIN_STATS=1 to count what the machine does while it
+// trains. Otherwise every counter compiles away, and stats() returns zeros.
+#ifndef TSETLIN_STATS
+#define TSETLIN_STATS 0
+#endif
+
+#if TSETLIN_STATS
+#define TSETLIN_STAT(...) __VA_ARGS__
+#else
+#define TSETLIN_STAT(...)
+#endif
+
+// A snapshot of the counters. Subtract two snapshots to get the counts for
+// the time in between, e.g. one epoch.
+struct TsetlinStats {
+    static constexpr bool enabled = TSETLIN_STATS;
+
+    uint64_t samples = 0;         // Samples trained on
+    uint64_t clause_evals = 0;    // Clauses evaluated while training
+    uint64_t cache_hits = 0;      // ... taken from the output cache
+    uint64_t clause_fires = 0;    // ... that output 1
+    uint64_t t1_sampled = 0;      // Clauses that drew for Type I feedback
+    uint64_t t1_applied = 0;      // ... and got it
+    uint64_t t2_sampled = 0;      // Clauses that drew for Type II feedback
+    uint64_t t2_applied = 0;      // ... and got it
+    uint64_t include_flips = 0;   // Automata that crossed include/exclude
+    uint64_t saturated_sums = 0;  // Samples whose vote sum hit +-T
+    uint64_t zero_feedback = 0;   // Samples no clause could get feedback on
+
+    static constexpr uint64_t TsetlinStats::*counters[] = {
+        &TsetlinStats::samples,        &TsetlinStats::clause_evals,
+        &TsetlinStats::cache_hits,     &TsetlinStats::clause_fires,
+        &TsetlinStats::t1_sampled,     &TsetlinStats::t1_applied,
+        &TsetlinStats::t2_sampled,     &TsetlinStats::t2_applied,
+        &TsetlinStats::include_flips,  &TsetlinStats::saturated_sums,
+        &TsetlinStats::zero_feedback};
+    static constexpr size_t num_counters =
+        sizeof(counters) / sizeof(counters[0]);
+
+    TsetlinStats&
+    operator+=(const TsetlinStats& o) noexcept {
+        for (auto c : counters) this->*c += o.*c;
+        return *this;
+    }
+
+    TsetlinStats
+    operator-(const TsetlinStats& o) const noexcept {
+        TsetlinStats d = *this;
+        for (auto c : counters) d.*c -= o.*c;
+        return d;
+    }
+
+    static double
+    ratio(uint64_t a, uint64_t b) noexcept {
+        return b ? (double)a / (double)b : 0;
+    }
+
+    double
+    firing_rate() const noexcept {
+        return ratio(clause_fires, clause_evals);
+    }
+    double
+    cache_hit_rate() const noexcept {
+        return ratio(cache_hits, clause_evals);
+    }
+    double
+    t1_apply_rate() const noexcept {
+        return ratio(t1_applied, t1_sampled);
+    }
+    double
+    t2_apply_rate() const noexcept {
+        return ratio(t2_applied, t2_sampled);
+    }
+    double
+    flips_per_sample() const noexcept {
+        return ratio(include_flips, samples);
+    }
+    double
+    saturated_rate() const noexcept {
+        return ratio(saturated_sums, samples);
+    }
+    double
+    zero_feedback_rate() const noexcept {
+        return ratio(zero_feedback, samples);
+    }
+
+    std::string
+    to_string() const {
+        std::ostringstream os;
+        os << "Clause firing rate: " << firing_rate()
+           << "\nOutput cache hit rate: " << cache_hit_rate()
+           << "\nType I applied/sampled: " << t1_applied << '/' << t1_sampled
+           << " (" << t1_apply_rate() << ")"
+           << "\nType II applied/sampled: " << t2_applied << '/' << t2_sampled
+           << " (" << t2_apply_rate() << ")"
+           << "\nInclude flips per sample: " << flips_per_sample()
+           << "\nSaturated sums: " << saturated_rate()
+           << "\nZero feedback samples: " << zero_feedback_rate();
+        return os.str();
+    }
+};
+
+// Counters for one machine, with a slot per thread on its own cache line.
+// Only the owning thread writes a slot, so an increment is a plain load and
+// store, not a locked instruction. Reading sums the slots. A thread hands
+// its slot back when it exits, and the next thread carries on from its
+// counts. Threads past num_slots at once share one extra slot, which takes
+// a fetch_add so no counts are lost.
+class TsetlinStatsCounters {
+    static constexpr size_t num_slots = 64;
+    static constexpr size_t shared_slot = num_slots;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> c[TsetlinStats::num_counters];
+    };
+    Slot slots[num_slots + 1] = {};
+
+    // Bit i is set while a live thread owns slot i, in every instance.
+    static std::atomic<uint64_t>&
+    used_slots() noexcept {
+        static std::atomic<uint64_t> used{0};
+        return used;
+    }
+
+    struct ThreadSlot {
+        size_t slot = shared_slot;
+
+        ThreadSlot() noexcept {
+            std::atomic<uint64_t>& used = used_slots();
+            uint64_t u = used.load(std::memory_order_relaxed);
+            while (~u) {
+                size_t i = __builtin_ctzll(~u);
+                // acq_rel, so the counts of the slot's last owner are seen.
+                if (used.compare_exchange_weak(u, u | (1ull << i),
+                                               std::memory_order_acq_rel)) {
+                    slot = i;
+                    return;
+                }
+            }
+        }
+        ~ThreadSlot() {
+            if (slot != shared_slot)
+                used_slots().fetch_and(~(1ull << slot),
+                                       std::memory_order_release);
+        }
+    };
+
+    static size_t
+    thread_slot() noexcept {
+        thread_local ThreadSlot t;
+        return t.slot;
+    }
+
+   public:
+    // Order of TsetlinStats::counters.
+    enum Counter {
+        SAMPLES,
+        CLAUSE_EVALS,
+        CACHE_HITS,
+        CLAUSE_FIRES,
+        T1_SAMPLED,
+        T1_APPLIED,
+        T2_SAMPLED,
+        T2_APPLIED,
+        INCLUDE_FLIPS,
+        SATURATED_SUMS,
+        ZERO_FEEDBACK,
+    };
+
+    inline void
+    add(Counter counter, uint64_t n) noexcept {
+        size_t slot = thread_slot();
+        std::atomic<uint64_t>& a = slots[slot].c[counter];
+        if (slot == shared_slot) [[unlikely]]
+            a.fetch_add(n, std::memory_order_relaxed);
+        else
+            a.store(a.load(std::memory_order_relaxed) + n,
+                    std::memory_order_relaxed);
+    }
+
+    TsetlinStats
+    read() const noexcept {
+        TsetlinStats s;
+        for (const Slot& slot : slots)
+            for (size_t i = 0; i < TsetlinStats::num_counters; i++)
+                s.*TsetlinStats::counters[i] +=
+                    slot.c[i].load(std::memory_order_relaxed);
+        return s;
+    }
+
+    // Only while nothing is training.
+    void
+    reset() noexcept {
+        for (Slot& slot : slots)
+            for (auto& c : slot.c) c.store(0, std::memory_order_relaxed);
+    }
+};
+
+#endif  // TSETLIN_STATS_INCLUDE
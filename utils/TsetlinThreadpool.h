@@ -1,28 +1,124 @@
 #ifndef TTHREADPOOL
 #define TTHREADPOOL
 
+#include <algorithm>
+#include <condition_variable>
 #include <cstddef>
+#include <exception>
+#include <functional>
 #include <mutex>
+#include <string>
 #include <thread>
+#include <vector>
 
-template <size_t num_threads, typename output_type>
+#include "Trace.h"
+
+// A fixed set of workers that all run the same job. The calling thread takes
+// part as thread 0, so a pool of one thread runs everything inline.
 class TThreadpool {
-    std::thread threads[num_threads];
-    std::mutex task_mutex = std::mutex();
+    std::vector<std::thread> threads;
+    std::mutex task_mutex;
+    std::condition_variable task_cv, done_cv;
+
+    const std::function<void(size_t)>* task = nullptr;
+    size_t generation = 0;
+    size_t remaining = 0;
+    bool stopping = false;
+    std::exception_ptr error;
+
+    void
+    await_work(size_t thread_idx) {
+        TSETLIN_TRACE_THREAD_NAME("pool worker " + std::to_string(thread_idx));
+        size_t seen = 0;
+        for (;;) {
+            const std::function<void(size_t)>* work;
+            {
+                std::unique_lock<std::mutex> lock(task_mutex);
+                task_cv.wait(lock,
+                             [&] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+                work = task;
+            }
+
+            try {
+                TSETLIN_TRACE_SPAN("pool job");
+                (*work)(thread_idx);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(task_mutex);
+                if (!error) error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(task_mutex);
+            if (--remaining == 0) done_cv.notify_one();
+        }
+    }
+
+   public:
+    TThreadpool(size_t num_threads = std::thread::hardware_concurrency()) {
+        num_threads = std::max<size_t>(num_threads, 1);
+        for (size_t i = 1; i < num_threads; i++)
+            threads.emplace_back([this, i] { await_work(i); });
+    }
 
-    std::function tasks[num_threads];
-    output_type output_space[num_threads];
+    TThreadpool(const TThreadpool&) = delete;
+    TThreadpool& operator=(const TThreadpool&) = delete;
 
-    TThreadpool() {
-        auto await_work_fn = [this]() { 
-            task_mutex.lock();
-            auto work
-            task_mutex.unlock();
-         };
+    ~TThreadpool() {
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            stopping = true;
+        }
+        task_cv.notify_all();
+        for (std::thread& t : threads) t.join();
+    }
+
+    size_t
+    size() const noexcept {
+        return threads.size() + 1;
+    }
+
+    // Runs work(thread_idx) once on every thread, and returns when they have
+    // all finished. Rethrows the first exception any of them threw.
+    void
+    run(const std::function<void(size_t)>& work) {
+        {
+            std::lock_guard<std::mutex> lock(task_mutex);
+            task = &work;
+            remaining = threads.size();
+            error = nullptr;
+            generation++;
+        }
+        task_cv.notify_all();
+
+        std::exception_ptr own_error;
+        try {
+            TSETLIN_TRACE_SPAN("pool job");
+            work(0);
+        } catch (...) {
+            own_error = std::current_exception();
+        }
+
+        // Time the caller spends waiting here is load imbalance.
+        TSETLIN_TRACE_SPAN("pool barrier");
+        std::unique_lock<std::mutex> lock(task_mutex);
+        done_cv.wait(lock, [&] { return remaining == 0; });
+        if (own_error) std::rethrow_exception(own_error);
+        if (error) std::rethrow_exception(error);
+    }
 
-        for (size_t i = 0; i < num_threads; i++)
-            threads[i] = std::thread(await_work_fn);
+    // Splits [0, n) into one contiguous range per thread and calls
+    // work(begin, end, thread_idx) on each.
+    template <typename Fn>
+    void
+    parallel_for(size_t n, Fn&& work) {
+        size_t t = size();
+        run([&](size_t thread_idx) {
+            size_t begin = n * thread_idx / t;
+            size_t end = n * (thread_idx + 1) / t;
+            if (begin < end) work(begin, end, thread_idx);
+        });
     }
 };
 
-#endif  // TTHREADPOOL
\ No newline at end of file
+#endif  // TTHREADPOOL
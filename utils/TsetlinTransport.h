@@ -0,0 +1,380 @@
+#ifndef TSETLIN_TRANSPORT_INCLUDE
+#define TSETLIN_TRANSPORT_INCLUDE
+
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Transports move int64 buffers between the worker processes of a
+// distributed Tsetlin machine. Anything that satisfies this concept can be
+// plugged into DistributedTsetlinMachine. All collectives are blocking, and
+// every rank must call them in the same order with the same length.
+// clang-format off
+template <typename T>
+concept TsetlinTransport = requires(T t, int64_t* buf, size_t n) {
+    { t.rank() } -> std::convertible_to<size_t>;
+    { t.world_size() } -> std::convertible_to<size_t>;
+    t.allreduce_sum(buf, n);  // buf[i] = sum over ranks of buf[i]
+    t.broadcast(buf, n);      // buf = rank 0's buf
+    t.barrier();
+};
+// clang-format on
+
+static inline void
+transport_panic(const char* what) {
+    throw std::runtime_error(std::string(what) + ": " + std::strerror(errno));
+}
+
+//////////////////////////
+// Unix Domain Sockets  //
+//////////////////////////
+
+// Star topology. Rank 0 listens on a socket path, and every other rank
+// connects to it. Reductions are summed on rank 0 and sent back out.
+class UnixSocketTransport {
+    size_t _rank, _world_size;
+    int listen_fd = -1;
+    std::vector<int> peers;  // Rank 0: indexed by rank. Others: just rank 0.
+    std::vector<int64_t> scratch;
+
+    static void
+    write_all(int fd, const void* buf, size_t len) {
+        const char* p = (const char*)buf;
+        while (len) {
+            ssize_t w = ::write(fd, p, len);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                transport_panic("UnixSocketTransport write");
+            }
+            p += w;
+            len -= (size_t)w;
+        }
+    }
+
+    static void
+    read_all(int fd, void* buf, size_t len) {
+        char* p = (char*)buf;
+        while (len) {
+            ssize_t r = ::read(fd, p, len);
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                transport_panic("UnixSocketTransport read");
+            }
+            if (r == 0)
+                throw std::runtime_error(
+                    "UnixSocketTransport: peer closed the connection.");
+            p += r;
+            len -= (size_t)r;
+        }
+    }
+
+    static sockaddr_un
+    make_addr(const char* path) {
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (std::strlen(path) >= sizeof(addr.sun_path))
+            throw std::invalid_argument("Socket path too long: " +
+                                        std::string(path));
+        std::strcpy(addr.sun_path, path);
+        return addr;
+    }
+
+   public:
+    UnixSocketTransport(const char* path, size_t rank, size_t world_size)
+        : _rank(rank), _world_size(world_size) {
+        if (rank >= world_size)
+            throw std::out_of_range("Rank " + std::to_string(rank) +
+                                    " out of range for world size " +
+                                    std::to_string(world_size) + ".");
+        sockaddr_un addr = make_addr(path);
+
+        if (rank == 0) {
+            // Bind to a fresh name and accept everyone else. Peers announce
+            // their rank as the first thing they send.
+            peers.assign(world_size, -1);
+            ::unlink(path);
+            if ((listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+                transport_panic("socket");
+            if (::bind(listen_fd, (sockaddr*)&addr, sizeof(addr)) == -1)
+                transport_panic("bind");
+            if (::listen(listen_fd, (int)world_size) == -1)
+                transport_panic("listen");
+            for (size_t i = 1; i < world_size; i++) {
+                int fd = ::accept(listen_fd, NULL, NULL);
+                if (fd == -1) transport_panic("accept");
+                uint64_t peer_rank;
+                read_all(fd, &peer_rank, sizeof(peer_rank));
+                if (peer_rank == 0 || peer_rank >= world_size ||
+                    peers[peer_rank] != -1)
+                    throw std::runtime_error("Bad rank from peer: " +
+                                             std::to_string(peer_rank));
+                peers[peer_rank] = fd;
+            }
+        } else {
+            // Rank 0 might not be listening yet, so keep retrying.
+            int fd = -1;
+            for (size_t attempt = 0;; attempt++) {
+                if ((fd = ::socket(AF_UNIX, SOCK_STREAM, 0)) == -1)
+                    transport_panic("socket");
+                if (::connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0) break;
+                ::close(fd);
+                if (attempt == 5000) transport_panic("connect");
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            uint64_t r = rank;
+            write_all(fd, &r, sizeof(r));
+            peers.push_back(fd);
+        }
+    }
+
+    UnixSocketTransport(const UnixSocketTransport&) = delete;
+    UnixSocketTransport& operator=(const UnixSocketTransport&) = delete;
+
+    ~UnixSocketTransport() {
+        for (int fd : peers)
+            if (fd != -1) ::close(fd);
+        if (listen_fd != -1) ::close(listen_fd);
+    }
+
+    size_t
+    rank() const noexcept {
+        return _rank;
+    }
+    size_t
+    world_size() const noexcept {
+        return _world_size;
+    }
+
+    void
+    allreduce_sum(int64_t* buf, size_t n) {
+        size_t bytes = n * sizeof(int64_t);
+        if (_rank) {
+            write_all(peers[0], buf, bytes);
+            read_all(peers[0], buf, bytes);
+            return;
+        }
+
+        scratch.resize(n);
+        for (size_t r = 1; r < _world_size; r++) {
+            read_all(peers[r], scratch.data(), bytes);
+            for (size_t i = 0; i < n; i++) buf[i] += scratch[i];
+        }
+        for (size_t r = 1; r < _world_size; r++) write_all(peers[r], buf, bytes);
+    }
+
+    void
+    broadcast(int64_t* buf, size_t n) {
+        size_t bytes = n * sizeof(int64_t);
+        if (_rank)
+            read_all(peers[0], buf, bytes);
+        else
+            for (size_t r = 1; r < _world_size; r++)
+                write_all(peers[r], buf, bytes);
+    }
+
+    void
+    barrier() {
+        int64_t token = 0;
+        allreduce_sum(&token, 1);
+    }
+};
+
+///////////////////
+// Shared Memory //
+///////////////////
+
+// One anonymous shared mapping, created by the launching process before it
+// forks the workers. Every rank owns a slot of slot_capacity int64s that the
+// others read from after a barrier.
+class SharedMemoryGroup {
+   public:
+    struct Header {
+        alignas(64) std::atomic<uint64_t> arrived;
+        alignas(64) std::atomic<uint64_t> generation;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                  "Process-shared atomics must be lock free.");
+
+    size_t world_size;
+    size_t slot_capacity;
+    size_t map_size;
+    void* map;
+
+    SharedMemoryGroup(size_t ranks, size_t capacity = 1 << 16)
+        : world_size(ranks), slot_capacity(capacity) {
+        map_size = sizeof(Header) + world_size * slot_capacity * sizeof(int64_t);
+        map = ::mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) transport_panic("mmap");
+        Header* h = new (map) Header();
+        h->arrived.store(0);
+        h->generation.store(0);
+    }
+
+    SharedMemoryGroup(const SharedMemoryGroup&) = delete;
+    SharedMemoryGroup& operator=(const SharedMemoryGroup&) = delete;
+
+    ~SharedMemoryGroup() { ::munmap(map, map_size); }
+
+    Header*
+    header() const noexcept {
+        return (Header*)map;
+    }
+
+    int64_t*
+    slot(size_t rank) const noexcept {
+        return (int64_t*)((char*)map + sizeof(Header)) + rank * slot_capacity;
+    }
+};
+
+class SharedMemoryTransport {
+    const SharedMemoryGroup& group;
+    size_t _rank;
+
+   public:
+    SharedMemoryTransport(const SharedMemoryGroup& shared, size_t rank)
+        : group(shared), _rank(rank) {
+        if (rank >= group.world_size)
+            throw std::out_of_range("Rank " + std::to_string(rank) +
+                                    " out of range for world size " +
+                                    std::to_string(group.world_size) + ".");
+    }
+
+    size_t
+    rank() const noexcept {
+        return _rank;
+    }
+    size_t
+    world_size() const noexcept {
+        return group.world_size;
+    }
+
+    // Generation counting barrier. The generation has to be read before
+    // arriving, otherwise the last rank could bump it first and we would
+    // wait for the next one.
+    void
+    barrier() noexcept {
+        SharedMemoryGroup::Header* h = group.header();
+        uint64_t gen = h->generation.load(std::memory_order_acquire);
+        if (h->arrived.fetch_add(1, std::memory_order_acq_rel) ==
+            group.world_size - 1) {
+            h->arrived.store(0, std::memory_order_relaxed);
+            h->generation.fetch_add(1, std::memory_order_release);
+        } else {
+            for (size_t spins = 0;
+                 h->generation.load(std::memory_order_acquire) == gen; spins++)
+                if (spins > 1024) std::this_thread::yield();
+        }
+    }
+
+    // Everyone publishes into their own slot, then everyone sums every slot.
+    // The second barrier keeps a fast rank from overwriting its slot while a
+    // slow one is still reading it.
+    void
+    allreduce_sum(int64_t* buf, size_t n) noexcept {
+        for (size_t off = 0; off < n; off += group.slot_capacity) {
+            size_t len = std::min(group.slot_capacity, n - off);
+            std::memcpy(group.slot(_rank), buf + off, len * sizeof(int64_t));
+            barrier();
+            for (size_t i = 0; i < len; i++) {
+                int64_t sum = 0;
+                for (size_t r = 0; r < group.world_size; r++)
+                    sum += group.slot(r)[i];
+                buf[off + i] = sum;
+            }
+            barrier();
+        }
+    }
+
+    void
+    broadcast(int64_t* buf, size_t n) noexcept {
+        for (size_t off = 0; off < n; off += group.slot_capacity) {
+            size_t len = std::min(group.slot_capacity, n - off);
+            if (!_rank)
+                std::memcpy(group.slot(0), buf + off, len * sizeof(int64_t));
+            barrier();
+            if (_rank)
+                std::memcpy(buf + off, group.slot(0), len * sizeof(int64_t));
+            barrier();
+        }
+    }
+};
+
+//////////////
+// Launcher //
+//////////////
+
+// Forks world_size workers, runs worker_fn(rank) in each, and waits for all
+// of them. Anything the workers need to share (a SharedMemoryGroup, a socket
+// path) has to be set up before calling this. Returns the number of workers
+// that failed. If one fails, the rest are killed, since they would otherwise
+// block forever in a collective. If a fork fails, the workers already started
+// are killed and reaped before throwing.
+template <typename Fn>
+static inline size_t
+launch_local_workers(size_t world_size, Fn&& worker_fn) {
+    std::vector<pid_t> pids(world_size, -1);
+    for (size_t rank = 0; rank < world_size; rank++) {
+        pid_t pid = ::fork();
+        if (pid == -1) {
+            // The ones already running would wait for the rest forever.
+            int fork_errno = errno;
+            for (size_t r = 0; r < rank; r++) {
+                ::kill(pids[r], SIGTERM);
+                while (::waitpid(pids[r], NULL, 0) == -1 && errno == EINTR) {
+                }
+            }
+            errno = fork_errno;
+            transport_panic("fork");
+        }
+        if (pid == 0) {
+            int status = 0;
+            try {
+                worker_fn(rank);
+            } catch (const std::exception& e) {
+                std::fprintf(stderr, "Worker %zu failed: %s\n", rank, e.what());
+                status = 1;
+            }
+            std::fflush(stdout);
+            ::_exit(status);
+        }
+        pids[rank] = pid;
+    }
+
+    size_t failed = 0;
+    for (size_t remaining = world_size; remaining; remaining--) {
+        int status;
+        pid_t pid = ::wait(&status);
+        if (pid == -1) transport_panic("wait");
+        for (pid_t& p : pids)
+            if (p == pid) p = -1;
+        if (!WIFEXITED(status) || WEXITSTATUS(status)) {
+            failed++;
+            for (pid_t p : pids)
+                if (p != -1) ::kill(p, SIGTERM);
+        }
+    }
+    return failed;
+}
+
+#endif  // TSETLIN_TRANSPORT_INCLUDE